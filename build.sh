@@ -1,5 +1,17 @@
 #!/bin/bash
 
+# the simulation alone, for machines without SDL2 or OpenGL
+if [ "$1" == "headless" ]
+then
+  mkdir build
+  cmake -S . -B ./build -DCMAKE_BUILD_TYPE=Release -DBUILD_GUI=OFF
+  cd build
+  make softbody_headless
+  cp ./Release/bin/softbody_headless ..
+  cd ..
+  exit
+fi
+
 mkdir build
 cmake -S . -B ./build -DCMAKE_BUILD_TYPE=Release
 cd build
@@ -6,7 +6,8 @@
 
 class engine {
 public:
-	engine()  { init(); }
+	// precision is a precisionMode, for the simulation state and solver math
+	engine( int precision = SINGLE_PRECISION ) { simulationModel.simulation.simParameters.precision = precision; init(); }
 	~engine() { quit(); }
 
   // called from main
@@ -75,18 +75,119 @@ void engine::showConfigWindow() {
     ImGui::SameLine();
     HelpMarker( "Softbody Simulation Model" );
     if ( ImGui::BeginTabItem( "Simulation" ) ) {
-      ImGui::SliderFloat( "Time Scale", &simulationModel.simParameters.timeScale, 0.0f, 0.01f );
-      ImGui::SliderFloat( "Gravity", &simulationModel.simParameters.gravity, -10.0f, 10.0f );
+      const char* solverNames[] = { "Explicit Euler", "Implicit Euler", "XPBD", "Multirate" };
+      ImGui::Combo( "Solver", &simulationModel.simulation.simParameters.solver, solverNames, IM_ARRAYSIZE( solverNames ) );
+      if ( simulationModel.simulation.simParameters.solver == EXPLICIT_EULER ) {
+        const char* integratorNames[] = { "Semi-Implicit Euler", "Position Verlet", "Velocity Verlet" };
+        ImGui::Combo( "Integrator", &simulationModel.simulation.simParameters.integrator, integratorNames, IM_ARRAYSIZE( integratorNames ) );
+      }
+      if ( simulationModel.simulation.simParameters.solver == IMPLICIT_EULER ) {
+        ImGui::SliderInt( "CG Iterations", &simulationModel.simulation.simParameters.cgMaxIterations, 1, 200 );
+        ImGui::SliderFloat( "CG Tolerance", &simulationModel.simulation.simParameters.cgTolerance, 1e-6f, 1e-1f, "%.6f", ImGuiSliderFlags_Logarithmic );
+        const char* preconditionerNames[] = { "Jacobi", "Gauss-Seidel" };
+        ImGui::Combo( "CG Preconditioner", &simulationModel.simulation.simParameters.cgPreconditioner, preconditionerNames, IM_ARRAYSIZE( preconditionerNames ) );
+        ImGui::SameLine();
+        HelpMarker( "Gauss-Seidel sweeps the node colors forward and back, fewer iterations for more work in each" );
+      }
+      if ( simulationModel.simulation.simParameters.solver == XPBD ) {
+        ImGui::SliderInt( "XPBD Substeps", &simulationModel.simulation.simParameters.xpbdSubsteps, 1, 32 );
+        ImGui::SliderInt( "XPBD Iterations", &simulationModel.simulation.simParameters.xpbdIterations, 1, 32 );
+        ImGui::Checkbox( "XPBD Coloring", &simulationModel.simulation.simParameters.xpbdColoring );
+        ImGui::SameLine();
+        HelpMarker( "Project the edges a color at a time across the whole frame, no cross edge pass between iterations" );
+      }
+      if ( simulationModel.simulation.simParameters.solver == MULTIRATE ) {
+        ImGui::SliderInt( "Multirate Levels", &simulationModel.simulation.simParameters.multirateLevels, 1, 6 );
+        ImGui::SameLine();
+        HelpMarker( "Nodes are grouped by the stiffness of their springs, and each group takes 1, 2, 4 .. kicks per tick - the stiffest up to 2^( levels - 1 )" );
+        ImGui::SliderFloat( "Multirate Safety", &simulationModel.simulation.simParameters.multirateSafety, 0.1f, 2.0f );
+        const std::vector< int > levels = simulationModel.simulation.multirateLevelNodes();
+        std::string grouping;
+        for ( size_t l = 0; l < levels.size(); l++ )
+          grouping += ( l ? ", " : "" ) + std::to_string( 1 << l ) + "x: " + std::to_string( levels[ l ] );
+        ImGui::Text( "Nodes per level %s - %d spring evaluations per tick", grouping.c_str(), simulationModel.simulation.multirateSpringEvaluations() );
+      }
+      if ( ImGui::Checkbox( "Deterministic", &simulationModel.simulation.simParameters.deterministic ) )
+        simulationModel.loadFramePoints();
+      ImGui::SameLine();
+      HelpMarker( "Fixed partition and scalar spring kernel, so results are bit identical for any number of threads. Reloads the model" );
+      const char* precisionNames[] = { "Float", "Mixed", "Double" };
+      if ( ImGui::Combo( "Precision", &simulationModel.simulation.simParameters.precision, precisionNames, IM_ARRAYSIZE( precisionNames ) ) )
+        simulationModel.loadFramePoints();
+      ImGui::SameLine();
+      HelpMarker( "Float state and math, float state with double force sums and integration, or double throughout. Reloads the model" );
+      ImGui::Checkbox( "Log State Checksums", &simulationModel.simulation.simParameters.logChecksums );
+      if ( ImGui::Button( "Benchmark Solvers" ) )
+        simulationModel.BenchmarkSolvers();
+      ImGui::SameLine();
+      HelpMarker( "Drives each solver at a range of Time Scale values and prints stability and cost per tick to the console, then resets the model" );
+      ImGui::Checkbox( "Adaptive Time Step", &simulationModel.simulation.simParameters.adaptiveTimeStep );
+      ImGui::SameLine();
+      HelpMarker( "Set Time Scale every few ticks - as large as the estimated stability limit allows, up to Max Time Scale, and halved if the energy starts to climb" );
+      if ( simulationModel.simulation.simParameters.adaptiveTimeStep ) {
+        ImGui::SliderFloat( "Max Time Scale", &simulationModel.simulation.simParameters.maxTimeScale, 0.0001f, 0.1f, "%.5f", ImGuiSliderFlags_Logarithmic );
+        ImGui::SliderFloat( "Stability Safety", &simulationModel.simulation.simParameters.stabilitySafety, 0.1f, 1.0f );
+        ImGui::SliderFloat( "Energy Tolerance", &simulationModel.simulation.simParameters.energyTolerance, 0.01f, 2.0f, "%.3f", ImGuiSliderFlags_Logarithmic );
+        ImGui::Text( "Time Scale %.5f, stable limit %.5f", simulationModel.simulation.simParameters.timeScale, simulationModel.simulation.StableTimeStep() );
+      } else {
+        ImGui::SliderFloat( "Time Scale", &simulationModel.simulation.simParameters.timeScale, 0.0001f, 0.1f, "%.5f", ImGuiSliderFlags_Logarithmic );
+      }
+      ImGui::Text( "Solver rate %.0f Hz", 1.0f / simulationModel.simulation.simParameters.timeScale );
+      ImGui::Checkbox( "Real Time Stepping", &simulationModel.simulation.simParameters.realTimeStepping );
+      ImGui::SameLine();
+      HelpMarker( "Run as many Time Scale ticks per frame as fit in the wall clock time since the last frame, instead of a fixed count" );
+      if ( simulationModel.simulation.simParameters.realTimeStepping ) {
+        ImGui::SliderInt( "Max Substeps", &simulationModel.simulation.simParameters.maxSubstepsPerFrame, 1, 1000 );
+        ImGui::Checkbox( "Interpolate Render", &simulationModel.simulation.simParameters.interpolateRender );
+      } else {
+        ImGui::SliderInt( "Substeps Per Frame", &simulationModel.simulation.simParameters.substepsPerFrame, 1, 200 );
+      }
+      ImGui::SliderFloat( "Gravity", &simulationModel.simulation.simParameters.gravity, -10.0f, 10.0f );
       ImGui::Text(" ");
-      ImGui::SliderFloat( "Noise Amplitude", &simulationModel.simParameters.noiseAmplitudeScale, 0.0f, 0.45f );
-      ImGui::SliderFloat( "Noise Speed", &simulationModel.simParameters.noiseSpeed, 0.0f, 10.0f );
+      const char* roadSourceNames[] = { "Noise", "ISO 8608 Profile" };
+      ImGui::Combo( "Road", &simulationModel.simulation.simParameters.roadSource, roadSourceNames, IM_ARRAYSIZE( roadSourceNames ) );
+      ImGui::SameLine();
+      HelpMarker( "ISO 8608 Profile synthesizes the road from the power spectral density of a roughness class, in meters, on a background thread a few tiles ahead of the vehicle" );
+      if ( simulationModel.simulation.simParameters.roadSource == PROFILE_ROAD ) {
+        const char* classNames[] = { "A - Very Good", "B - Good", "C - Average", "D - Poor", "E - Very Poor", "F", "G", "H" };
+        ImGui::Combo( "Road Class", &simulationModel.simulation.simParameters.roadClass, classNames, IM_ARRAYSIZE( classNames ) );
+      } else {
+        ImGui::SliderFloat( "Noise Amplitude", &simulationModel.simulation.simParameters.noiseAmplitudeScale, 0.0f, 0.45f );
+      }
+      ImGui::SliderFloat( "Noise Speed", &simulationModel.simulation.simParameters.noiseSpeed, 0.0f, 10.0f );
+      if ( simulationModel.simulation.simParameters.roadSource == NOISE_ROAD ) {
+        const char* noiseNames[] = { "Built In Simplex", "FastNoise2" };
+        ImGui::Combo( "Road Noise", &simulationModel.simulation.simParameters.roadNoiseBackend, noiseNames,
+          noiseBackendAvailable( FASTNOISE2_NOISE ) ? IM_ARRAYSIZE( noiseNames ) : 1 );
+        ImGui::Checkbox( "Cache Road", &simulationModel.simulation.simParameters.cacheRoad );
+        ImGui::SameLine();
+        HelpMarker( "Keep the road on a grid that scrolls with it, and only generate the newly exposed rows - off samples the noise under each wheel, the ground is drawn from the grid either way" );
+      }
       ImGui::Text(" ");
-      ImGui::SliderFloat( "Chassis Node Mass", &simulationModel.simParameters.chassisNodeMass, 0.1f, 10.0f );
-      ImGui::SliderFloat( "Chassis K", &simulationModel.simParameters.chassisKConstant, 0.0f, 15000.0f );
-      ImGui::SliderFloat( "Chassis Damping", &simulationModel.simParameters.chassisDamping, 0.0f, 100.0f );
-      ImGui::Text(" ");
-      ImGui::SliderFloat( "Suspension K", &simulationModel.simParameters.suspensionKConstant, 0.0f, 15000.0f );
-      ImGui::SliderFloat( "Suspension Damping", &simulationModel.simParameters.suspensionDamping, 0.0f, 100.0f );
+      ImGui::SliderFloat( "Chassis Node Mass", &simulationModel.simulation.simParameters.chassisNodeMass, 0.1f, 10.0f );
+      for ( auto& m : simulationModel.simulation.simParameters.materials ) {
+        ImGui::Text(" ");
+        ImGui::PushID( &m );
+        const char* lawNames[] = { "Linear", "Piecewise Linear", "Cubic", "Tabulated" };
+        const char* damperNames[] = { "None", "Linear", "Tabulated" };
+        bool changed = ImGui::Combo( ( m.name + " Spring" ).c_str(), &m.law, lawNames, IM_ARRAYSIZE( lawNames ) );
+        if ( m.law != TABULATED_SPRING )
+          changed |= ImGui::SliderFloat( ( m.name + " K" ).c_str(), &m.k, 0.0f, 15000.0f );
+        if ( m.law == PIECEWISE_LINEAR_SPRING ) {
+          changed |= ImGui::SliderFloat( ( m.name + " Stop K" ).c_str(), &m.k2, 0.0f, 60000.0f );
+          changed |= ImGui::SliderFloat( ( m.name + " Bump Stop" ).c_str(), &m.lowKnee, -0.5f, 0.0f );
+          changed |= ImGui::SliderFloat( ( m.name + " Rebound Stop" ).c_str(), &m.highKnee, 0.0f, 0.5f );
+        }
+        if ( m.law == CUBIC_SPRING )
+          changed |= ImGui::SliderFloat( ( m.name + " Cubic K" ).c_str(), &m.k2, 0.0f, 2000000.0f, "%.0f", ImGuiSliderFlags_Logarithmic );
+        changed |= ImGui::SliderFloat( ( m.name + " Damping" ).c_str(), &m.damping, 0.0f, 100.0f );
+        changed |= ImGui::Combo( ( m.name + " Shock" ).c_str(), &m.damper, damperNames, IM_ARRAYSIZE( damperNames ) );
+        if ( m.damper == LINEAR_DAMPER )
+          changed |= ImGui::SliderFloat( ( m.name + " Shock Damping" ).c_str(), &m.shockDamping, 0.0f, 500.0f );
+        if ( changed )
+          simulationModel.simulation.RefreshMaterialConstants();
+        ImGui::PopID();
+      }
       ImGui::EndTabItem();
     }
     if ( ImGui::BeginTabItem( "Render" ) ) {
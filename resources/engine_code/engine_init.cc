@@ -70,7 +70,9 @@ void engine::displaySetup() {
 
   cout << T_BLUE << "    Platform Info:" << RESET << endl;
   cout << T_RED << "      Renderer: " << T_CYAN << renderer << RESET << endl;
-  cout << T_RED << "      OpenGL version supported: " << T_CYAN << version << RESET << endl << endl;
+  cout << T_RED << "      OpenGL version supported: " << T_CYAN << version << RESET << endl;
+  cout << T_RED << "      Spring kernel: " << T_CYAN << kernelName( currentSpringKernel() ) << RESET << endl;
+  cout << T_RED << "      Simulation precision: " << T_CYAN << precisionName( precisionMode( simulationModel.simulation.simParameters.precision ) ) << RESET << endl << endl;
 
   // create the shader for the triangles to cover the screen
   displayShader = Shader( "resources/engine_code/shaders/blit.vs.glsl", "resources/engine_code/shaders/blit.fs.glsl" ).Program;
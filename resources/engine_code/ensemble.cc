@@ -0,0 +1,72 @@
+#include "ensemble.h"
+
+#include <algorithm>
+#include <atomic>
+
+ensemble::ensemble( std::shared_ptr< const vehicleGraph > graph, int count, const simParameterPack& parameters, int numWorkers )
+  : sharedGraph( std::move( graph ) ), pool( numWorkers > 0 ? numWorkers : int( std::thread::hardware_concurrency() ) ) {
+  instances.reserve( count );
+  for ( int i = 0; i < count; i++ ) {
+    instances.push_back( std::make_unique< softbodySimulation >() );
+    instances.back()->simParameters = parameters;
+    instances.back()->simParameters.roadSeed = parameters.roadSeed + i;
+  }
+
+  // the buffers are first touched here, by the worker that will step them
+  pool.forEach( count, [&]( int i, int ) { instances[ i ]->Load( sharedGraph ); } );
+  for ( int w = 0; w < pool.size(); w++ )
+    packs.push_back( std::make_unique< vehiclePack >( sharedGraph ) );
+}
+
+std::shared_ptr< const vehicleGraph > ensemble::StockGraph() {
+  auto graph = std::make_shared< vehicleGraph >();
+  graph->loadFrame();
+  graph->finalize( 1 );
+  return graph;
+}
+
+void ensemble::Step( int ticks ) {
+  // the work - instances that can't be packed one at a time, then the packable ones in runs of
+  // up to packLanes that share an integrator. item j is lanes [ itemStart[ j ], itemStart[ j + 1 ] )
+  std::vector< softbodySimulation* > lanes;
+  std::vector< int > itemStart = { 0 };
+  std::vector< softbodySimulation* > packable[ 3 ];
+  for ( auto& instance : instances ) {
+    if ( lanePacking && packs[ 0 ]->Packable( *instance ) ) {
+      const int integrator = instance->simParameters.integrator;
+      packable[ integrator == POSITION_VERLET || integrator == VELOCITY_VERLET ? integrator : SEMI_IMPLICIT_EULER ].push_back( instance.get() );
+    } else {
+      lanes.push_back( instance.get() );
+      itemStart.push_back( lanes.size() );
+    }
+  }
+  const int numSingles = itemStart.size() - 1;
+  for ( auto& group : packable )
+    for ( size_t first = 0; first < group.size(); first += packLanes ) {
+      lanes.insert( lanes.end(), group.begin() + first, group.begin() + std::min( first + packLanes, group.size() ) );
+      itemStart.push_back( lanes.size() );
+    }
+
+  // items can cost very different amounts per tick ( solver, precision, iteration counts ), so
+  // they are handed out one at a time rather than in fixed blocks
+  std::atomic< int > nextItem{ 0 };
+  const int numItems = itemStart.size() - 1;
+  pool.dispatch( [&]( int worker ) {
+    for ( int j = nextItem++; j < numItems; j = nextItem++ ) {
+      if ( j >= numSingles ) {
+        packs[ worker ]->Step( lanes.data() + itemStart[ j ], itemStart[ j + 1 ] - itemStart[ j ], ticks );
+      } else {
+        softbodySimulation& s = *lanes[ itemStart[ j ] ];
+        for ( int t = 0; t < ticks; t++ )
+          s.Substep( inlinePool, s.NoiseStep() );
+      }
+    }
+  } );
+}
+
+uint64_t ensemble::StateChecksum() const {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for ( const auto& instance : instances )
+    hash = ( hash ^ instance->StateChecksum() ) * 0x100000001b3ull;
+  return hash;
+}
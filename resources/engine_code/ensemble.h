@@ -0,0 +1,53 @@
+#ifndef ENSEMBLE
+#define ENSEMBLE
+
+#include "softbody_simulation.h"
+#include "thread_pool.h"
+#include "vehicle_pack.h"
+
+#include <memory>
+#include <vector>
+
+// many independent vehicles in one process - one graph, built once and shared read only, and
+// an instance per vehicle holding its own parameters, road and state. each tick of an instance
+// is small enough that splitting it across workers costs more than it saves, so the pool
+// splits the instances instead: a worker takes the next instance not yet stepped and runs all
+// of its ticks on the calling thread, the graph should be finalized with a single part. the
+// instances that fit a vehiclePack are stepped packLanes at a time, one per SIMD lane
+class ensemble {
+public:
+	// count instances of graph, all starting from parameters but each on its own road, seeded
+	// parameters.roadSeed + i. the pool size defaults to one worker per hardware thread
+	ensemble( std::shared_ptr< const vehicleGraph > graph, int count,
+		const simParameterPack& parameters = simParameterPack(), int numWorkers = 0 );
+
+	// the stock chassis, finalized with one part
+	static std::shared_ptr< const vehicleGraph > StockGraph();
+
+	int size() const { return instances.size(); }
+
+	// an instance's parameters can be edited between steps - RefreshMaterialConstants applies
+	// the material table, Load( graph() ) the precision, the rest is read every tick
+	softbodySimulation& operator[]( int i ) { return *instances[ i ]; }
+	const softbodySimulation& operator[]( int i ) const { return *instances[ i ]; }
+	std::shared_ptr< const vehicleGraph > graph() const { return sharedGraph; }
+
+	// advance every instance by ticks, each road moving as it does in real time stepping
+	void Step( int ticks );
+
+	// step packable instances in vehiclePacks - each then matches a run of its own on the scalar
+	// kernel, otherwise on the active one
+	bool lanePacking = true;
+
+	// the instances' state checksums folded in order, comparable between runs
+	uint64_t StateChecksum() const;
+
+private:
+	std::shared_ptr< const vehicleGraph > sharedGraph;
+	std::vector< std::unique_ptr< softbodySimulation > > instances; // separate allocations, no false sharing between workers
+	std::vector< std::unique_ptr< vehiclePack > > packs; // one per worker
+	threadPool pool;
+	threadPool inlinePool{ 1 };           // runs a job on the calling thread, handed to every instance's Substep
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "force_laws.h"
+
+lawParameters tabulateCurve( const float* x, const float* y, int count, std::vector< float >& table, int sampleCount ) {
+  lawParameters p;
+  p.tableStart = table.size();
+  if ( count < 2 || !( x[ count - 1 ] > x[ 0 ] ) ) {
+    // not a curve - a flat zero, with both samples at the one x given
+    p.origin = count > 0 ? x[ 0 ] : 0.0f;
+    p.inverseStep = 1.0f;
+    table.push_back( count > 0 ? y[ 0 ] : 0.0f );
+    table.push_back( count > 0 ? y[ 0 ] : 0.0f );
+    return p;
+  }
+
+  sampleCount = std::max( sampleCount, 2 );
+  const float step = ( x[ count - 1 ] - x[ 0 ] ) / ( sampleCount - 1 );
+  p.origin = x[ 0 ];
+  p.inverseStep = 1.0f / step;
+  p.lastSegment = sampleCount - 2;
+
+  // walk the points alongside the samples, interpolating within the segment each one lands in
+  int segment = 0;
+  for ( int s = 0; s < sampleCount; s++ ) {
+    const float at = s == sampleCount - 1 ? x[ count - 1 ] : x[ 0 ] + s * step;
+    while ( segment < count - 2 && at > x[ segment + 1 ] )
+      segment++;
+    const float width = x[ segment + 1 ] - x[ segment ];
+    const float t = width > 0.0f ? ( at - x[ segment ] ) / width : 0.0f;
+    table.push_back( y[ segment ] + t * ( y[ segment + 1 ] - y[ segment ] ) );
+  }
+
+  p.samples = table.data() + p.tableStart;
+  p.k = tabulatedLaw::slope( 0.0f, p );
+  p.samples = nullptr;
+  return p;
+}
+
+const char* forceLawName( int law ) {
+  switch ( law ) {
+    case LINEAR_SPRING:           return "Linear";
+    case PIECEWISE_LINEAR_SPRING: return "Piecewise Linear";
+    case CUBIC_SPRING:            return "Cubic";
+    case TABULATED_SPRING:        return "Tabulated";
+  }
+  return "unknown";
+}
+
+const char* damperLawName( int law ) {
+  switch ( law ) {
+    case NO_DAMPER:        return "None";
+    case LINEAR_DAMPER:    return "Linear";
+    case TABULATED_DAMPER: return "Tabulated";
+  }
+  return "unknown";
+}
@@ -0,0 +1,221 @@
+#ifndef FORCE_LAWS
+#define FORCE_LAWS
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#endif
+
+// a force law maps one input to one force - the stretch L / L0 - 1 to the spring's tension,
+// or the extension speed dL / dt to the shock's force. each law is a policy with the curve
+// for a scalar and for each vector register width, so the spring pass is instantiated once
+// per law and there is nothing to decide per edge. every law is exactly k x for small x
+// unless it is tabulated, so k stays the slope at rest, which is what XPBD projects with
+enum forceLaw {
+	LINEAR_SPRING,                        // hooke's law, k x
+	PIECEWISE_LINEAR_SPRING,              // k x, with slope k2 past the knees - bump and rebound stops
+	CUBIC_SPRING,                         // k x + k2 x^3, progressive
+	TABULATED_SPRING                      // linear interpolation between uniform samples
+};
+constexpr int numForceLaws = 4;
+
+// the shock on a spring, along it, on top of the drag of the per node damping
+enum damperLaw {
+	NO_DAMPER,                            // drag only
+	LINEAR_DAMPER,                        // k x
+	TABULATED_DAMPER                      // force - velocity curve, as from a shock dyno
+};
+constexpr int numDamperLaws = 3;
+
+// one curve - which fields are read depends on the law
+struct lawParameters {
+	float k        = 0.0f;                // slope through the origin
+	float k2       = 0.0f;                // slope past the knees ( piecewise ), x^3 coefficient ( cubic )
+	float lowKnee  = 0.0f;                // piecewise: k2 applies below this
+	float highKnee = 0.0f;                // piecewise: and above this
+	float origin   = 0.0f;                // tabulated: x of the first sample
+	float inverseStep = 0.0f;             // tabulated: 1 / sample spacing
+	int lastSegment = 0;                  // tabulated: sample count - 2, the outer segments extrapolate
+	int tableStart = 0;                   // tabulated: first sample in springConstants::table
+	const float* samples = nullptr;       // tabulated: set from tableStart for the pass that reads it
+};
+
+// uniform samples of the piecewise linear curve through the points ( x[ i ], y[ i ] ), x
+// ascending, appended to table - returns the parameters, with k the slope at x = 0
+lawParameters tabulateCurve( const float* x, const float* y, int count, std::vector< float >& table, int sampleCount = 64 );
+
+struct linearLaw {
+	static constexpr bool active = true;
+	template < typename scalar >
+	static inline scalar force( scalar x, const lawParameters& p ) { return scalar( p.k ) * x; }
+	template < typename scalar >
+	static inline scalar slope( scalar, const lawParameters& p ) { return p.k; }
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+	__attribute__(( target( "sse4.2" ) ))
+	static inline __m128 force( __m128 x, const lawParameters& p ) { return _mm_mul_ps( _mm_set1_ps( p.k ), x ); }
+	__attribute__(( target( "avx2,fma" ) ))
+	static inline __m256 force( __m256 x, const lawParameters& p ) { return _mm256_mul_ps( _mm256_set1_ps( p.k ), x ); }
+	__attribute__(( target( "avx512f" ) ))
+	static inline __m512 force( __m512 x, const lawParameters& p ) { return _mm512_mul_ps( _mm512_set1_ps( p.k ), x ); }
+#endif
+};
+
+// k x + ( k2 - k ) ( min( x - lowKnee, 0 ) + max( x - highKnee, 0 ) ) - branch free, so it
+// vectorizes as two extra min / max
+struct piecewiseLinearLaw {
+	static constexpr bool active = true;
+	template < typename scalar >
+	static inline scalar force( scalar x, const lawParameters& p ) {
+		const scalar outside = std::min( x - p.lowKnee, scalar( 0 ) ) + std::max( x - p.highKnee, scalar( 0 ) );
+		return scalar( p.k ) * x + scalar( p.k2 - p.k ) * outside;
+	}
+	template < typename scalar >
+	static inline scalar slope( scalar x, const lawParameters& p ) {
+		return ( x < p.lowKnee || x > p.highKnee ) ? p.k2 : p.k;
+	}
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+	__attribute__(( target( "sse4.2" ) ))
+	static inline __m128 force( __m128 x, const lawParameters& p ) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 outside = _mm_add_ps( _mm_min_ps( _mm_sub_ps( x, _mm_set1_ps( p.lowKnee ) ), zero ),
+		                                   _mm_max_ps( _mm_sub_ps( x, _mm_set1_ps( p.highKnee ) ), zero ) );
+		return _mm_add_ps( _mm_mul_ps( _mm_set1_ps( p.k ), x ), _mm_mul_ps( _mm_set1_ps( p.k2 - p.k ), outside ) );
+	}
+	__attribute__(( target( "avx2,fma" ) ))
+	static inline __m256 force( __m256 x, const lawParameters& p ) {
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 outside = _mm256_add_ps( _mm256_min_ps( _mm256_sub_ps( x, _mm256_set1_ps( p.lowKnee ) ), zero ),
+		                                      _mm256_max_ps( _mm256_sub_ps( x, _mm256_set1_ps( p.highKnee ) ), zero ) );
+		return _mm256_fmadd_ps( _mm256_set1_ps( p.k2 - p.k ), outside, _mm256_mul_ps( _mm256_set1_ps( p.k ), x ) );
+	}
+	// full mask forms with a zeroed source, like gather16 in the kernels - the plain intrinsics
+	// trip -Wmaybe-uninitialized on gcc 12
+	__attribute__(( target( "avx512f" ) ))
+	static inline __m512 force( __m512 x, const lawParameters& p ) {
+		const __m512 zero = _mm512_setzero_ps();
+		const __m512 outside = _mm512_add_ps( _mm512_mask_min_ps( zero, 0xFFFF, _mm512_sub_ps( x, _mm512_set1_ps( p.lowKnee ) ), zero ),
+		                                      _mm512_mask_max_ps( zero, 0xFFFF, _mm512_sub_ps( x, _mm512_set1_ps( p.highKnee ) ), zero ) );
+		return _mm512_fmadd_ps( _mm512_set1_ps( p.k2 - p.k ), outside, _mm512_mul_ps( _mm512_set1_ps( p.k ), x ) );
+	}
+#endif
+};
+
+// x ( k + k2 x^2 )
+struct cubicLaw {
+	static constexpr bool active = true;
+	template < typename scalar >
+	static inline scalar force( scalar x, const lawParameters& p ) { return x * ( scalar( p.k ) + scalar( p.k2 ) * x * x ); }
+	template < typename scalar >
+	static inline scalar slope( scalar x, const lawParameters& p ) { return scalar( p.k ) + 3 * scalar( p.k2 ) * x * x; }
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+	__attribute__(( target( "sse4.2" ) ))
+	static inline __m128 force( __m128 x, const lawParameters& p ) {
+		return _mm_mul_ps( x, _mm_add_ps( _mm_set1_ps( p.k ), _mm_mul_ps( _mm_set1_ps( p.k2 ), _mm_mul_ps( x, x ) ) ) );
+	}
+	__attribute__(( target( "avx2,fma" ) ))
+	static inline __m256 force( __m256 x, const lawParameters& p ) {
+		return _mm256_mul_ps( x, _mm256_fmadd_ps( _mm256_set1_ps( p.k2 ), _mm256_mul_ps( x, x ), _mm256_set1_ps( p.k ) ) );
+	}
+	__attribute__(( target( "avx512f" ) ))
+	static inline __m512 force( __m512 x, const lawParameters& p ) {
+		return _mm512_mul_ps( x, _mm512_fmadd_ps( _mm512_set1_ps( p.k2 ), _mm512_mul_ps( x, x ), _mm512_set1_ps( p.k ) ) );
+	}
+#endif
+};
+
+// lerp between uniform samples - the segment index is clamped but the fraction isn't, so
+// past either end the outer segment extrapolates. the vector forms gather the two samples
+struct tabulatedLaw {
+	static constexpr bool active = true;
+	template < typename scalar >
+	static inline scalar force( scalar x, const lawParameters& p ) {
+		const scalar u = ( x - p.origin ) * p.inverseStep;
+		const int i = std::clamp( int( std::floor( u ) ), 0, p.lastSegment );
+		const scalar t = u - i;
+		return p.samples[ i ] + t * ( p.samples[ i + 1 ] - p.samples[ i ] );
+	}
+	template < typename scalar >
+	static inline scalar slope( scalar x, const lawParameters& p ) {
+		const scalar u = ( x - p.origin ) * p.inverseStep;
+		const int i = std::clamp( int( std::floor( u ) ), 0, p.lastSegment );
+		return ( scalar( p.samples[ i + 1 ] ) - p.samples[ i ] ) * p.inverseStep;
+	}
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+	// no gathers before AVX2, the lanes are looked up one at a time
+	__attribute__(( target( "sse4.2" ) ))
+	static inline __m128 force( __m128 x, const lawParameters& p ) {
+		const __m128 u = _mm_mul_ps( _mm_sub_ps( x, _mm_set1_ps( p.origin ) ), _mm_set1_ps( p.inverseStep ) );
+		const __m128i i = _mm_min_epi32( _mm_max_epi32( _mm_cvttps_epi32( _mm_floor_ps( u ) ), _mm_setzero_si128() ),
+		                                 _mm_set1_epi32( p.lastSegment ) );
+		alignas( 16 ) int lane[ 4 ];
+		_mm_store_si128( reinterpret_cast< __m128i* >( lane ), i );
+		const __m128 y0 = _mm_setr_ps( p.samples[ lane[ 0 ] ], p.samples[ lane[ 1 ] ], p.samples[ lane[ 2 ] ], p.samples[ lane[ 3 ] ] );
+		const __m128 y1 = _mm_setr_ps( p.samples[ lane[ 0 ] + 1 ], p.samples[ lane[ 1 ] + 1 ], p.samples[ lane[ 2 ] + 1 ], p.samples[ lane[ 3 ] + 1 ] );
+		const __m128 t = _mm_sub_ps( u, _mm_cvtepi32_ps( i ) );
+		return _mm_add_ps( y0, _mm_mul_ps( t, _mm_sub_ps( y1, y0 ) ) );
+	}
+	__attribute__(( target( "avx2,fma" ) ))
+	static inline __m256 force( __m256 x, const lawParameters& p ) {
+		const __m256 u = _mm256_mul_ps( _mm256_sub_ps( x, _mm256_set1_ps( p.origin ) ), _mm256_set1_ps( p.inverseStep ) );
+		const __m256i i = _mm256_min_epi32( _mm256_max_epi32( _mm256_cvttps_epi32( _mm256_floor_ps( u ) ), _mm256_setzero_si256() ),
+		                                    _mm256_set1_epi32( p.lastSegment ) );
+		const __m256 y0 = _mm256_i32gather_ps( p.samples, i, 4 );
+		const __m256 y1 = _mm256_i32gather_ps( p.samples + 1, i, 4 );
+		const __m256 t = _mm256_sub_ps( u, _mm256_cvtepi32_ps( i ) );
+		return _mm256_fmadd_ps( t, _mm256_sub_ps( y1, y0 ), y0 );
+	}
+	__attribute__(( target( "avx512f" ) ))
+	static inline __m512 force( __m512 x, const lawParameters& p ) {
+		const __m512 u = _mm512_mul_ps( _mm512_sub_ps( x, _mm512_set1_ps( p.origin ) ), _mm512_set1_ps( p.inverseStep ) );
+		// full mask forms again, see piecewiseLinearLaw
+		const __m512i zero = _mm512_setzero_si512();
+		const __m512i i = _mm512_mask_min_epi32( zero, 0xFFFF, _mm512_mask_max_epi32( zero, 0xFFFF,
+		                    _mm512_mask_cvttps_epi32( zero, 0xFFFF, _mm512_floor_ps( u ) ), zero ), _mm512_set1_epi32( p.lastSegment ) );
+		const __m512 y0 = _mm512_mask_i32gather_ps( _mm512_setzero_ps(), 0xFFFF, i, p.samples, 4 );
+		const __m512 y1 = _mm512_mask_i32gather_ps( _mm512_setzero_ps(), 0xFFFF, i, p.samples + 1, 4 );
+		const __m512 t = _mm512_sub_ps( u, _mm512_mask_cvtepi32_ps( _mm512_setzero_ps(), 0xFFFF, i ) );
+		return _mm512_fmadd_ps( t, _mm512_sub_ps( y1, y0 ), y0 );
+	}
+#endif
+};
+
+// the shock of a damper law that has none - the kernels skip the velocity gathers for it
+struct noLaw {
+	static constexpr bool active = false;
+	template < typename scalar >
+	static inline scalar force( scalar, const lawParameters& ) { return 0; }
+	template < typename scalar >
+	static inline scalar slope( scalar, const lawParameters& ) { return 0; }
+};
+
+// call f with the policy for a law, once, so the caller's body is instantiated per law
+template < typename function >
+inline void withForceLaw( int law, function&& f ) {
+	switch ( law ) {
+		case PIECEWISE_LINEAR_SPRING: f( piecewiseLinearLaw() ); break;
+		case CUBIC_SPRING:            f( cubicLaw() );           break;
+		case TABULATED_SPRING:        f( tabulatedLaw() );       break;
+		default:                      f( linearLaw() );          break;
+	}
+}
+
+template < typename function >
+inline void withDamperLaw( int law, function&& f ) {
+	switch ( law ) {
+		case LINEAR_DAMPER:    f( linearLaw() );    break;
+		case TABULATED_DAMPER: f( tabulatedLaw() ); break;
+		default:               f( noLaw() );        break;
+	}
+}
+
+const char* forceLawName( int law );
+const char* damperLawName( int law );
+
+#endif
@@ -0,0 +1,96 @@
+#include "graph_partition.h"
+
+#include <cstddef>
+#include <deque>
+
+// breadth first search from start over the unassigned free nodes, returns the last node
+// reached - repeating this from the result gives a node near the periphery of its component
+static int farthestUnassigned( const springTopology& topology, const std::vector< int >& part,
+  int firstNode, int start, std::vector< int >& visited, int& visitStamp ) {
+
+  visitStamp++;
+  std::deque< int > queue = { start };
+  visited[ start ] = visitStamp;
+  int last = start;
+  while ( !queue.empty() ) {
+    last = queue.front();
+    queue.pop_front();
+    for ( int i = topology.rowStart[ last ]; i < topology.rowStart[ last + 1 ]; i++ ) {
+      const int m = topology.neighbor[ i ];
+      if ( m >= firstNode && part[ m ] < 0 && visited[ m ] != visitStamp ) {
+        visited[ m ] = visitStamp;
+        queue.push_back( m );
+      }
+    }
+  }
+  return last;
+}
+
+graphPartition partitionGraph( const springTopology& topology, int firstNode, int numParts ) {
+  const int numNodes = topology.numNodes;
+  const int numFree = numNodes - firstNode;
+  if ( numParts < 1 ) numParts = 1;
+
+  graphPartition result;
+  result.order.reserve( numNodes );
+  for ( int n = 0; n < firstNode; n++ )
+    result.order.push_back( n );
+  result.partStart.push_back( firstNode );
+
+  std::vector< int > part( numNodes, -1 );
+  std::vector< int > visited( numNodes, 0 );
+  int visitStamp = 0;
+  int lowestUnassigned = firstNode;         // everything below this is assigned
+
+  // unassigned nodes adjacent to the part grown last, candidates for the next seed
+  std::vector< int > frontier;
+
+  for ( int p = 0; p < numParts; p++ ) {
+    const size_t target = firstNode + ( long( numFree ) * ( p + 1 ) ) / numParts;
+    std::deque< int > queue;
+
+    while ( result.order.size() < target ) {
+      if ( queue.empty() ) {
+        // seed from the previous part's frontier if possible, so parts sit next to each
+        // other, otherwise ( first part, or a new component ) from a peripheral node
+        int seed = -1;
+        for ( int candidate : frontier )
+          if ( part[ candidate ] < 0 ) { seed = candidate; break; }
+        if ( seed < 0 ) {
+          while ( part[ lowestUnassigned ] >= 0 ) lowestUnassigned++;
+          seed = farthestUnassigned( topology, part, firstNode, lowestUnassigned, visited, visitStamp );
+          seed = farthestUnassigned( topology, part, firstNode, seed, visited, visitStamp );
+        }
+        part[ seed ] = p;
+        result.order.push_back( seed );
+        queue.push_back( seed );
+        continue;
+      }
+
+      const int n = queue.front();
+      queue.pop_front();
+      for ( int i = topology.rowStart[ n ]; i < topology.rowStart[ n + 1 ] && result.order.size() < target; i++ ) {
+        const int m = topology.neighbor[ i ];
+        if ( m >= firstNode && part[ m ] < 0 ) {
+          part[ m ] = p;
+          result.order.push_back( m );
+          queue.push_back( m );
+        }
+      }
+    }
+
+    // whatever the search had not expanded yet borders this part
+    frontier.clear();
+    for ( int n : queue )
+      for ( int i = topology.rowStart[ n ]; i < topology.rowStart[ n + 1 ]; i++ )
+        if ( topology.neighbor[ i ] >= firstNode && part[ topology.neighbor[ i ] ] < 0 )
+          frontier.push_back( topology.neighbor[ i ] );
+
+    result.partStart.push_back( result.order.size() );
+  }
+
+  result.remap.resize( numNodes );
+  for ( int i = 0; i < numNodes; i++ )
+    result.remap[ result.order[ i ] ] = i;
+  return result;
+}
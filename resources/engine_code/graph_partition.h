@@ -0,0 +1,19 @@
+#ifndef GRAPH_PARTITION
+#define GRAPH_PARTITION
+
+#include "softbody_topology.h"
+
+// a renumbering of the nodes that makes each part one contiguous index range
+struct graphPartition {
+	std::vector< int > order;             // order[ newIndex ] = oldIndex
+	std::vector< int > remap;             // remap[ oldIndex ] = newIndex
+	std::vector< int > partStart;         // part p owns new indices [ partStart[ p ], partStart[ p + 1 ] )
+};
+
+// greedy BFS grower over the spring graph - nodes before firstNode ( anchored ) keep their
+// indices and belong to no part, the rest are split into numParts parts of equal size. each
+// part grows breadth first from a seed on the previous part's frontier, so parts are compact,
+// neighbors get nearby indices, and only a thin layer of nodes touches another part
+graphPartition partitionGraph( const springTopology& topology, int firstNode, int numParts );
+
+#endif
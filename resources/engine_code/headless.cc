@@ -0,0 +1,241 @@
+#include "softbody_core.h"
+#include "colors.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+// softbody_headless - the simulation with no window, GL context or UI, for running batches on
+// machines without a display. loads a frame, runs steps of substeps ticks as fast as it can, and
+// reports how long it took. one instance is split across the worker threads like the model does
+// it, more than one go through an ensemble, an instance per worker at a time
+
+static void Usage() {
+  cout << "usage: softbody_headless [options]\n"
+          "  --model <path>          frame to load, default carFrameWPanels.obj\n"
+          "  --steps <n>             steps to run, default 1000\n"
+          "  --substeps <n>          ticks per step, default 1\n"
+          "  --threads <n>           worker threads, default one per hardware thread\n"
+          "  --instances <n>         vehicles, each on its own road, default 1\n"
+          "  --out <path>            write a csv row per step - tick, checksum, max strain, timing\n"
+          "  --positions <path>      write the final node positions as csv\n"
+          "\n"
+          "  --solver <name>         explicit, implicit, xpbd or multirate\n"
+          "  --integrator <name>     euler, verlet or velocity-verlet\n"
+          "  --precision <name>      single, mixed or double\n"
+          "  --deterministic         fixed partition and scalar kernel, bit identical on any thread count\n"
+          "  --timescale <dt>        seconds per tick\n"
+          "  --adaptive              pick the tick from the stability limit, up to --max-timescale\n"
+          "  --max-timescale <dt>    adaptive: largest tick\n"
+          "  --safety <f>            adaptive: fraction of the stability limit used\n"
+          "  --energy-tolerance <f>  adaptive: energy gain per window that halves the tick\n"
+          "  --gravity <g>\n"
+          "  --mass <m>              chassis node mass\n"
+          "  --cg-iterations <n>     implicit solver iteration limit\n"
+          "  --cg-tolerance <r>      implicit solver relative residual\n"
+          "  --cg-preconditioner <p> jacobi or gauss-seidel\n"
+          "  --xpbd-substeps <n>\n"
+          "  --xpbd-iterations <n>\n"
+          "  --xpbd-coloring         project the edges by color across the whole graph\n"
+          "  --multirate-levels <n>  most kicks per tick are 2^( n - 1 )\n"
+          "  --multirate-safety <f>  fraction of each node's stability limit a kick takes\n"
+          "  --road <name>           noise, or iso8608 for a spectral profile in meters\n"
+          "  --road-class <c>        iso8608 roughness class, A to H\n"
+          "  --noise-amplitude <a>   road height scale\n"
+          "  --noise-speed <s>       how quickly the road moves\n"
+          "  --road-seed <n>         road of the first instance, the others count up from it\n"
+          "  --road-scale <s>        road frequency\n"
+          "  --road-noise <name>     builtin or fastnoise2, if the build has it\n"
+          "  --exact-road            sample the road noise at every wheel, no heightfield cache\n"
+          "  --spring-scale <s>      multiply every material's spring rate, k2 and spring curve\n"
+          "  --damping-scale <s>     multiply every material's damping and shock damper\n"
+          "\n"
+          "  --noise-benchmark       time the road noise backends and exit\n";
+}
+
+// index of name in names, or -1
+static int Lookup( const std::string& name, std::initializer_list< const char* > names ) {
+  int i = 0;
+  for ( const char* n : names ) {
+    if ( name == n ) return i;
+    i++;
+  }
+  return -1;
+}
+
+int main( int argc, char *argv[] ) {
+  std::string modelPath = "carFrameWPanels.obj";
+  std::string outPath, positionsPath;
+  int steps = 1000;
+  int substeps = 1;
+  int threads = std::thread::hardware_concurrency();
+  int instances = 1;
+  float springScale = 1.0f;
+  float dampingScale = 1.0f;
+  simParameterPack p;
+
+  // every option but --deterministic, --adaptive, --xpbd-coloring, --exact-road and --noise-benchmark
+  // takes a value
+  for ( int i = 1; i < argc; i++ ) {
+    const std::string option = argv[ i ];
+    if ( option == "--help" || option == "-h" ) { Usage(); return 0; }
+    if ( option == "--deterministic" ) { p.deterministic = true; continue; }
+    if ( option == "--adaptive" )      { p.adaptiveTimeStep = true; continue; }
+    if ( option == "--xpbd-coloring" ) { p.xpbdColoring = true; continue; }
+    if ( option == "--exact-road" )    { p.cacheRoad = false; continue; }
+    if ( option == "--noise-benchmark" ) { BenchmarkRoadNoise(); return 0; }
+    if ( i + 1 == argc ) { cerr << option << " needs a value" << endl; Usage(); return 1; }
+    const std::string value = argv[ ++i ];
+
+    try {
+      if      ( option == "--model" )            modelPath = value;
+      else if ( option == "--steps" )            steps = std::stoi( value );
+      else if ( option == "--substeps" )         substeps = std::stoi( value );
+      else if ( option == "--threads" )          threads = std::stoi( value );
+      else if ( option == "--instances" )        instances = std::stoi( value );
+      else if ( option == "--out" )              outPath = value;
+      else if ( option == "--positions" )        positionsPath = value;
+      else if ( option == "--solver" )           p.solver = Lookup( value, { "explicit", "implicit", "xpbd", "multirate" } );
+      else if ( option == "--integrator" )       p.integrator = Lookup( value, { "euler", "verlet", "velocity-verlet" } );
+      else if ( option == "--precision" )        p.precision = Lookup( value, { "single", "mixed", "double" } );
+      else if ( option == "--timescale" )        p.timeScale = std::stof( value );
+      else if ( option == "--max-timescale" )    p.maxTimeScale = std::stof( value );
+      else if ( option == "--safety" )           p.stabilitySafety = std::stof( value );
+      else if ( option == "--energy-tolerance" ) p.energyTolerance = std::stof( value );
+      else if ( option == "--gravity" )          p.gravity = std::stof( value );
+      else if ( option == "--mass" )             p.chassisNodeMass = std::stof( value );
+      else if ( option == "--cg-iterations" )    p.cgMaxIterations = std::stoi( value );
+      else if ( option == "--cg-tolerance" )     p.cgTolerance = std::stof( value );
+      else if ( option == "--cg-preconditioner" ) p.cgPreconditioner = Lookup( value, { "jacobi", "gauss-seidel" } );
+      else if ( option == "--xpbd-substeps" )    p.xpbdSubsteps = std::stoi( value );
+      else if ( option == "--xpbd-iterations" )  p.xpbdIterations = std::stoi( value );
+      else if ( option == "--multirate-levels" ) p.multirateLevels = std::stoi( value );
+      else if ( option == "--multirate-safety" ) p.multirateSafety = std::stof( value );
+      else if ( option == "--road" )             p.roadSource = Lookup( value, { "noise", "iso8608" } );
+      else if ( option == "--road-class" )       p.roadClass = Lookup( value, { "A", "B", "C", "D", "E", "F", "G", "H" } );
+      else if ( option == "--noise-amplitude" )  p.noiseAmplitudeScale = std::stof( value );
+      else if ( option == "--noise-speed" )      p.noiseSpeed = std::stof( value );
+      else if ( option == "--road-seed" )        p.roadSeed = std::stoi( value );
+      else if ( option == "--road-scale" )       p.roadScale = std::stof( value );
+      else if ( option == "--road-noise" )       p.roadNoiseBackend = Lookup( value, { "builtin", "fastnoise2" } );
+      else if ( option == "--spring-scale" )     springScale = std::stof( value );
+      else if ( option == "--damping-scale" )    dampingScale = std::stof( value );
+      else { cerr << "unknown option " << option << endl; Usage(); return 1; }
+    } catch ( const std::exception& ) {
+      cerr << "bad value " << value << " for " << option << endl;
+      return 1;
+    }
+  }
+  if ( p.solver < 0 || p.integrator < 0 || p.precision < 0 || p.cgPreconditioner < 0 ||
+    p.roadNoiseBackend < 0 || p.roadSource < 0 || p.roadClass < 0 ) {
+    cerr << "unknown solver, integrator, precision, preconditioner, road, road class or road noise name" << endl;
+    Usage();
+    return 1;
+  }
+  if ( steps < 0 || substeps < 1 || threads < 1 || instances < 1 ) {
+    cerr << "steps, substeps, threads and instances need to be positive" << endl;
+    return 1;
+  }
+  for ( material& m : p.materials ) {
+    // every stiffness term of the spring laws, and every damping term of the drag and the shocks
+    m.k *= springScale;
+    m.k2 *= springScale;
+    for ( glm::vec2& point : m.springCurve ) point.y *= springScale;
+    m.damping *= dampingScale;
+    m.shockDamping *= dampingScale;
+    for ( glm::vec2& point : m.shockCurve ) point.y *= dampingScale;
+  }
+
+  // same loading as the model - a single instance is split into a part per worker, an ensemble
+  // steps each instance whole so one part does
+  const auto loadStart = std::chrono::steady_clock::now();
+  if ( !std::ifstream( modelPath ) ) {
+    cerr << "can't read " << modelPath << endl;
+    return 1;
+  }
+  const std::shared_ptr< const vehicleGraph > graph = loadVehicleGraph( modelPath, p, instances == 1 ? threads : 1 );
+
+  ensemble vehicles( graph, instances, p, instances == 1 ? 1 : threads );
+  threadPool pool( instances == 1 ? threads : 1 );
+  const float loadMs = std::chrono::duration< float, std::milli >( std::chrono::steady_clock::now() - loadStart ).count();
+
+  cout << T_BLUE << "softbody_headless" << RESET << " - " << graph->nodes.size() << " nodes, " << graph->edges.size()
+       << " edges, " << instances << " instance" << ( instances == 1 ? "" : "s" ) << " on " << threads << " thread"
+       << ( threads == 1 ? "" : "s" ) << ", loaded in " << loadMs << "ms" << endl;
+
+  std::ofstream out;
+  if ( !outPath.empty() ) {
+    out.open( outPath );
+    if ( !out ) { cerr << "can't write " << outPath << endl; return 1; }
+    out << "step,tick,simulated seconds,tick size,checksum,max strain,step us" << endl;
+  }
+
+  // a single instance runs its ticks across the whole pool, an ensemble runs an instance per worker
+  double steppingSeconds = 0.0;
+  float maxStrain = 0.0f;
+  for ( int step = 0; step < steps; step++ ) {
+    const auto stepStart = std::chrono::steady_clock::now();
+    if ( instances == 1 ) {
+      softbodySimulation& s = vehicles[ 0 ];
+      for ( int t = 0; t < substeps; t++ )
+        s.Substep( pool, s.NoiseStep() );
+    } else {
+      vehicles.Step( substeps );
+    }
+    const double stepSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - stepStart ).count();
+    steppingSeconds += stepSeconds;
+
+    if ( out.is_open() ) {
+      float stepStrain = 0.0f;
+      for ( int i = 0; i < instances; i++ )
+        stepStrain = std::max( stepStrain, vehicles[ i ].MaxStrain() );
+      const uint64_t tick = vehicles[ 0 ].tickCount;
+      out << step << "," << tick << "," << vehicles[ 0 ].simulatedTime << "," << vehicles[ 0 ].simParameters.timeScale << "," << std::hex << vehicles.StateChecksum() << std::dec
+          << "," << stepStrain << "," << stepSeconds * 1e6 << endl;
+    }
+  }
+  for ( int i = 0; i < instances; i++ )
+    maxStrain = std::max( maxStrain, vehicles[ i ].MaxStrain() );
+
+  if ( !positionsPath.empty() ) {
+    std::ofstream positions( positionsPath );
+    if ( !positions ) { cerr << "can't write " << positionsPath << endl; return 1; }
+    positions << "instance,node,x,y,z" << endl;
+    for ( int i = 0; i < instances; i++ )
+      for ( size_t n = 0; n < graph->nodes.size(); n++ ) {
+        const glm::vec3 x = vehicles[ i ].nodePosition( n );
+        positions << i << "," << n << "," << x.x << "," << x.y << "," << x.z << endl;
+      }
+  }
+
+  // a non finite state reports as infinite strain, which fails the run
+  const uint64_t totalTicks = uint64_t( steps ) * substeps * instances;
+  double simulatedSeconds = 0.0;
+  for ( int i = 0; i < instances; i++ )
+    simulatedSeconds += vehicles[ i ].simulatedTime / instances;
+  const bool stable = std::isfinite( maxStrain );
+  cout << "  " << totalTicks << " ticks in " << std::fixed << std::setprecision( 3 ) << steppingSeconds << "s, "
+       << std::setprecision( 2 ) << ( totalTicks ? steppingSeconds * 1e6 / totalTicks : 0.0 ) << " us/tick, "
+       << ( steppingSeconds > 0.0 ? totalTicks / steppingSeconds : 0.0 ) << " ticks/s" << endl;
+  cout << "  " << std::setprecision( 3 ) << simulatedSeconds << "s simulated per instance, "
+       << std::setprecision( 1 ) << ( steppingSeconds > 0.0 ? simulatedSeconds * instances / steppingSeconds : 0.0 ) << "x real time" << endl;
+  if ( p.solver == MULTIRATE ) {
+    cout << "  multirate levels, free nodes per level -";
+    const std::vector< int > levels = vehicles[ 0 ].multirateLevelNodes();
+    for ( size_t l = 0; l < levels.size(); l++ )
+      cout << " " << ( 1 << l ) << "x: " << levels[ l ];
+    cout << ", " << vehicles[ 0 ].multirateSpringEvaluations() << " spring evaluations per tick" << endl;
+  }
+  cout << std::defaultfloat << std::setprecision( 6 ) << "  checksum " << std::hex << vehicles.StateChecksum() << std::dec
+       << ", max strain " << maxStrain << ( stable ? "" : " - unstable" ) << endl;
+
+  return stable ? 0 : 2;
+}
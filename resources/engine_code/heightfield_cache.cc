@@ -0,0 +1,91 @@
+#include "heightfield_cache.h"
+
+#include <algorithm>
+#include <cmath>
+
+void heightfieldCache::configure( float spacing, float uMin, float uMax, float vMin, float vMax ) {
+  this->spacing = spacing;
+  inverseSpacing = 1.0f / spacing;
+  this->vMin = vMin;
+  this->vMax = vMax;
+
+  // a column past each end, so the edges of the window still have a neighbor to blend with - and
+  // rows to cover the window wherever the offset puts it between grid rows
+  firstColumn = int( std::floor( uMin * inverseSpacing ) );
+  columns = int( std::ceil( uMax * inverseSpacing ) ) - firstColumn + 2;
+  ringRows = int( std::ceil( ( vMax - vMin ) * inverseSpacing ) ) + 3;
+  heights.assign( size_t( ringRows ) * columns, 0.0f );
+
+  firstRow = 0;
+  lastRow = -1;
+  rowsGenerated = regenerations = 0;
+}
+
+template < typename F >
+void heightfieldCache::scrollRows( const void* rowSource, int rowSeed, float offset, F&& fill ) {
+  if ( columns == 0 ) return;
+  const int low = int( std::floor( ( offset + vMin ) * inverseSpacing ) );
+  const int high = int( std::floor( ( offset + vMax ) * inverseSpacing ) ) + 1;
+
+  // nothing to keep - first use, a new road, a jump past the window or back ( the benchmark
+  // rewinds the offset )
+  if ( rowSeed != seed || rowSource != source || lastRow < firstRow || low < firstRow || low > lastRow ) {
+    seed = rowSeed;
+    source = rowSource;
+    firstRow = low;
+    lastRow = low - 1;
+    regenerations++;
+  }
+
+  // the newly exposed rows overwrite the ones that scrolled out, in a batch up to where the ring
+  // wraps and another after it
+  for ( int row = lastRow + 1; row <= high; ) {
+    const int last = std::min( high, row + ringRows - 1 - slot( row ) );
+    fill( row, last );
+    row = last + 1;
+  }
+  lastRow = std::max( lastRow, high );
+  firstRow = std::max( firstRow, lastRow - ringRows + 1 );
+}
+
+void heightfieldCache::scroll( const roadNoise& generator, int seed, float offset ) {
+  scrollRows( &generator, seed, offset, [&]( int first, int last ) { generate( generator, first, last ); } );
+}
+
+void heightfieldCache::scroll( spectralRoad& road, float offset ) {
+  scrollRows( &road, int( road.version() ), offset, [&]( int first, int last ) {
+    road.read( &heights[ size_t( slot( first ) ) * columns ], first, last - first + 1 );
+    rowsGenerated += last - first + 1;
+  } );
+}
+
+void heightfieldCache::generate( const roadNoise& generator, int first, int last ) {
+  // rows of the batch are contiguous in the ring, and GenUniformGrid2D writes x fastest
+  generator.GenUniformGrid2D( &heights[ size_t( slot( first ) ) * columns ], firstColumn, first,
+    columns, last - first + 1, spacing, seed );
+  rowsGenerated += last - first + 1;
+}
+
+bool heightfieldCache::sample( float u, float v, float& value, float* du, float* dv ) const {
+  // written so NaN falls out as a miss
+  const float x = u * inverseSpacing - firstColumn;
+  const float y = v * inverseSpacing;
+  if ( !( x >= 0.0f && x < float( columns - 1 ) && y >= float( firstRow ) && y < float( lastRow ) ) )
+    return false;
+
+  const int i = int( x );
+  const int j = int( std::floor( y ) );
+  const float wx = x - i;
+  const float wy = y - j;
+  const float* row0 = &heights[ size_t( slot( j ) ) * columns + i ];
+  const float* row1 = &heights[ size_t( slot( j + 1 ) ) * columns + i ];
+  const float lower = row0[ 0 ] + wx * ( row0[ 1 ] - row0[ 0 ] );
+  const float upper = row1[ 0 ] + wx * ( row1[ 1 ] - row1[ 0 ] );
+  value = lower + wy * ( upper - lower );
+  if ( du ) {
+    const float lowerSlope = row0[ 1 ] - row0[ 0 ];
+    *du = ( lowerSlope + wy * ( row1[ 1 ] - row1[ 0 ] - lowerSlope ) ) * inverseSpacing;
+  }
+  if ( dv ) *dv = ( upper - lower ) * inverseSpacing;
+  return true;
+}
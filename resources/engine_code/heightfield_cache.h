@@ -0,0 +1,72 @@
+#ifndef HEIGHTFIELD_CACHE
+#define HEIGHTFIELD_CACHE
+
+#include "road_noise.h"
+#include "spectral_road.h"
+
+#include <vector>
+
+// the road's noise, sampled on a regular grid and kept across ticks - the road only ever scrolls
+// along v, so a tick reuses every row it had and generates the few newly exposed ones, a batch at a
+// time through GenUniformGrid2D in place of a GenSingle2D call per sample. queries are bilinear
+// between the grid points. the rows live in a ring, row j in slot j mod ringRows, so scrolling
+// moves nothing. the window is fixed across u and rides the offset along v - queries outside it,
+// or made before the first scroll, report a miss and the caller samples the noise itself
+//
+// all in noise space ( the generator's input coordinates ) and raw noise values, so the road's
+// scale and amplitude are applied by the caller and changing them keeps the cache. a new seed, a
+// new generator or a scroll backwards regenerates the window
+class heightfieldCache {
+public:
+	// grid spacing, the window's extent across u, and along v relative to the scroll offset
+	void configure( float spacing, float uMin, float uMax, float vMin, float vMax );
+
+	// make the rows under [ offset + vMin, offset + vMax ] resident, generating the missing ones
+	void scroll( const roadNoise& generator, int seed, float offset );
+
+	// the same, with the missing rows read from a spectral road in place of generated - the road's
+	// grid has to be this one's, and reconfiguring it regenerates the window
+	void scroll( spectralRoad& road, float offset );
+
+	// bilinear noise at ( u, v ) into value, false if the point is outside the resident rows - and
+	// when asked for, the interpolated surface's derivatives along u and v
+	bool sample( float u, float v, float& value, float* du = nullptr, float* dv = nullptr ) const;
+
+	int rowsGenerated = 0;                // since configure, to see how much scrolling costs
+	int regenerations = 0;                // times the whole window was thrown away
+
+	// the ring as it is, for mirroring it elsewhere ( the model's ground texture ) - grid row j is
+	// ring row slot( j ), rows [ residentFirst(), residentLast() ] are valid, and grid column i
+	// is at u = ( columnStart() + i ) gridSpacing()
+	float gridSpacing() const { return spacing; }
+	int columnStart() const { return firstColumn; }
+	int numColumns() const { return columns; }
+	int numRingRows() const { return ringRows; }
+	int residentFirst() const { return firstRow; }
+	int residentLast() const { return lastRow; }
+	int slot( int row ) const { return ( ( row % ringRows ) + ringRows ) % ringRows; }
+	const float* ring() const { return heights.data(); }
+
+private:
+	float spacing = 0.0f;
+	float inverseSpacing = 0.0f;
+	float vMin = 0.0f, vMax = 0.0f;
+	int firstColumn = 0;                  // grid index of column 0, columns are at u = ( firstColumn + i ) spacing
+	int columns = 0;
+	int ringRows = 0;
+
+	int firstRow = 0;                     // resident rows are [ firstRow, lastRow ] - empty while lastRow < firstRow
+	int lastRow = -1;
+	int seed = 0;                         // or the road's version
+	const void* source = nullptr;         // the generator or spectral road the rows came from
+
+	std::vector< float > heights;         // ringRows x columns
+
+	// rows [ first, last ], none of which wrap around the ring, in one batch
+	void generate( const roadNoise& generator, int first, int last );
+
+	// either scroll, fill( first, last ) bringing in rows like generate
+	template < typename F > void scrollRows( const void* rowSource, int rowSeed, float offset, F&& fill );
+};
+
+#endif
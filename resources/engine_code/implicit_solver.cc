@@ -0,0 +1,364 @@
+#include "implicit_solver.h"
+
+#include <algorithm>
+#include <cmath>
+
+template < typename precision >
+void implicitSolver< precision >::resize( const springTopology& topology ) {
+  edgeBlock.resize( topology.numEdges );
+  diagonal.resize( topology.numNodes );
+  inverseDiagonal.resize( topology.numNodes );
+  inverseBlock.resize( topology.numNodes );
+  dv.resize( topology.numNodes );
+  residual.resize( topology.numNodes );
+  preconditioned.resize( topology.numNodes );
+  direction.resize( topology.numNodes );
+  product.resize( topology.numNodes );
+}
+
+template < typename precision >
+double implicitSolver< precision >::multiply( const springTopology& topology, const vectorField& x, vectorField& y,
+  int firstNode, int first, int last ) {
+
+  double dot = 0.0;
+  for ( int n = first; n < last; n++ ) {
+    scalar sx = diagonal.xx[ n ] * x.x[ n ] + diagonal.xy[ n ] * x.y[ n ] + diagonal.xz[ n ] * x.z[ n ];
+    scalar sy = diagonal.xy[ n ] * x.x[ n ] + diagonal.yy[ n ] * x.y[ n ] + diagonal.yz[ n ] * x.z[ n ];
+    scalar sz = diagonal.xz[ n ] * x.x[ n ] + diagonal.yz[ n ] * x.y[ n ] + diagonal.zz[ n ] * x.z[ n ];
+
+    // off diagonal blocks are -h^2 H_e, anchored neighbors are fixed and drop out
+    for ( int i = topology.rowStart[ n ]; i < topology.rowStart[ n + 1 ]; i++ ) {
+      const int m = topology.neighbor[ i ];
+      if ( m < firstNode ) continue;
+      const int e = topology.incidentEdge[ i ];
+      sx -= edgeBlock.xx[ e ] * x.x[ m ] + edgeBlock.xy[ e ] * x.y[ m ] + edgeBlock.xz[ e ] * x.z[ m ];
+      sy -= edgeBlock.xy[ e ] * x.x[ m ] + edgeBlock.yy[ e ] * x.y[ m ] + edgeBlock.yz[ e ] * x.z[ m ];
+      sz -= edgeBlock.xz[ e ] * x.x[ m ] + edgeBlock.yz[ e ] * x.y[ m ] + edgeBlock.zz[ e ] * x.z[ m ];
+    }
+
+    y.x[ n ] = sx; y.y[ n ] = sy; y.z[ n ] = sz;
+    dot += double( x.x[ n ] ) * sx + double( x.y[ n ] ) * sy + double( x.z[ n ] ) * sz;
+  }
+  return dot;
+}
+
+template < typename precision >
+template < typename law, typename damper >
+void implicitSolver< precision >::assembleEdges( const springTopology& topology, const lawParameters& spring,
+  const lawParameters& shock, const nodeState< storage >& current, scalar h, int first, int last ) {
+
+  const scalar h2 = h * h;
+  for ( int e = first; e < last; e++ ) {
+    const int n1 = topology.node1[ e ];
+    const int n2 = topology.node2[ e ];
+    const scalar dx = scalar( current.px[ n1 ] ) - current.px[ n2 ];
+    const scalar dy = scalar( current.py[ n1 ] ) - current.py[ n2 ];
+    const scalar dz = scalar( current.pz[ n1 ] ) - current.pz[ n2 ];
+    const scalar length = std::sqrt( dx * dx + dy * dy + dz * dz );
+    const scalar inverseLength = length > 0 ? 1 / length : 0;
+    const scalar ux = dx * inverseLength, uy = dy * inverseLength, uz = dz * inverseLength;
+
+    // along the spring the law's slope over L0, across it the tension over L - for hooke's law
+    // that's k / L0 ( u u^T + ( 1 - L0 / L ) ( I - u u^T ) ). both are clamped at zero, for
+    // compressed springs and falling curves, so the matrix stays positive definite
+    const scalar stretch = length / topology.baseLength[ e ] - 1;
+    scalar along = h2 * std::max( scalar( 0 ), scalar( law::slope( stretch, spring ) ) ) / topology.baseLength[ e ];
+    const scalar across = h2 * std::max( scalar( 0 ), scalar( law::force( stretch, spring ) ) ) * inverseLength;
+
+    if constexpr ( damper::active ) {
+      const scalar rate = ( ux * ( scalar( current.vx[ n1 ] ) - current.vx[ n2 ] ) + uy * ( scalar( current.vy[ n1 ] ) - current.vy[ n2 ] )
+                          + uz * ( scalar( current.vz[ n1 ] ) - current.vz[ n2 ] ) );
+      const scalar secant = rate != 0 ? scalar( damper::force( rate, shock ) ) / rate : scalar( shock.k );
+      along += h * std::max( scalar( 0 ), secant );
+    }
+
+    const scalar a = along - across;
+    edgeBlock.xx[ e ] = a * ux * ux + across; edgeBlock.xy[ e ] = a * ux * uy; edgeBlock.xz[ e ] = a * ux * uz;
+    edgeBlock.yy[ e ] = a * uy * uy + across; edgeBlock.yz[ e ] = a * uy * uz;
+    edgeBlock.zz[ e ] = a * uz * uz + across;
+  }
+}
+
+template < typename precision >
+void implicitSolver< precision >::step( threadPool& pool, const springTopology& topology, const springConstants& constants,
+  const alignedArray< scalar >& inverseMass, const nodeState< storage >& current, nodeState< storage >& next,
+  forceAccumulator< scalar >& forces, forceAccumulator< scalar >& crossForces,
+  float timeStep, float gravity, int firstNode, int maxIterations, float tolerance, int preconditioner ) {
+
+  const scalar h = timeStep;
+  const bool gaussSeidelPreconditioner = preconditioner == GAUSS_SEIDEL_PRECONDITIONER;
+  partials.resize( topology.numParts );
+
+  // spring forces at the current state through the usual kernels, and each spring's stiffness
+  // block - the shocks' forces are left to C, since h C v reproduces them
+  springsOnly = constants;
+  std::fill( springsOnly.damper.begin(), springsOnly.damper.end(), int( NO_DAMPER ) );
+  pool.forEach( topology.numParts, [&]( int p, int ) {
+    accumulateSpringForces( topology, springsOnly, current, forces, crossForces, p );
+    for ( int b = topology.partBatchStart[ p ]; b < topology.partBatchStart[ p + 1 ]; b++ ) {
+      const int m = topology.batchMaterial[ b ];
+      withForceLaw( constants.law[ m ], [&]( auto law ) {
+        withDamperLaw( constants.damper[ m ], [&]( auto damper ) {
+          assembleEdges< decltype( law ), decltype( damper ) >( topology, constants.springLaw( m ), constants.shockLaw( m ),
+            current, h, topology.batchStart[ b ], topology.batchStart[ b + 1 ] );
+        } );
+      } );
+    }
+  } );
+
+  // finish the forces, assemble the diagonal and right hand side, and start CG from the
+  // previous tick's dv
+  pool.forEach( topology.numParts, [&]( int p, int ) {
+    gatherHaloForces( topology, constants, current, forces, crossForces, p );
+
+    double rz = 0.0, rr = 0.0, bb = 0.0;
+    for ( int n = topology.partNodeStart[ p ]; n < topology.partNodeStart[ p + 1 ]; n++ ) {
+      if ( inverseMass[ n ] == 0.0f ) {
+        // massless free node - no spring response, it only falls ( see the velocity update below ).
+        // its dv is a fixed value here, which the neighbors' rows pick up through r = b - A dv
+        diagonal.xx[ n ] = diagonal.yy[ n ] = diagonal.zz[ n ] = 1.0f;
+        diagonal.xy[ n ] = diagonal.xz[ n ] = diagonal.yz[ n ] = 0.0f;
+        inverseDiagonal.x[ n ] = inverseDiagonal.y[ n ] = inverseDiagonal.z[ n ] = 1.0f;
+        residual.x[ n ] = residual.y[ n ] = residual.z[ n ] = 0.0f;
+        preconditioned.x[ n ] = preconditioned.y[ n ] = preconditioned.z[ n ] = 0.0f;
+        direction.x[ n ] = direction.y[ n ] = direction.z[ n ] = 0.0f;
+        forces.fx[ n ] = forces.fy[ n ] = forces.fz[ n ] = 0.0f;
+        continue;
+      }
+      const scalar mass = 1 / inverseMass[ n ];
+
+      // damping is on each endpoint's own velocity, so C is diagonal - the sum over the edges
+      scalar damping = 0;
+      scalar xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+      scalar bx = 0, by = 0, bz = 0;
+      for ( int i = topology.rowStart[ n ]; i < topology.rowStart[ n + 1 ]; i++ ) {
+        const int m = topology.neighbor[ i ];
+        const int e = topology.incidentEdge[ i ];
+        damping += constants.d[ topology.material[ e ] ];
+        xx += edgeBlock.xx[ e ]; xy += edgeBlock.xy[ e ]; xz += edgeBlock.xz[ e ];
+        yy += edgeBlock.yy[ e ]; yz += edgeBlock.yz[ e ]; zz += edgeBlock.zz[ e ];
+
+        // - h^2 H_e ( v_n - v_m )
+        const scalar wx = scalar( current.vx[ n ] ) - current.vx[ m ];
+        const scalar wy = scalar( current.vy[ n ] ) - current.vy[ m ];
+        const scalar wz = scalar( current.vz[ n ] ) - current.vz[ m ];
+        bx -= edgeBlock.xx[ e ] * wx + edgeBlock.xy[ e ] * wy + edgeBlock.xz[ e ] * wz;
+        by -= edgeBlock.xy[ e ] * wx + edgeBlock.yy[ e ] * wy + edgeBlock.yz[ e ] * wz;
+        bz -= edgeBlock.xz[ e ] * wx + edgeBlock.yz[ e ] * wy + edgeBlock.zz[ e ] * wz;
+      }
+
+      const scalar massDamping = mass + h * damping;
+      diagonal.xx[ n ] = massDamping + xx; diagonal.xy[ n ] = xy; diagonal.xz[ n ] = xz;
+      diagonal.yy[ n ] = massDamping + yy; diagonal.yz[ n ] = yz;
+      diagonal.zz[ n ] = massDamping + zz;
+      inverseDiagonal.x[ n ] = 1 / diagonal.xx[ n ];
+      inverseDiagonal.y[ n ] = 1 / diagonal.yy[ n ];
+      inverseDiagonal.z[ n ] = 1 / diagonal.zz[ n ];
+      if ( gaussSeidelPreconditioner ) {
+        // by cofactors - the block is the mass plus positive semidefinite terms, never singular
+        const scalar a = diagonal.xx[ n ], b = xy, c = xz, d = diagonal.yy[ n ], e = yz, f = diagonal.zz[ n ];
+        const scalar cxx = d * f - e * e, cxy = c * e - b * f, cxz = b * e - c * d;
+        const scalar inverseDeterminant = 1 / ( a * cxx + b * cxy + c * cxz );
+        inverseBlock.xx[ n ] = cxx * inverseDeterminant; inverseBlock.xy[ n ] = cxy * inverseDeterminant; inverseBlock.xz[ n ] = cxz * inverseDeterminant;
+        inverseBlock.yy[ n ] = ( a * f - c * c ) * inverseDeterminant; inverseBlock.yz[ n ] = ( b * c - a * e ) * inverseDeterminant;
+        inverseBlock.zz[ n ] = ( a * d - b * b ) * inverseDeterminant;
+      }
+
+      // gravity is an acceleration, so it enters as a force scaled by the mass
+      bx += h * forces.fx[ n ];
+      by += h * ( forces.fy[ n ] - mass * gravity );
+      bz += h * forces.fz[ n ];
+      forces.fx[ n ] = forces.fy[ n ] = forces.fz[ n ] = 0.0f;
+
+      residual.x[ n ] = bx; residual.y[ n ] = by; residual.z[ n ] = bz;
+      bb += double( bx ) * bx + double( by ) * by + double( bz ) * bz;
+    }
+
+    // r = b - A dv, neighbors' dv is only read here, so this can run alongside the other parts
+    multiply( topology, dv, product, firstNode, topology.partNodeStart[ p ], topology.partNodeStart[ p + 1 ] );
+    for ( int n = topology.partNodeStart[ p ]; n < topology.partNodeStart[ p + 1 ]; n++ ) {
+      if ( inverseMass[ n ] == 0.0f ) continue;
+      residual.x[ n ] -= product.x[ n ];
+      residual.y[ n ] -= product.y[ n ];
+      residual.z[ n ] -= product.z[ n ];
+      if ( !gaussSeidelPreconditioner ) {
+        preconditioned.x[ n ] = direction.x[ n ] = residual.x[ n ] * inverseDiagonal.x[ n ];
+        preconditioned.y[ n ] = direction.y[ n ] = residual.y[ n ] * inverseDiagonal.y[ n ];
+        preconditioned.z[ n ] = direction.z[ n ] = residual.z[ n ] * inverseDiagonal.z[ n ];
+        rz += double( residual.x[ n ] ) * preconditioned.x[ n ] + double( residual.y[ n ] ) * preconditioned.y[ n ] + double( residual.z[ n ] ) * preconditioned.z[ n ];
+      }
+      rr += double( residual.x[ n ] ) * residual.x[ n ] + double( residual.y[ n ] ) * residual.y[ n ] + double( residual.z[ n ] ) * residual.z[ n ];
+    }
+
+    partials[ p ].a = rz;
+    partials[ p ].b = rr;
+    partials[ p ].c = bb;
+  } );
+  clearForces( forces, 0, firstNode );
+
+  // the Gauss-Seidel preconditioner can't be applied a node at a time like Jacobi, it runs as
+  // its own sweeps once the residual is complete - this returns r . M^-1 r, and on the first
+  // call also sets the search direction
+  auto gaussSeidelDot = [&]( bool first ) {
+    gaussSeidel( pool, topology, inverseMass, firstNode );
+    pool.forEach( topology.numParts, [&]( int p, int ) {
+      double dot = 0.0;
+      for ( int n = topology.partNodeStart[ p ]; n < topology.partNodeStart[ p + 1 ]; n++ ) {
+        if ( first ) {
+          direction.x[ n ] = preconditioned.x[ n ];
+          direction.y[ n ] = preconditioned.y[ n ];
+          direction.z[ n ] = preconditioned.z[ n ];
+        }
+        dot += double( residual.x[ n ] ) * preconditioned.x[ n ] + double( residual.y[ n ] ) * preconditioned.y[ n ] + double( residual.z[ n ] ) * preconditioned.z[ n ];
+      }
+      partials[ p ].a = dot;
+    } );
+    double dot, unused;
+    sumPartials( dot, unused, unused );
+    return dot;
+  };
+
+  double rz = 0.0, rr = 0.0, bb = 0.0;
+  sumPartials( rz, rr, bb );
+  const double target = double( tolerance ) * tolerance * bb;
+  if ( gaussSeidelPreconditioner )
+    rz = gaussSeidelDot( true );
+
+  int iteration = 0;
+  for ( ; iteration < maxIterations && rr > target; iteration++ ) {
+    // q = A p
+    pool.forEach( topology.numParts, [&]( int p, int ) {
+      partials[ p ].a = multiply( topology, direction, product, firstNode,
+        topology.partNodeStart[ p ], topology.partNodeStart[ p + 1 ] );
+    } );
+    double pAq, unused;
+    sumPartials( pAq, unused, unused );
+    if ( pAq <= 0.0 ) break;
+    const scalar alpha = rz / pAq;
+
+    // step along p, update the residual, precondition
+    pool.forEach( topology.numParts, [&]( int p, int ) {
+      double rzPart = 0.0, rrPart = 0.0;
+      for ( int n = topology.partNodeStart[ p ]; n < topology.partNodeStart[ p + 1 ]; n++ ) {
+        if ( inverseMass[ n ] == 0.0f ) continue;
+        dv.x[ n ] += alpha * direction.x[ n ];
+        dv.y[ n ] += alpha * direction.y[ n ];
+        dv.z[ n ] += alpha * direction.z[ n ];
+        residual.x[ n ] -= alpha * product.x[ n ];
+        residual.y[ n ] -= alpha * product.y[ n ];
+        residual.z[ n ] -= alpha * product.z[ n ];
+        if ( !gaussSeidelPreconditioner ) {
+          preconditioned.x[ n ] = residual.x[ n ] * inverseDiagonal.x[ n ];
+          preconditioned.y[ n ] = residual.y[ n ] * inverseDiagonal.y[ n ];
+          preconditioned.z[ n ] = residual.z[ n ] * inverseDiagonal.z[ n ];
+          rzPart += double( residual.x[ n ] ) * preconditioned.x[ n ] + double( residual.y[ n ] ) * preconditioned.y[ n ] + double( residual.z[ n ] ) * preconditioned.z[ n ];
+        }
+        rrPart += double( residual.x[ n ] ) * residual.x[ n ] + double( residual.y[ n ] ) * residual.y[ n ] + double( residual.z[ n ] ) * residual.z[ n ];
+      }
+      partials[ p ].a = rzPart;
+      partials[ p ].b = rrPart;
+    } );
+    double rzNext;
+    sumPartials( rzNext, rr, unused );
+    if ( rr <= target ) { iteration++; break; }
+    if ( gaussSeidelPreconditioner )
+      rzNext = gaussSeidelDot( false );
+    const scalar beta = rzNext / rz;
+    rz = rzNext;
+
+    // new search direction - a separate pass, since the product above reads neighbors' p
+    pool.forEach( topology.numParts, [&]( int p, int ) {
+      for ( int n = topology.partNodeStart[ p ]; n < topology.partNodeStart[ p + 1 ]; n++ ) {
+        direction.x[ n ] = preconditioned.x[ n ] + beta * direction.x[ n ];
+        direction.y[ n ] = preconditioned.y[ n ] + beta * direction.y[ n ];
+        direction.z[ n ] = preconditioned.z[ n ] + beta * direction.z[ n ];
+      }
+    } );
+  }
+  lastIterations = iteration;
+  lastResidual = bb > 0.0 ? std::sqrt( rr / bb ) : 0.0f;
+
+  // v += dv, then position from the new velocity, as in integrateNodes
+  pool.forEach( topology.numParts, [&]( int p, int ) {
+    for ( int n = topology.partNodeStart[ p ]; n < topology.partNodeStart[ p + 1 ]; n++ ) {
+      if ( inverseMass[ n ] == 0.0f ) {
+        // gravity alone, as integrateNodes gives it
+        dv.x[ n ] = dv.z[ n ] = 0.0f;
+        dv.y[ n ] = -gravity * h;
+      }
+      const scalar vx = current.vx[ n ] + dv.x[ n ];
+      const scalar vy = current.vy[ n ] + dv.y[ n ];
+      const scalar vz = current.vz[ n ] + dv.z[ n ];
+      next.vx[ n ] = vx; next.vy[ n ] = vy; next.vz[ n ] = vz;
+      next.px[ n ] = current.px[ n ] + vx * h;
+      next.py[ n ] = current.py[ n ] + vy * h;
+      next.pz[ n ] = current.pz[ n ] + vz * h;
+    }
+  } );
+}
+
+template < typename precision >
+void implicitSolver< precision >::gaussSeidel( threadPool& pool, const springTopology& topology,
+  const alignedArray< scalar >& inverseMass, int firstNode ) {
+
+  // sum of H_e z_m over the free neighbors of n on the given side of its color - the off
+  // diagonal blocks of A are - H_e, massless nodes are left out like Jacobi leaves them at zero
+  auto neighborSum = [&]( int n, bool lower, scalar& tx, scalar& ty, scalar& tz ) {
+    const int color = topology.nodeColor[ n ];
+    for ( int i = topology.rowStart[ n ]; i < topology.rowStart[ n + 1 ]; i++ ) {
+      const int m = topology.neighbor[ i ];
+      if ( m < firstNode || inverseMass[ m ] == 0.0f || ( topology.nodeColor[ m ] < color ) != lower ) continue;
+      const int e = topology.incidentEdge[ i ];
+      tx += edgeBlock.xx[ e ] * preconditioned.x[ m ] + edgeBlock.xy[ e ] * preconditioned.y[ m ] + edgeBlock.xz[ e ] * preconditioned.z[ m ];
+      ty += edgeBlock.xy[ e ] * preconditioned.x[ m ] + edgeBlock.yy[ e ] * preconditioned.y[ m ] + edgeBlock.yz[ e ] * preconditioned.z[ m ];
+      tz += edgeBlock.xz[ e ] * preconditioned.x[ m ] + edgeBlock.yz[ e ] * preconditioned.y[ m ] + edgeBlock.zz[ e ] * preconditioned.z[ m ];
+    }
+  };
+  auto solveBlock = [&]( int n, scalar tx, scalar ty, scalar tz, scalar& x, scalar& y, scalar& z ) {
+    x = inverseBlock.xx[ n ] * tx + inverseBlock.xy[ n ] * ty + inverseBlock.xz[ n ] * tz;
+    y = inverseBlock.xy[ n ] * tx + inverseBlock.yy[ n ] * ty + inverseBlock.yz[ n ] * tz;
+    z = inverseBlock.xz[ n ] * tx + inverseBlock.yz[ n ] * ty + inverseBlock.zz[ n ] * tz;
+  };
+
+  // forward, ( D + L ) y = r - the lower colors already hold y
+  for ( int c = 0; c < topology.numNodeColors(); c++ ) {
+    const int first = topology.nodeColorStart[ c ];
+    pool.forEach( topology.nodeColorStart[ c + 1 ] - first, [&]( int i, int ) {
+      const int n = topology.colorNode[ first + i ];
+      if ( inverseMass[ n ] == 0.0f ) {
+        preconditioned.x[ n ] = preconditioned.y[ n ] = preconditioned.z[ n ] = 0.0f;
+        return;
+      }
+      scalar tx = residual.x[ n ], ty = residual.y[ n ], tz = residual.z[ n ];
+      neighborSum( n, true, tx, ty, tz );
+      solveBlock( n, tx, ty, tz, preconditioned.x[ n ], preconditioned.y[ n ], preconditioned.z[ n ] );
+    } );
+  }
+
+  // backward, ( D + U ) z = D y, in place - the higher colors already hold z
+  for ( int c = topology.numNodeColors() - 1; c >= 0; c-- ) {
+    const int first = topology.nodeColorStart[ c ];
+    pool.forEach( topology.nodeColorStart[ c + 1 ] - first, [&]( int i, int ) {
+      const int n = topology.colorNode[ first + i ];
+      if ( inverseMass[ n ] == 0.0f ) return;
+      scalar tx = 0, ty = 0, tz = 0, x, y, z;
+      neighborSum( n, false, tx, ty, tz );
+      solveBlock( n, tx, ty, tz, x, y, z );
+      preconditioned.x[ n ] += x;
+      preconditioned.y[ n ] += y;
+      preconditioned.z[ n ] += z;
+    } );
+  }
+}
+
+template < typename precision >
+void implicitSolver< precision >::sumPartials( double& a, double& b, double& c ) const {
+  // in part order, so the result does not depend on how parts were spread over workers
+  a = b = c = 0.0;
+  for ( const auto& p : partials )
+    a += p.a, b += p.b, c += p.c;
+}
+
+template class implicitSolver< singlePrecision >;
+template class implicitSolver< mixedPrecision >;
+template class implicitSolver< doublePrecision >;
@@ -0,0 +1,95 @@
+#ifndef IMPLICIT_SOLVER
+#define IMPLICIT_SOLVER
+
+#include "softbody_kernels.h"
+#include "thread_pool.h"
+
+#include <vector>
+
+// backward euler for the spring graph - each tick linearizes the spring forces about the
+// current state and solves
+//
+//   ( M + h C + h^2 H ) dv = h ( f + M g ) - h^2 H v
+//
+// for the change in velocity dv, where C is the damping and H the spring stiffness, each spring's
+// from the slope of its force law. C is the per node drag on the diagonal, plus each shock along
+// its spring by its secant, force / extension speed, so h C v is exactly the shock's force.
+// the matrix is symmetric block sparse with 3x3 blocks on the spring graph - one block per node
+// on the diagonal, and one block per edge, used for both ( n, m ) and ( m, n ). the pattern is
+// the topology's CSR adjacency, so it is built once and each tick only refills the values. the
+// matrix, the CG vectors and all the arithmetic are in the precision's accumulator type
+
+// how CG preconditions the residual
+enum preconditionerType {
+	JACOBI_PRECONDITIONER,                // the diagonal entries of each node's block
+	GAUSS_SEIDEL_PRECONDITIONER           // symmetric block Gauss-Seidel, a sweep each way over the node colors
+};
+
+template < typename precision >
+class implicitSolver {
+public:
+	using storage = typename precision::storage;
+	using scalar  = typename precision::accumulator;
+
+	// size the per node and per edge storage for this topology, and drop the warm start
+	void resize( const springTopology& topology );
+
+	// one tick for the free nodes [ firstNode, numNodes ) from current into next, solved with
+	// preconditioned conjugate gradient, split across the pool by part. forces is used as scratch
+	// and left zeroed, like after integrateNodes. the Gauss-Seidel preconditioner solves each
+	// node's 3x3 block exactly and takes its neighbors into account, so it needs far fewer
+	// iterations, but runs a dispatch per node color twice per iteration - it pays off once the
+	// iterations, not the dispatches, are the cost
+	void step( threadPool& pool, const springTopology& topology, const springConstants& constants,
+		const alignedArray< scalar >& inverseMass, const nodeState< storage >& current, nodeState< storage >& next,
+		forceAccumulator< scalar >& forces, forceAccumulator< scalar >& crossForces,
+		float timeStep, float gravity, int firstNode, int maxIterations, float tolerance,
+		int preconditioner = JACOBI_PRECONDITIONER );
+
+	int lastIterations = 0;               // CG iterations taken by the last step
+	float lastResidual = 0.0f;            // relative residual norm the last step stopped at
+
+private:
+	// symmetric 3x3 blocks, six unique entries each
+	struct symmetricBlocks {
+		alignedArray< scalar > xx, xy, xz, yy, yz, zz;
+		void resize( size_t n ) { xx.resize( n ); xy.resize( n ); xz.resize( n ); yy.resize( n ); yz.resize( n ); zz.resize( n ); }
+	};
+
+	struct vectorField {
+		alignedArray< scalar > x, y, z;
+		void resize( size_t n ) { x.resize( n ); y.resize( n ); z.resize( n ); }
+	};
+
+	// per part partial dot products, each on its own line
+	struct alignas( cacheLineSize ) partialSums {
+		double a, b, c;
+	};
+
+	symmetricBlocks edgeBlock;            // h^2 H_e, the stiffness of each spring
+	symmetricBlocks diagonal;             // M + h C + h^2 sum of H_e, per node
+	vectorField inverseDiagonal;          // Jacobi preconditioner
+	symmetricBlocks inverseBlock;         // inverse of each node's diagonal block, for Gauss-Seidel
+
+	vectorField dv;                       // solution, kept as the next tick's initial guess
+	vectorField residual, preconditioned, direction, product;
+
+	std::vector< partialSums > partials;
+	springConstants springsOnly;          // the constants with the shocks taken out, for the force pass
+
+	// h^2 H_e, and h C_e for the shock, of the edges [ first, last ), all of one material
+	template < typename law, typename damper >
+	void assembleEdges( const springTopology& topology, const lawParameters& spring, const lawParameters& shock,
+		const nodeState< storage >& current, scalar h, int first, int last );
+	void sumPartials( double& a, double& b, double& c ) const;
+
+	// preconditioned = M^-1 residual for the symmetric Gauss-Seidel M = ( D + L ) D^-1 ( D + U ),
+	// L and U the blocks to lower and higher colors - forward over the colors, then back
+	void gaussSeidel( threadPool& pool, const springTopology& topology, const alignedArray< scalar >& inverseMass, int firstNode );
+
+	// y = A x for the nodes [ first, last ), returns the part of dot( x, y ) from those nodes
+	double multiply( const springTopology& topology, const vectorField& x, vectorField& y,
+		int firstNode, int first, int last );
+};
+
+#endif
@@ -1,7 +1,14 @@
 #include "engine.h"
 
 int main( int argc, char *argv[] ) {
-  engine e;
+  // --double or --mixed picks the simulation precision, float otherwise
+  int precision = SINGLE_PRECISION;
+  for ( int i = 1; i < argc; i++ ) {
+    if ( std::string( argv[ i ] ) == "--double" ) precision = DOUBLE_PRECISION;
+    if ( std::string( argv[ i ] ) == "--mixed" )  precision = MIXED_PRECISION;
+  }
+
+  engine e( precision );
 
   while( !e.mainLoop() );
 
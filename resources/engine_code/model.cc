@@ -1,165 +1,28 @@
 #include "model.h"
 
 #include <iostream>
-#include <fstream>
 #include <string>
 
 model::model() {
-  auto fnSimplex = FastNoise::New<FastNoise::Simplex>();
-  auto fnFractal = FastNoise::New<FastNoise::FractalFBm>();
-
-  fnFractal->SetSource( fnSimplex );
-  fnFractal->SetOctaveCount( 2 );
-
-  fnGenerator = fnFractal;
-
-  // spawn all the threads
-	for ( int i = 0; i < numThreads; i++ ) {
-		workerState[ i ] = WAITING;
-		workerThreads[ i ] = std::thread( &model::MultiThreadUpdateFunc, this, i );
-	}
+  // the road scrolls under the car at the display scale, and the ground is drawn from its cache
+  simulation.simParameters.roadScale = displayParameters.scale;
+  simulation.roadDrawn = true;
 }
 
 model::~model() {
-  // quit and join all the threads
-	for ( int i = 0; i < numThreads; i++ ) {
-		workerState[ i ] = QUIT;
-		workerThreads[ i ].join();
-	}
+  // pool joins its threads on destruction
 }
 
 void model::loadFramePoints() {
-  // clear out data, so this can also be used as a reset
-  nodes.clear();
-  edges.clear();
-  faces.clear();
-
-  // assumes obj file without the annotations -
-    // specifically carFrameWPanels.obj which has a few lines already removed
-
-  std::ifstream infile( "carFrameWPanels.obj" );
-  std::vector< glm::vec3 > normals;
-
-  // add the anchored points ( wheel control points )
-  int offset = 3; // for 4 anchored wheel points, this is 3 - to eat up the off-by-one from the one-indexed OBJ format
-
-  // add anchored wheel control points here
-  addNode( &simParameters.anchoredNodeMass, glm::vec3( -0.6125f, -0.38f,  1.95f ),  true ); // front left
-  addNode( &simParameters.anchoredNodeMass, glm::vec3(  0.6125f, -0.38f,  1.95f ),  true ); // front right
-  addNode( &simParameters.anchoredNodeMass, glm::vec3( -0.7f,    -0.38f, -0.86f ),  true ); // back left
-  addNode( &simParameters.anchoredNodeMass, glm::vec3(  0.7f,    -0.38f, -0.86f ),  true ); // back right
-
-  while ( infile.peek() != EOF ) {
-    std::string read;
-    infile >> read;
-
-    if ( read == "v" ) {
-      float x, y, z;
-      infile >> x >> y >> z;
-      // add an unanchored node, with the configured node mass
-      addNode( &simParameters.chassisNodeMass, glm::vec3( x, y, z ), false );
-    } else if ( read == "vn" ) {
-      float x, y, z;
-      infile >> x >> y >> z;
-      normals.push_back( glm::vec3( x, y, z ) );  // three floats determine the normal vector
-    } else if ( read == "f" ) {
-      char throwaway;
-      int xIndex, yIndex, zIndex, nIndex;
-      infile >> xIndex >> throwaway >> throwaway >> nIndex
-             >> yIndex >> throwaway >> throwaway >> nIndex
-             >> zIndex >> throwaway >> throwaway >> nIndex;
-      // this needs the three node indices, as well as the normal from the normals list
-      addFace( xIndex + offset, yIndex + offset, zIndex + offset, normals[ nIndex - 1 ] );
-      // add the three edges of the triangle, since the obj export skips edges which are included in a face
-      addEdge( xIndex + offset, yIndex + offset, CHASSIS );
-      addEdge( zIndex + offset, yIndex + offset, CHASSIS );
-      addEdge( zIndex + offset, xIndex + offset, CHASSIS );
-    } else if ( read == "l" ) {
-      int index1, index2;
-      infile >> index1 >> index2;
-      addEdge( index1 + offset, index2 + offset, CHASSIS ); // two node indices ( offset to match the list ), CHASSIS type
-    }
-  }
-// suspension edge
-  // front left
-  addEdge( 0, 25, SUSPENSION );
-  addEdge( 0, 35, SUSPENSION );
-  addEdge( 0, 37, SUSPENSION );
-  addEdge( 0, 39, SUSPENSION );
-  addEdge( 0, 41, SUSPENSION );
-  addEdge( 0, 42, SUSPENSION );
-  addEdge( 0, 43, SUSPENSION );
-  addEdge( 0, 44, SUSPENSION );
-  addEdge( 0, 45, SUSPENSION );
-  // mirrored SUSPENSION1 edges
-  addEdge( 0, 13, SUSPENSION1 );
-  addEdge( 0, 15, SUSPENSION1 );
-  addEdge( 0, 17, SUSPENSION1 );
-  addEdge( 0, 19, SUSPENSION1 );
-  addEdge( 0, 20, SUSPENSION1 );
-  addEdge( 0, 21, SUSPENSION1 );
-  addEdge( 0, 22, SUSPENSION1 );
-  addEdge( 0, 23, SUSPENSION1 );
-  addEdge( 0, 24, SUSPENSION1 );
-
-  // front right
-  addEdge( 1, 13, SUSPENSION );
-  addEdge( 1, 15, SUSPENSION );
-  addEdge( 1, 17, SUSPENSION );
-  addEdge( 1, 19, SUSPENSION );
-  addEdge( 1, 20, SUSPENSION );
-  addEdge( 1, 21, SUSPENSION );
-  addEdge( 1, 22, SUSPENSION );
-  addEdge( 1, 23, SUSPENSION );
-  addEdge( 1, 24, SUSPENSION );
-  // mirrored SUSPENSION1 edges
-  addEdge( 1, 35, SUSPENSION1 );
-  addEdge( 1, 25, SUSPENSION1 );
-  addEdge( 1, 37, SUSPENSION1 );
-  addEdge( 1, 39, SUSPENSION1 );
-  addEdge( 1, 41, SUSPENSION1 );
-  addEdge( 1, 42, SUSPENSION1 );
-  addEdge( 1, 43, SUSPENSION1 );
-  addEdge( 1, 44, SUSPENSION1 );
-  addEdge( 1, 45, SUSPENSION1 );
-
-  // back left
-  addEdge( 2, 26, SUSPENSION );
-  addEdge( 2, 28, SUSPENSION );
-  addEdge( 2, 29, SUSPENSION );
-  addEdge( 2, 30, SUSPENSION );
-  addEdge( 2, 31, SUSPENSION );
-  addEdge( 2, 32, SUSPENSION );
-  addEdge( 2, 36, SUSPENSION );
-  addEdge( 2, 38, SUSPENSION );
-  // mirrored SUSPENSION1 edges
-  addEdge( 2, 4, SUSPENSION1 );
-  addEdge( 2, 6, SUSPENSION1 );
-  addEdge( 2, 7, SUSPENSION1 );
-  addEdge( 2, 8, SUSPENSION1 );
-  addEdge( 2, 9, SUSPENSION1 );
-  addEdge( 2, 10, SUSPENSION1 );
-  addEdge( 2, 14, SUSPENSION1 );
-  addEdge( 2, 16, SUSPENSION1 );
-
-  // back right
-  addEdge( 3, 4, SUSPENSION );
-  addEdge( 3, 6, SUSPENSION );
-  addEdge( 3, 7, SUSPENSION );
-  addEdge( 3, 8, SUSPENSION );
-  addEdge( 3, 9, SUSPENSION );
-  addEdge( 3, 10, SUSPENSION );
-  addEdge( 3, 14, SUSPENSION );
-  addEdge( 3, 16, SUSPENSION );
-  // mirrored SUSPENSION1 edges
-  addEdge( 3, 26, SUSPENSION1 );
-  addEdge( 3, 28, SUSPENSION1 );
-  addEdge( 3, 29, SUSPENSION1 );
-  addEdge( 3, 30, SUSPENSION1 );
-  addEdge( 3, 31, SUSPENSION1 );
-  addEdge( 3, 32, SUSPENSION1 );
-  addEdge( 3, 36, SUSPENSION1 );
-  addEdge( 3, 38, SUSPENSION1 );
+  // clear out data, so this can also be used as a reset - the old graph goes once the
+  // simulation lets go of it. a part per worker, see loadVehicleGraph
+  simulation.Load( loadVehicleGraph( "carFrameWPanels.obj", simulation.simParameters, pool.size() ) );
+  renderBlend = 1.0f;
+}
+
+void model::BenchmarkSolvers( float frameBudget, float simulatedSeconds ) {
+  simulation.BenchmarkSolvers( pool, frameBudget, simulatedSeconds );
+  renderBlend = 1.0f;
 }
 
 void model::GPUSetup() {
@@ -176,62 +39,154 @@ void model::GPUSetup() {
 
   // shader for faces - flat shading - todo
   // bodyPanelShader = Shader();
+
+  GroundSetup();
 }
 
-float model::getGroundPoint( float x, float y ) {
-  return fnGenerator->GenSingle2D( x * displayParameters.scale, y * displayParameters.scale + noiseOffset, 42069 ) * simParameters.noiseAmplitudeScale - 0.4;
+void model::GroundSetup() {
+  // 200 x 300 points a hundredth apart, the extent of the road cache - x across, z along the road
+  constexpr int groundRows = 200, groundColumns = 300;
+  std::vector< glm::vec2 > grid;
+  grid.reserve( groundRows * groundColumns );
+  for ( int i = 0; i < groundRows; i++ )
+    for ( int j = 0; j < groundColumns; j++ )
+      grid.push_back( glm::vec2( -1.0f + 0.01f * i, -1.5f + 0.01f * j ) );
+
+  // two triangles per cell
+  std::vector< GLuint > indices;
+  indices.reserve( ( groundRows - 1 ) * ( groundColumns - 1 ) * 6 );
+  for ( int i = 0; i < groundRows - 1; i++ )
+    for ( int j = 0; j < groundColumns - 1; j++ ) {
+      const GLuint corner = i * groundColumns + j;
+      indices.insert( indices.end(), { corner, corner + groundColumns, corner + 1, corner + 1, corner + groundColumns, corner + groundColumns + 1 } );
+    }
+  drawParameters.groundBase = 0;
+  drawParameters.groundNum = indices.size();
+
+  // static, sent once
+  glGenVertexArrays( 1, &groundVAO );
+  glBindVertexArray( groundVAO );
+  glGenBuffers( 1, &groundVBO );
+  glBindBuffer( GL_ARRAY_BUFFER, groundVBO );
+  glBufferData( GL_ARRAY_BUFFER, grid.size() * sizeof( glm::vec2 ), &grid[ 0 ], GL_STATIC_DRAW );
+  glGenBuffers( 1, &groundEBO );
+  glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, groundEBO );
+  glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof( GLuint ), &indices[ 0 ], GL_STATIC_DRAW );
+
+  groundShader = Shader( "resources/engine_code/shaders/ground.vs.glsl", "resources/engine_code/shaders/ground.fs.glsl" ).Program;
+  glEnableVertexAttribArray( glGetAttribLocation( groundShader, "vPosition" ) );
+  glVertexAttribPointer( glGetAttribLocation( groundShader, "vPosition" ), 2, GL_FLOAT, GL_FALSE, 0, ( GLvoid* ) 0 );
+
+  // the heights, on texture unit 1 - unit 0 has the display texture. fetched by texel, the shader
+  // interpolates, so it's sized on the first upload
+  glGenTextures( 1, &groundTexture );
+  glActiveTexture( GL_TEXTURE1 );
+  glBindTexture( GL_TEXTURE_2D, groundTexture );
+  glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+  glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+  glActiveTexture( GL_TEXTURE0 );
+
+  // back to the chassis geometry
+  glBindVertexArray( simGeometryVAO );
+  glBindBuffer( GL_ARRAY_BUFFER, simGeometryVBO );
+}
+
+void model::UpdateGroundTexture() {
+  const heightfieldCache& road = simulation.RoadCache();
+  const int columns = road.numColumns();
+  const int rows = road.numRingRows();
+  const int first = road.residentFirst();
+  const int last = road.residentLast();
+  if ( last < first ) return;
+
+  glActiveTexture( GL_TEXTURE1 );
+  glBindTexture( GL_TEXTURE_2D, groundTexture );
+  if ( columns != groundTextureColumns || rows != groundTextureRows ) {
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_R32F, columns, rows, 0, GL_RED, GL_FLOAT, NULL );
+    groundTextureColumns = columns;
+    groundTextureRows = rows;
+    groundRegenerations = -1;
+  }
+
+  // the texture is laid out like the ring, so the new rows go where the cache has them - the
+  // whole window after a regeneration, or when the road moved further than the ring since the
+  // last frame. a batch up to where the ring wraps and another after it
+  int row = groundUploadedRow + 1;
+  if ( road.regenerations != groundRegenerations || row < first ) row = first;
+  while ( row <= last ) {
+    const int slot = road.slot( row );
+    const int count = std::min( last - row + 1, rows - slot );
+    glTexSubImage2D( GL_TEXTURE_2D, 0, 0, slot, columns, count, GL_RED, GL_FLOAT, road.ring() + size_t( slot ) * columns );
+    row += count;
+  }
+  groundUploadedRow = last;
+  groundRegenerations = road.regenerations;
+  glActiveTexture( GL_TEXTURE0 );
+}
+
+void model::DisplayGround() {
+  if ( groundTextureColumns == 0 ) return;
+  const heightfieldCache& road = simulation.RoadCache();
+
+  glUseProgram( groundShader );
+  glBindVertexArray( groundVAO );
+  glActiveTexture( GL_TEXTURE1 );
+  glBindTexture( GL_TEXTURE_2D, groundTexture );
+  glActiveTexture( GL_TEXTURE0 );
+
+  SDL_DisplayMode dm;
+  SDL_GetDesktopDisplayMode( 0, &dm );
+  const float AR = float( dm.w ) / float( dm.h );
+  glUniform1f( glGetUniformLocation( groundShader, "aspect_ratio" ), AR );
+  glUniform1f( glGetUniformLocation( groundShader, "theta" ), displayParameters.theta );
+  glUniform1f( glGetUniformLocation( groundShader, "phi" ), displayParameters.phi );
+  glUniform1f( glGetUniformLocation( groundShader, "roll" ), displayParameters.roll );
+
+  // the road is sampled in display space, see Update
+  glUniform1f( glGetUniformLocation( groundShader, "spacing" ), road.gridSpacing() );
+  glUniform1i( glGetUniformLocation( groundShader, "firstColumn" ), road.columnStart() );
+  glUniform1i( glGetUniformLocation( groundShader, "ringRows" ), road.numRingRows() );
+  glUniform1f( glGetUniformLocation( groundShader, "offset" ), simulation.noiseOffset );
+  glUniform1f( glGetUniformLocation( groundShader, "amplitude" ), simulation.RoadAmplitude() );
+  glUniform4fv( glGetUniformLocation( groundShader, "groundLow" ), 1, glm::value_ptr( displayParameters.groundLow ) );
+  glUniform4fv( glGetUniformLocation( groundShader, "groundHigh" ), 1, glm::value_ptr( displayParameters.groundHigh ) );
+
+  glDrawElements( GL_TRIANGLES, drawParameters.groundNum, GL_UNSIGNED_INT, ( GLvoid* ) ( drawParameters.groundBase * sizeof( GLuint ) ) );
 }
 
 void model::passNewGPUData() {
   // populate the arrays out of the edge and node data
+  const vehicleGraph& graph = simulation.graph();
   std::vector< glm::vec4 > points;
   std::vector< glm::vec4 > colors;
   std::vector< glm::vec4 > tColors;
 
   // chassis nodes
   drawParameters.nodesBase = points.size();
-  for ( auto n : nodes )
+  for ( size_t i = 0; i < graph.nodes.size(); i++ )
     if ( displayParameters.showChassisNodes ) {
-      points.push_back( glm::vec4( n.position * displayParameters.scale, 10.0 ) ),
+      points.push_back( glm::vec4( nodePosition( i ) * displayParameters.scale, 10.0 ) ),
       colors.push_back( STEEL ),
       tColors.push_back( glm::vec4( 0. ) );
     }
 
-  // the ground nodes
-  for ( float x = -1.0; x < 1.0; x += 0.01 ) {
-    for ( float y = -1.5; y < 1.5; y += 0.01 ) {
-      float groundHeight = getGroundPoint( x / displayParameters.scale, y / displayParameters.scale );
-      points.push_back( glm::vec4( glm::vec3( x, groundHeight, y ), ( -groundHeight + 1.3 ) * 15.0f ) );
-      glm::vec4 sampleColor = 4.0f * groundHeight * displayParameters.groundHigh + ( 1.0f -  4.0f * groundHeight ) * displayParameters.groundLow;
-      // glm::vec4 sampleColor = glm::vec4( ( x + 1.0f ) / 2.0f, ( y + 1.5f ) / 3.0f, 0.0f, 1.0f );
-      colors.push_back( glm::vec4( sampleColor.xyz(), 1.0f ) );
-      tColors.push_back( glm::vec4( 0.0f ) );
-    }
-  }
+  // the ground is its own mesh - the road cache is brought up to the road, and the rows it
+  // gained sent to the ground texture
+  simulation.ScrollRoad();
+  UpdateGroundTexture();
 
   // end of points
   drawParameters.nodesNum = points.size() - drawParameters.nodesBase;
 
   // edges
   drawParameters.edgesBase = points.size();
-  for ( auto e : edges ) {
-    points.push_back( glm::vec4( nodes[ e.node1 ].position * displayParameters.scale, 10.0 ) );
-    points.push_back( glm::vec4( nodes[ e.node2 ].position * displayParameters.scale, 10.0 ) );
-    switch ( e.type ) {
-      case CHASSIS:
-        colors.push_back( displayParameters.chassisColor );
-        colors.push_back( displayParameters.chassisColor );
-        break;
-      case SUSPENSION:
-        colors.push_back( displayParameters.suspColor );
-        colors.push_back( displayParameters.suspColor );
-        break;
-      case SUSPENSION1:
-        colors.push_back( displayParameters.susp1Color );
-        colors.push_back( displayParameters.susp1Color );
-        break;
-      default: break;
-    }
+  for ( auto& e : graph.edges ) {
+    points.push_back( glm::vec4( nodePosition( e.node1 ) * displayParameters.scale, 10.0 ) );
+    points.push_back( glm::vec4( nodePosition( e.node2 ) * displayParameters.scale, 10.0 ) );
+    const std::vector< material >& materials = simulation.simParameters.materials;
+    const glm::vec4 color = e.material < int( materials.size() ) ? materials[ e.material ].color : BLACK;
+    colors.push_back( color );
+    colors.push_back( color );
     tColors.push_back( BLACK ); // this will become a mapping that involves length and baselength
     tColors.push_back( BLACK );   // for the edge as well as the compColor and tensColor
   }
@@ -239,18 +194,22 @@ void model::passNewGPUData() {
 
   // faces
   drawParameters.facesBase = points.size();
-  for ( auto f : faces ) {
+  for ( auto& f : graph.faces ) {
+    const glm::vec3 p1 = nodePosition( f.node1 );
+    const glm::vec3 p2 = nodePosition( f.node2 );
+    const glm::vec3 p3 = nodePosition( f.node3 );
+
     // bring it in a touch, less collision with the chassis edges
-    points.push_back( glm::vec4( nodes[ f.node1 ].position * displayParameters.scale * displayParameters.chassisRescaleAmnt, 10.0 ) );
-    points.push_back( glm::vec4( nodes[ f.node2 ].position * displayParameters.scale * displayParameters.chassisRescaleAmnt, 10.0 ) );
-    points.push_back( glm::vec4( nodes[ f.node3 ].position * displayParameters.scale * displayParameters.chassisRescaleAmnt, 10.0 ) );
+    points.push_back( glm::vec4( p1 * displayParameters.scale * displayParameters.chassisRescaleAmnt, 10.0 ) );
+    points.push_back( glm::vec4( p2 * displayParameters.scale * displayParameters.chassisRescaleAmnt, 10.0 ) );
+    points.push_back( glm::vec4( p3 * displayParameters.scale * displayParameters.chassisRescaleAmnt, 10.0 ) );
 
     colors.push_back( displayParameters.faceColor );
     colors.push_back( displayParameters.faceColor );
     colors.push_back( displayParameters.faceColor );
 
     // calculate normal
-    glm::vec4 normal = glm::vec4( glm::normalize( glm::cross( nodes[ f.node1 ].position - nodes[ f.node2 ].position, nodes[ f.node1 ].position - nodes[ f.node3 ].position ) ), 1.0 );
+    glm::vec4 normal = glm::vec4( glm::normalize( glm::cross( p1 - p2, p1 - p3 ) ), 1.0 );
 
     tColors.push_back( normal );
     tColors.push_back( normal );
@@ -264,7 +223,9 @@ void model::passNewGPUData() {
   uintptr_t numBytesColors  =  colors.size() * sizeof( glm::vec4 );
   uintptr_t numBytesTColors = tColors.size() * sizeof( glm::vec4 );
 
-  // send it
+  // send it - the ground drawn last left its VAO bound
+  glBindVertexArray( simGeometryVAO );
+  glBindBuffer( GL_ARRAY_BUFFER, simGeometryVBO );
   glBufferData(GL_ARRAY_BUFFER, numBytesPoints + numBytesColors + numBytesTColors, NULL, GL_DYNAMIC_DRAW);
   uint bufferbase = 0;
   glBufferSubData(GL_ARRAY_BUFFER, bufferbase, numBytesPoints, &points[0]);
@@ -318,153 +279,72 @@ void model::updateUniforms() {
   // if ( ++nodeSelect == 4 ) nodeSelect = 0;
 }
 
-void model::SingleThreadSoftbodyUpdate() {
-  for ( auto& n : nodes ) {
-    if ( !n.anchored ) {
-      glm::vec3 forceAccumulator = glm::vec3( 0, 0, 0 );
-      float k = 0;
-      float d = 0;
-      //get your forces from all the connections - accumulate in forceAccumulator vector
-      for ( auto& e : n.edges ) {
-        switch ( e.type ) {
-          case CHASSIS:
-            k = simParameters.chassisKConstant;
-            d = simParameters.chassisDamping;
-            break;
-          case SUSPENSION:
-          case SUSPENSION1:
-            k = simParameters.suspensionKConstant;
-            d = simParameters.suspensionDamping;
-            break;
-          // case TIRE:
-            //tbd, maybe
-            // break;
-        }
-        //get positions of the two nodes involved
-        glm::vec3 myPosition = n.oldPosition;
-        glm::vec3 otherPosition = nodes[ e.node2 ].anchored ?
-          nodes[ e.node2 ].position :    // use new position for anchored nodes ( position is up to date )
-          nodes[ e.node2 ].oldPosition;  // use old position for unanchored nodes ( old value is what you use )
-
-        //less than 1 is shorter, greater than 1 is longer than base length
-        float springRatio = glm::distance( myPosition, otherPosition ) / e.baseLength;
-
-        //spring force
-        forceAccumulator += -k * glm::normalize( myPosition - otherPosition ) * ( springRatio - 1 ); //should this be normalized or no?
-        //force += -k * ( myPosition - otherPosition ) * ( springRatio - 1 );
-
-        forceAccumulator -= d * n.oldVelocity;                           //damping force
-      }
-      forceAccumulator += ( *n.mass ) * glm::vec3( 0.0f, -simParameters.gravity, 0.0f ); // add gravity
-      glm::vec3 acceleration = forceAccumulator / ( *n.mass );                           // get the resulting acceleration
-      n.velocity = n.oldVelocity + acceleration * simParameters.timeScale;    // compute the new velocity
-      n.position = n.oldPosition + n.velocity * simParameters.timeScale;      // get the new position
-    }
-  }
-}
-
-void model::MultiThreadUpdateFunc ( int myThreadIndex ) {
-	// cout << "id is " << myThreadIndex << endl;
-	while ( workerState[ myThreadIndex ] != QUIT ) {
-		if ( workerState[ myThreadIndex ] == WAITING )
-			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
-		else if ( workerState[ myThreadIndex ] == WORKING ) {
-			// run the update for all the relevant nodes
-			for ( unsigned int n = myThreadIndex; n < nodes.size(); n += numThreads ) {
-				cout << "thread index " << myThreadIndex << " is updating node " << n << endl;
-		    if ( !nodes[ n ].anchored ) {
-		      glm::vec3 forceAccumulator = glm::vec3( 0, 0, 0 );
-		      float k = 0;
-		      float d = 0;
-		      //get your forces from all the connections - accumulate in forceAccumulator vector
-		      for ( auto& e : nodes[ n ].edges ) {
-		        switch ( e.type ) {
-		          case CHASSIS:
-		            k = simParameters.chassisKConstant;
-		            d = simParameters.chassisDamping;
-		            break;
-		          case SUSPENSION:
-		          case SUSPENSION1:
-		            k = simParameters.suspensionKConstant;
-		            d = simParameters.suspensionDamping;
-		            break;
-		        }
-		        //get positions of the two nodes involved
-		        glm::vec3 myPosition = nodes[ n ].oldPosition;
-		        glm::vec3 otherPosition = nodes[ e.node2 ].anchored ?
-		          nodes[ e.node2 ].position :    // use new position for anchored nodes ( position is up to date )
-		          nodes[ e.node2 ].oldPosition;  // use old position for unanchored nodes ( old value is what you use )
-
-		        //less than 1 is shorter, greater than 1 is longer than base length
-		        float springRatio = glm::distance( myPosition, otherPosition ) / e.baseLength;
-		        forceAccumulator += -k * glm::normalize( myPosition - otherPosition ) * ( springRatio - 1 ); // spring force
-		        forceAccumulator -= d * nodes[ n ].oldVelocity;                           //damping force
-		      }
-		      forceAccumulator += ( *nodes[ n ].mass ) * glm::vec3( 0.0f, -simParameters.gravity, 0.0f ); // add gravity
-		      glm::vec3 acceleration = forceAccumulator / ( *nodes[ n ].mass );                           // get the resulting acceleration
-		      nodes[ n ].velocity = nodes[ n ].oldVelocity + acceleration * simParameters.timeScale;    // compute the new velocity
-		      nodes[ n ].position = nodes[ n ].oldPosition + nodes[ n ].velocity * simParameters.timeScale;      // get the new position
-		    }
-		  }
-			cout << "setting " << myThreadIndex << " to wait" << endl;
-			workerState[ myThreadIndex ] = WAITING;
-		}
+int model::SubstepsThisFrame() {
+	const simParameterPack& simParameters = simulation.simParameters;
+	const auto now = std::chrono::steady_clock::now();
+	const double frameTime = haveLastFrameTime ? std::chrono::duration< double >( now - lastFrameTime ).count() : 0.0;
+	lastFrameTime = now;
+	haveLastFrameTime = true;
+
+	if ( !simParameters.realTimeStepping || simParameters.timeScale <= 0.0f ) {
+		unsimulatedTime = 0.0;
+		renderBlend = 1.0f;
+		return simParameters.substepsPerFrame;
 	}
-}
 
-bool model::AllThreadComplete () {
-	bool check = true;
-	for ( int i = 0; i < numThreads; i++ ) {
-		if ( workerState[ i ] == WORKING ) {
-			check = false;
-			cout << "thread " << i << " is still working" << endl;
-		}
+	// as many whole ticks as fit in the time since the last frame, the remainder carries over
+	const double tick = simParameters.timeScale;
+	unsimulatedTime += frameTime;
+	int substeps = int( unsimulatedTime / tick );
+	if ( substeps > simParameters.maxSubstepsPerFrame ) {
+		// falling behind ( or a stall, e.g. dragging the window ) - drop the backlog, instead of
+		// taking longer every frame trying to catch up
+		substeps = simParameters.maxSubstepsPerFrame;
+		unsimulatedTime = substeps * tick;
 	}
-	return check;
-}
+	unsimulatedTime -= substeps * tick;
 
-void model::EnableAllWorkers () {
-	for( int i = 0; i < numThreads; i++ ) {
-		workerState[ i ] = WORKING;
-	}
-}
-
-void model::CachePreviousValues () {
-	for ( auto& n : nodes )
-		if ( !n.anchored ) {
-			n.oldPosition = n.position;
-			n.oldVelocity = n.velocity;
-		}
+	// the frame time lands part way into the next tick, draw that far between the last two
+	renderBlend = simParameters.interpolateRender ? float( unsimulatedTime / tick ) : 1.0f;
+	return substeps;
 }
 
 void model::Update () {
-	// offset the noise over time
-	noiseOffset += 0.001 * simParameters.noiseSpeed;
+	const simParameterPack& simParameters = simulation.simParameters;
+	const float frameTick = simParameters.timeScale;
+	const int substeps = SubstepsThisFrame();
 
-	// sample terrain surface height at the wheel points
-	nodes[ 0 ].position.y = getGroundPoint( nodes[ 0 ].position.x, nodes[ 0 ].position.z ) / displayParameters.scale + displayParameters.wheelDiameter;
-	nodes[ 1 ].position.y = getGroundPoint( nodes[ 1 ].position.x, nodes[ 1 ].position.z ) / displayParameters.scale + displayParameters.wheelDiameter;
-	nodes[ 2 ].position.y = getGroundPoint( nodes[ 2 ].position.x, nodes[ 2 ].position.z ) / displayParameters.scale + displayParameters.wheelDiameter;
-	nodes[ 3 ].position.y = getGroundPoint( nodes[ 3 ].position.x, nodes[ 3 ].position.z ) / displayParameters.scale + displayParameters.wheelDiameter;
+	// the road moves as far per frame as it did with one tick per frame - in real time, as far
+	// per 1/60th of a second, so it keeps its speed when the tick size or frame rate changes. that
+	// is per tick, since an adaptive tick size can change between them
+	const float noiseStep = 0.001f * simParameters.noiseSpeed / std::max( substeps, 1 );
 
-	// back up velocities and positions in the 'old' values
+	// the road is sampled in display space, so it follows the scale slider
+	simulation.simParameters.roadScale = displayParameters.scale;
 
 	// single threaded update structure
 	// auto tstart = std::chrono::high_resolution_clock::now();
 	// for ( int i = 0; i < 10; i++ ){
-	// 	CachePreviousValues();
-	// 	SingleThreadSoftbodyUpdate();
+	// 	SingleThreadSoftbodyUpdate( singleBuffers );
+	// 	singleBuffers.state.next().copyRange( singleBuffers.state.current(), 0, numAnchored );
+	// 	singleBuffers.state.swap();
 	// }
 	// cout << "singlethread update (x10) " << std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now()-tstart).count() << "ns\n";
 
 	// multithreaded update structure
 	auto tstartm = std::chrono::high_resolution_clock::now();
-	// for ( int i = 0; i < 10; i++ ){
-		CachePreviousValues();
-		EnableAllWorkers();							// set worker thread enable flag
-		while( !AllThreadComplete() );	// wait for all threads to reach completion
-	// }
-	cout << "multithread update " << std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now()-tstartm).count() << "ns\n";
+	const double simulatedBefore = simulation.simulatedTime;
+	for ( int i = 0; i < substeps; i++ )
+		simulation.Substep( pool, simParameters.realTimeStepping ? simulation.NoiseStep() : noiseStep );
+
+	// an adaptive tick can change part way through the frame - the time it simulated beyond or short
+	// of the ticks counted at the start carries over to the next frame
+	if ( simParameters.realTimeStepping && frameTick > 0.0f )
+		unsimulatedTime = std::max( 0.0, unsimulatedTime + substeps * double( frameTick ) - ( simulation.simulatedTime - simulatedBefore ) );
+	cout << "multithread update (" << substeps << " substeps) " << std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now()-tstartm).count() << "ns";
+	if ( simParameters.solver == IMPLICIT_EULER )
+		cout << " - last CG solve " << simulation.lastCGIterations() << " iterations, residual " << simulation.lastCGResidual();
+	cout << "\n";
 
 	// pass the new GPU data
 	passNewGPUData();
@@ -510,46 +390,9 @@ void model::Display() {
     glDrawArrays( GL_LINES, drawParameters.edgesBase, drawParameters.edgesNum );
   }
 
+  // the ground, with its own shader and VAO
+  DisplayGround();
+
   // use the other shader / VAO / VBO to do flat shaded polygons for the body panels
     // body panels
 }
-
-void model::addNode( float* mass, glm::vec3 position, bool anchored ) {
-  node n;
-  n.mass = mass;
-  n.anchored = anchored;
-  n.position = n.oldPosition = position;
-  n.velocity = n.oldVelocity = glm::vec3( 0.0 );
-  nodes.push_back( n );
-}
-
-void model::addEdge( int nodeIndex1, int nodeIndex2, edgeType type ) {
-  edge e;
-  e.node1 = nodeIndex1;
-  e.node2 = nodeIndex2;
-  e.type = type;
-  e.baseLength = glm::distance( nodes[ e.node1 ].position, nodes[ e.node2 ].position );
-  edges.push_back( e );
-
-
-  // add an edge for the first node
-  nodes[ e.node1 ].edges.push_back( e );
-
-  // add an edge for the second node - swap first and second node
-  e.node1 = nodeIndex2;
-  e.node2 = nodeIndex1;
-  nodes[ e.node1 ].edges.push_back( e );
-
-}
-
-// parameters tbd - probably just the
-void model::addFace( int nodeIndex1, int nodeIndex2, int nodeIndex3, glm::vec3 normal ) {
-  face f;
-  f.node1 = nodeIndex1;
-  f.node2 = nodeIndex2;
-  f.node3 = nodeIndex3;
-
-  // TODO: add normals
-
-  faces.push_back( f );
-}
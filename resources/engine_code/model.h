@@ -2,56 +2,7 @@
 #define MODEL
 
 #include "includes.h"
-
-constexpr int numThreads = 12;          // worker threads for the update
-enum threadState {
-	WORKING,                              // thread is engaged in computation
-	WAITING,                              // thread has finished the work
-	QUIT
-};
-
-enum edgeType {
-	CHASSIS,                              // chassis member
-	SUSPENSION,                           // suspension member
-	SUSPENSION1                           // inboard suspension member
-};
-
-struct edge {
-	edgeType type;                        // references global values of k, damping values
-	float length, baseLength;             // current and initial edge length, used to determine compression / tension state
-	int node1, node2;                     // indices the nodes on either end of the edge
-};
-
-struct face {
-	int node1, node2, node3;              // the three points making up the triangle
-	glm::vec3 normal;                     // surface normal for the triangle
-};
-
-struct node {
-	float* mass;                          // pointer to mass of node ( easy runtime update )
-	bool anchored;                        // anchored nodes are control points
-	glm::vec3 position, oldPosition;      // current and previous position values
-	glm::vec3 velocity, oldVelocity;      // current and previous velocity values
-	std::vector< edge > edges;            // edges in which this node takes part
-};
-
-// consolidate simulation parameters
-struct simParameterPack {
-	bool  runSimulation       = true;     // toggle per frame update
-	float timeScale           = 0.003;    // amount of time that passes per sim tick
-	float gravity             = -8.0;     // scales the contribution of force of gravity
-
-	float noiseAmplitudeScale = 0.065;    // scalar on the noise amplitude
-	float noiseSpeed          = 8.6;      // how quickly the noise offset increases
-
-	float chassisKConstant    = 14000.;   // hooke's law spring constant for chassis edges
-	float chassisDamping      = 51.5;     // damping factor for chassis edges
-	float chassisNodeMass     = 3.0;      // mass of a chassis node
-	float anchoredNodeMass    = 0.0;      // mass of an anchored node
-
-	float suspensionKConstant = 9000.;    // hooke's law spring constant for suspension edges
-	float suspensionDamping   = 32.4;     // damping factor for suspension edges
-};
+#include "softbody_core.h"
 
 // consolidate display parameters
 struct displayParameterPack {
@@ -64,16 +15,11 @@ struct displayParameterPack {
 	float depthColorScale     = 1.0;      // adjust the weight of the depth coloring
 	float chassisRescaleAmnt  = 0.995f;   // scales the polygons, to interfere with the lines less
 
-	float wheelDiameter       = 0.2f;    // offset from the noise read, per wheel
-
 	glm::vec4 outlineColor    = BLACK;    // the highlight color if tensionColor is off
 	glm::vec4 compColor       = RED;      // the highlight color of the edges in compression ( tensionColor mode )
 	glm::vec4 tensColor       = BLUE;     // the highlight color of the edges in tension ( tensionColor mode )
 
 	glm::vec4 faceColor       = GREEN;    // color of the chassis faces
-	glm::vec4 chassisColor    = STEEL;    // color of the chassis members
-	glm::vec4 suspColor       = YELLOW;   // color of the suspension members
-	glm::vec4 susp1Color      = BROWN;    // color of the inboard suspension members
 
 	glm::vec4 groundLow       = G0;       // color of the ground at lowest point
 	glm::vec4 groundHigh      = G1;       // color of the ground at highest point
@@ -83,7 +29,7 @@ struct displayParameterPack {
 	float phi                 = 3.896f;   // phi euler angle
 	float roll                = -0.325f;  // additional roll parameter
 
-	float scale               = 0.4f;     // scales the frame points, about zero
+	float scale               = 0.4f;     // scales the frame points, about zero - and the road, see simParameterPack::roadScale
 };
 
 struct drawParameterPack {
@@ -97,7 +43,7 @@ struct drawParameterPack {
 	// faces
 	GLuint facesBase;
 	GLuint facesNum;
-	// ground
+	// ground - indices into groundEBO, not the VBO
 	GLuint groundBase;
 	GLuint groundNum;
 
@@ -117,7 +63,7 @@ public:
 	int nodeSelect = 0;
 
 	// graph init
-	void loadFramePoints();               // populate graph with nodes and edges
+	void loadFramePoints();               // build the graph of nodes and edges, and load the simulation with it
 	void GPUSetup();                      // set up VAO, VBO, shaders
 
 	// pass new GPU data
@@ -130,55 +76,35 @@ public:
 	// show the model
 	void Display();                       // render the latest vertex data with the simGeometryShader
 
+	// drive each solver at a range of tick sizes, print stability and cost to the console -
+	// leaves the model back at its rest pose
+	void BenchmarkSolvers( float frameBudget = 4.0f, float simulatedSeconds = 2.0f );
+
 	// to query sim completion
 
 	void colorModeSelect( int mode );     // the set of drawing colors to use
 
-	// simulation and display parameter structs
-	simParameterPack simParameters;
+	// the vehicle being drawn - its parameters, state and solvers
+	softbodySimulation simulation;
+
+	// display parameter structs
 	displayParameterPack displayParameters;
 	drawParameterPack drawParameters;
 
 private:
-	// called from loadFramePoints
-	void addNode( float* mass, glm::vec3 position, bool anchored );
-	void addEdge( int nodeIndex1, int nodeIndex2, edgeType type );
-	void addFace( int nodeIndex1, int nodeIndex2, int nodeIndex3, glm::vec3 normal );
-
-	// sim / display data
-	std::vector< node > nodes;
-	std::vector< edge > edges;
-	std::vector< face > faces;
-
-	// back up current values to previous values
-	void CachePreviousValues();
-
-	// keeping the state of each thread
-	threadState workerState[ numThreads ];
-	std::thread workerThreads[ numThreads ];
-	void EnableAllWorkers();
-	void MultiThreadUpdateFunc( int index );
-	// std::function< void( int ) > MultiThreadUpdateFunc = []() ;
-
-
-	// std::atomic<unsigned int> indexcrement{ 0 }; // used to get new thread ids
-	// std::thread updateThreads[ numThreads ] {[=](){
-	// 	// while ( workerState[ myThreadIndex ] != QUIT ) {
-	// 	// 	if ( workerState[ myThreadIndex ] == WAITING )
-	// 	// 		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
-	// 	// 	else {
-	// 	// 		// run the update for all the relevant nodes
-	// 	// 	}
-	// 	// }
-	// 	int index = indexcrement.fetch_add( 1 );
-	// 	cout << "myindex is " << index << endl;
-	// }};
-
-
-	bool AllThreadComplete();
-
-	// update all nodes with a single thread
-	void SingleThreadSoftbodyUpdate();
+	// persistent workers, shared by the solver passes and the vertex build
+	threadPool pool;
+
+	// fixed timestep accumulator - wall clock time not yet simulated, carried between frames,
+	// and how far past the previous tick the current frame is drawn
+	std::chrono::steady_clock::time_point lastFrameTime;
+	bool haveLastFrameTime = false;
+	double unsimulatedTime = 0.0;
+	float renderBlend = 1.0f;
+	int SubstepsThisFrame();
+
+	// blended between the last two ticks by renderBlend
+	glm::vec3 nodePosition( int index ) const { return simulation.nodePosition( index, renderBlend ); }
 
 	// OpenGL Data Handles
 	GLuint simGeometryVAO;
@@ -186,10 +112,21 @@ private:
 	GLuint simGeometryShader;
 	GLuint bodyPanelShader;
 
-	// ground data
-	float getGroundPoint( float x, float y );
-	FastNoise::SmartNode<> fnGenerator;
-	float noiseOffset = 0.0;
+	// the ground - a fixed triangle grid, its heights read in the vertex shader from a texture
+	// mirroring the simulation's road cache. only the rows the road scrolled in are sent each
+	// frame, a few hundred bytes each, in place of the whole grid
+	GLuint groundVAO;
+	GLuint groundVBO;
+	GLuint groundEBO;
+	GLuint groundTexture;
+	GLuint groundShader;
+	int groundTextureColumns = 0;         // size the texture was allocated at, zero before the first upload
+	int groundTextureRows = 0;
+	int groundUploadedRow = 0;            // last road row in the texture
+	int groundRegenerations = -1;         // the cache's regenerations as of the last upload
+	void GroundSetup();                   // the grid and its shader, once
+	void UpdateGroundTexture();           // send the rows the road cache gained since the last call
+	void DisplayGround();
 
 };
 
@@ -0,0 +1,239 @@
+#include "multirate_solver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+template < typename precision >
+void multirateSolver< precision >::resize( const springTopology& topology ) {
+  forces.resize( topology.numNodes );
+  crossForces.resize( topology.numEdges );
+  nodeLevel.assign( topology.numNodes, -1 );
+  numLevels = 0;
+  levelNodes.clear();
+  springEvaluations = 0;
+  invalidate();
+}
+
+template < typename precision >
+void multirateSolver< precision >::classify( const springTopology& topology, const springConstants& constants,
+  const alignedArray< scalar >& inverseMass, const alignedArray< scalar >& nodeDamping, int firstNode,
+  float timeStep, int levels, float safety ) {
+
+  // each node's own limit, from its row of M^-1/2 K M^-1/2 at rest and its damping rate - then
+  // the fewest halvings of the tick that bring it under safety times that
+  nodeLevel.assign( topology.numNodes, -1 );
+  for ( int n = firstNode; n < topology.numNodes; n++ ) {
+    const scalar inverse = inverseMass[ n ];
+    scalar row = 0, shocks = 0;
+    for ( int i = topology.rowStart[ n ]; i < topology.rowStart[ n + 1 ]; i++ ) {
+      const int e = topology.incidentEdge[ i ];
+      const int m = topology.material[ e ];
+      row += std::max( scalar( 0 ), scalar( constants.spring[ m ].k ) ) / topology.baseLength[ e ]
+           * ( inverse + std::sqrt( inverse * inverseMass[ topology.neighbor[ i ] ] ) );
+      if ( constants.damper[ m ] != NO_DAMPER )
+        shocks += std::max( scalar( 0 ), scalar( constants.shock[ m ].k ) );
+    }
+    const scalar damping = inverse * ( nodeDamping[ n ] + 2 * shocks );
+    scalar limit = std::numeric_limits< scalar >::infinity();
+    if ( row > 0 )
+      limit = ( std::sqrt( damping * damping + 4 * row ) - damping ) / row;
+    else if ( damping > 0 )
+      limit = 2 / damping;
+
+    int level = 0;
+    while ( level < levels - 1 && scalar( timeStep ) / ( 1 << level ) > safety * limit )
+      level++;
+    nodeLevel[ n ] = level;
+  }
+
+  // no node more than one level slower than a neighbor - raising one can push its other
+  // neighbors up in turn, which settles within levels passes
+  for ( bool changed = true; changed; ) {
+    changed = false;
+    for ( int e = 0; e < topology.numEdges; e++ ) {
+      int& a = nodeLevel[ topology.node1[ e ] ];
+      int& b = nodeLevel[ topology.node2[ e ] ];
+      if ( a < 0 || b < 0 ) continue;
+      if ( a < b - 1 ) a = b - 1, changed = true;
+      if ( b < a - 1 ) b = a - 1, changed = true;
+    }
+  }
+
+  numLevels = 1;
+  levelNodes.assign( levels, 0 );
+  for ( int n = firstNode; n < topology.numNodes; n++ ) {
+    numLevels = std::max( numLevels, nodeLevel[ n ] + 1 );
+    levelNodes[ nodeLevel[ n ] ]++;
+  }
+  levelNodes.resize( numLevels );
+
+  // a spring is needed whenever either end is kicked
+  auto edgeLevel = [&]( int e ) { return std::max( nodeLevel[ topology.node1[ e ] ], nodeLevel[ topology.node2[ e ] ] ); };
+  auto fasterFirst = [&]( int a, int b ) { return nodeLevel[ a ] > nodeLevel[ b ]; };
+
+  nodeOrder.resize( topology.numNodes );
+  std::iota( nodeOrder.begin(), nodeOrder.end(), 0 );
+  haloOrder = topology.haloEdge;
+  edgeOrder.clear();
+  runStart.clear(); runMaterial.clear(); runLevel.clear();
+  partRunStart.resize( topology.numParts + 1 );
+  partCrossRunStart.resize( topology.numParts );
+
+  // edges [ first, last ) as runs of one level and material, fastest first
+  auto addRuns = [&]( int first, int last ) {
+    const int begin = edgeOrder.size();
+    for ( int e = first; e < last; e++ )
+      edgeOrder.push_back( e );
+    std::stable_sort( edgeOrder.begin() + begin, edgeOrder.end(), [&]( int a, int b ) {
+      return edgeLevel( a ) != edgeLevel( b ) ? edgeLevel( a ) > edgeLevel( b ) : topology.material[ a ] < topology.material[ b ];
+    } );
+    for ( int i = begin; i < int( edgeOrder.size() ); i++ ) {
+      const int e = edgeOrder[ i ];
+      if ( i == begin || edgeLevel( e ) != runLevel.back() || topology.material[ e ] != runMaterial.back() ) {
+        runStart.push_back( i );
+        runLevel.push_back( edgeLevel( e ) );
+        runMaterial.push_back( topology.material[ e ] );
+      }
+    }
+  };
+
+  std::vector< int > needed( numLevels, 0 ); // springs with an end at each level or faster
+  for ( int p = 0; p < topology.numParts; p++ ) {
+    std::stable_sort( nodeOrder.begin() + topology.partNodeStart[ p ], nodeOrder.begin() + topology.partNodeStart[ p + 1 ], fasterFirst );
+    std::stable_sort( haloOrder.begin() + topology.haloStart[ p ], haloOrder.begin() + topology.haloStart[ p + 1 ],
+      [&]( int a, int b ) { return fasterFirst( topology.node2[ a ], topology.node2[ b ] ); } );
+    partRunStart[ p ] = runStart.size();
+    addRuns( topology.partEdgeStart[ p ], topology.partCrossStart[ p ] );
+    partCrossRunStart[ p ] = runStart.size();
+    addRuns( topology.partCrossStart[ p ], topology.partEdgeStart[ p + 1 ] );
+  }
+  partRunStart[ topology.numParts ] = runStart.size();
+  runStart.push_back( edgeOrder.size() );
+
+  // level l is kicked at every 2^( numLevels - 1 - l )th substep
+  for ( int e = 0; e < topology.numEdges; e++ )
+    for ( int l = 0; l <= edgeLevel( e ); l++ )
+      needed[ l ]++;
+  springEvaluations = needed[ 0 ];
+  for ( int l = 1; l < numLevels; l++ )
+    springEvaluations += ( 1 << ( l - 1 ) ) * needed[ l ];
+
+  classifiedStep = timeStep;
+  classifiedLevels = levels;
+  classifiedSafety = safety;
+}
+
+template < typename precision >
+template < typename law, typename damper >
+void multirateSolver< precision >::springRun( const springTopology& topology, const lawParameters& spring,
+  const lawParameters& shock, const nodeState< storage >& state, int run, bool cross, int slowest ) {
+
+  // the scalar spring kernel's force, scattered only to the ends being kicked
+  for ( int i = runStart[ run ]; i < runStart[ run + 1 ]; i++ ) {
+    const int e = edgeOrder[ i ];
+    const int n1 = topology.node1[ e ];
+    const int n2 = topology.node2[ e ];
+    const scalar dx = scalar( state.px[ n1 ] ) - state.px[ n2 ];
+    const scalar dy = scalar( state.py[ n1 ] ) - state.py[ n2 ];
+    const scalar dz = scalar( state.pz[ n1 ] ) - state.pz[ n2 ];
+    const scalar length = std::sqrt( dx * dx + dy * dy + dz * dz );
+
+    scalar tension = law::force( length / topology.baseLength[ e ] - 1.0f, spring );
+    if constexpr ( damper::active ) {
+      const scalar rate = ( dx * ( scalar( state.vx[ n1 ] ) - state.vx[ n2 ] ) + dy * ( scalar( state.vy[ n1 ] ) - state.vy[ n2 ] )
+                          + dz * ( scalar( state.vz[ n1 ] ) - state.vz[ n2 ] ) ) / length;
+      tension += damper::force( rate, shock );
+    }
+    const scalar scale = -tension / length;
+    const scalar sx = scale * dx, sy = scale * dy, sz = scale * dz;
+
+    if ( nodeLevel[ n1 ] >= slowest ) {
+      forces.fx[ n1 ] += sx; forces.fy[ n1 ] += sy; forces.fz[ n1 ] += sz;
+    }
+    if ( cross ) {
+      crossForces.fx[ e ] = sx; crossForces.fy[ e ] = sy; crossForces.fz[ e ] = sz;
+    } else if ( nodeLevel[ n2 ] >= slowest ) {
+      forces.fx[ n2 ] -= sx; forces.fy[ n2 ] -= sy; forces.fz[ n2 ] -= sz;
+    }
+  }
+}
+
+template < typename precision >
+void multirateSolver< precision >::step( threadPool& pool, const springTopology& topology, const springConstants& constants,
+  const alignedArray< scalar >& inverseMass, const alignedArray< scalar >& nodeDamping,
+  const nodeState< storage >& current, nodeState< storage >& next,
+  float timeStep, float gravity, int firstNode, int levels, float safety ) {
+
+  levels = std::min( std::max( levels, 1 ), maxLevels );
+  if ( timeStep != classifiedStep || levels != classifiedLevels || safety != classifiedSafety )
+    classify( topology, constants, inverseMass, nodeDamping, firstNode, timeStep, levels, safety );
+
+  // the tick runs in place in next, from a copy of current - the anchored nodes never move
+  next.copyRange( current, 0, topology.numNodes );
+  const int finest = numLevels - 1;
+  const scalar h = scalar( timeStep ) / ( 1 << finest );
+
+  for ( int s = 0; s < ( 1 << finest ); s++ ) {
+    // substep s starts a kick for every level whose kick length divides it
+    int slowest = 0;
+    if ( s > 0 ) {
+      slowest = finest;
+      for ( int k = s; ( k & 1 ) == 0; k >>= 1 )
+        slowest--;
+    }
+
+    // the springs with an end kicked now, each part's in parallel - its interior runs, then its cross runs
+    auto runs = [&]( int first, int last, bool cross ) {
+      for ( int r = first; r < last && runLevel[ r ] >= slowest; r++ ) {
+        const int m = runMaterial[ r ];
+        withForceLaw( constants.law[ m ], [&]( auto law ) {
+          withDamperLaw( constants.damper[ m ], [&]( auto damper ) {
+            springRun< decltype( law ), decltype( damper ) >( topology, constants.springLaw( m ), constants.shockLaw( m ),
+              next, r, cross, slowest );
+          } );
+        } );
+      }
+    };
+    pool.forEach( topology.numParts, [&]( int p, int ) {
+      runs( partRunStart[ p ], partCrossRunStart[ p ], false );
+      runs( partCrossRunStart[ p ], partRunStart[ p + 1 ], true );
+    } );
+
+    // then the parked forces of the halo, a kick for the nodes whose turn it is, and a drift for all
+    pool.forEach( topology.numParts, [&]( int p, int ) {
+      for ( int i = topology.haloStart[ p ]; i < topology.haloStart[ p + 1 ]; i++ ) {
+        const int e = haloOrder[ i ];
+        const int n = topology.node2[ e ];
+        if ( nodeLevel[ n ] < slowest ) break;
+        forces.fx[ n ] -= crossForces.fx[ e ];
+        forces.fy[ n ] -= crossForces.fy[ e ];
+        forces.fz[ n ] -= crossForces.fz[ e ];
+      }
+
+      for ( int i = topology.partNodeStart[ p ]; i < topology.partNodeStart[ p + 1 ]; i++ ) {
+        const int n = nodeOrder[ i ];
+        if ( nodeLevel[ n ] < slowest ) break;
+        // the same acceleration the explicit path integrates, drag on the node's own velocity
+        const scalar kick = scalar( timeStep ) / ( 1 << nodeLevel[ n ] );
+        const scalar gamma = nodeDamping[ n ] * inverseMass[ n ];
+        const scalar vx = next.vx[ n ], vy = next.vy[ n ], vz = next.vz[ n ];
+        next.vx[ n ] = vx + ( forces.fx[ n ] * inverseMass[ n ] - gamma * vx ) * kick;
+        next.vy[ n ] = vy + ( forces.fy[ n ] * inverseMass[ n ] - gravity - gamma * vy ) * kick;
+        next.vz[ n ] = vz + ( forces.fz[ n ] * inverseMass[ n ] - gamma * vz ) * kick;
+        forces.fx[ n ] = forces.fy[ n ] = forces.fz[ n ] = 0.0f;
+      }
+
+      for ( int n = topology.partNodeStart[ p ]; n < topology.partNodeStart[ p + 1 ]; n++ ) {
+        next.px[ n ] += scalar( next.vx[ n ] ) * h;
+        next.py[ n ] += scalar( next.vy[ n ] ) * h;
+        next.pz[ n ] += scalar( next.vz[ n ] ) * h;
+      }
+    } );
+  }
+}
+
+template class multirateSolver< singlePrecision >;
+template class multirateSolver< mixedPrecision >;
+template class multirateSolver< doublePrecision >;
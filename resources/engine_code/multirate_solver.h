@@ -0,0 +1,89 @@
+#ifndef MULTIRATE_SOLVER
+#define MULTIRATE_SOLVER
+
+#include "softbody_kernels.h"
+#include "thread_pool.h"
+
+#include <vector>
+
+// multirate explicit integration - the nodes are grouped into levels by their local stiffness,
+// and a node at level l takes 2^l semi-implicit euler kicks per tick, each of timeStep / 2^l. a
+// node's local stability limit comes from its springs' slope at rest over their rest length and
+// the masses at both ends ( a gershgorin row, as timeStepController bounds the whole graph ),
+// with the drag and shocks taken off the same way. so stiff chassis regions substep while the
+// soft ones take the tick whole, and the spring pass only visits the springs with a node
+// stepping at that substep
+//
+// the levels are coupled at their boundaries by drifting every node at the finest rate - a
+// node that isn't kicked at a substep keeps moving along its last velocity, so its faster
+// neighbors see it where it is, not where it started the tick. a spring is evaluated whenever
+// either end is kicked, and each end only takes the impulse for its own kick length. levels of
+// neighboring nodes differ by at most one, which keeps the impulses across a boundary close.
+// at level 0 everywhere this is exactly the explicit solver's semi-implicit euler step
+//
+// the levels are computed from the tick size, the masses and the material table, and kept
+// until one of them changes. progressive springs stiffen past their rest slope, which safety
+// leaves room for. every part steps its own nodes, cross edges are parked and picked up
+// through the halo like the explicit path does, levels ordered fastest first so each substep
+// walks a prefix of each list
+template < typename precision >
+class multirateSolver {
+public:
+	using storage = typename precision::storage;
+	using scalar  = typename precision::accumulator;
+
+	static constexpr int maxLevels = 6;   // up to 32 kicks per tick
+
+	void resize( const springTopology& topology );
+
+	// the material table or the masses changed, redo the levels on the next step
+	void invalidate() { classifiedStep = 0.0f; }
+
+	// one tick for the free nodes [ firstNode, numNodes ) from current into next, the anchored
+	// nodes are read from current. levels caps the substeps at 2^( levels - 1 ), safety is the
+	// fraction of each node's local limit its kicks may take
+	void step( threadPool& pool, const springTopology& topology, const springConstants& constants,
+		const alignedArray< scalar >& inverseMass, const alignedArray< scalar >& nodeDamping,
+		const nodeState< storage >& current, nodeState< storage >& next,
+		float timeStep, float gravity, int firstNode, int levels, float safety );
+
+	int numLevels = 0;                    // levels in use, 1 + the fastest node's
+	std::vector< int > levelNodes;        // free nodes at each level
+	int springEvaluations = 0;            // per tick, a spring counting once per substep it is evaluated in
+
+private:
+	std::vector< int > nodeLevel;         // -1 for anchored nodes, which are never kicked
+
+	// each part's nodes, fastest first - part p's are [ partNodeStart[ p ], partNodeStart[ p + 1 ] )
+	// of nodeOrder, in place of the graph order
+	std::vector< int > nodeOrder;
+
+	// each part's interior edges, then its cross edges, in runs of one material and level -
+	// fastest first, so the edges needed at a substep are a prefix of each. run r covers
+	// edgeOrder[ runStart[ r ], runStart[ r + 1 ] ), part p's interior runs are
+	// [ partRunStart[ p ], partCrossRunStart[ p ] ) and its cross runs up to partRunStart[ p + 1 ]
+	std::vector< int > edgeOrder;
+	std::vector< int > runStart, runMaterial, runLevel;
+	std::vector< int > partRunStart, partCrossRunStart;
+
+	// the halo lists, ordered by the level of the node they land on
+	std::vector< int > haloOrder;
+
+	forceAccumulator< scalar > forces;
+	forceAccumulator< scalar > crossForces;
+
+	float classifiedStep = 0.0f;          // the step the levels are for, zero for none
+	int classifiedLevels = 0;
+	float classifiedSafety = 0.0f;
+
+	void classify( const springTopology& topology, const springConstants& constants, const alignedArray< scalar >& inverseMass,
+		const alignedArray< scalar >& nodeDamping, int firstNode, float timeStep, int levels, float safety );
+
+	// spring forces of one run onto its ends kicked at this substep, those at level slowest or
+	// faster - a cross edge's force is parked for node2, which picks it up with its halo
+	template < typename law, typename damper >
+	void springRun( const springTopology& topology, const lawParameters& spring, const lawParameters& shock,
+		const nodeState< storage >& state, int run, bool cross, int slowest );
+};
+
+#endif
@@ -0,0 +1,387 @@
+#include "road_noise.h"
+#include "softbody_kernels.h"
+#include "colors.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#endif
+
+#ifdef SOFTBODY_FASTNOISE2
+#include "../FastNoise2/include/FastNoise/FastNoise.h"
+#endif
+
+using std::cout;
+using std::endl;
+
+// the built in simplex - skew the plane onto a grid of triangles, find the one the point is in,
+// and sum a falloff times a gradient from each of its three corners. a corner's gradient is one
+// of eight directions, picked by the top bits of a hash of its cell and the seed
+namespace {
+
+constexpr float skew = 0.36602540378f;   // ( sqrt 3 - 1 ) / 2
+constexpr float unskew = 0.21132486540f; // ( 3 - sqrt 3 ) / 6
+constexpr uint32_t xPrime = 501125321u;
+constexpr uint32_t yPrime = 1136930381u;
+constexpr uint32_t hashMultiplier = 0x27d4eb2du;
+
+// brings the sum of the corners to about [ -1, 1 ], the largest it reaches ( measured over a few
+// million points ) is just under 1
+constexpr float simplexScale = 99.0f;
+
+constexpr float diagonal = 0.70710678f;
+alignas( 32 ) constexpr float gradientX[ 8 ] = { 1.0f, diagonal, 0.0f, -diagonal, -1.0f, -diagonal, 0.0f, diagonal };
+alignas( 32 ) constexpr float gradientY[ 8 ] = { 0.0f, diagonal, 1.0f, diagonal, 0.0f, -diagonal, -1.0f, -diagonal };
+
+constexpr int lanes = 8;                 // points per call of the vector kernel
+
+inline float cornerScalar( uint32_t seed, int32_t i, int32_t j, float x, float y ) {
+  float falloff = 0.5f - x * x - y * y;
+  falloff = falloff > 0.0f ? falloff : 0.0f;
+  falloff *= falloff;
+  falloff *= falloff;
+  const uint32_t hash = ( seed ^ ( uint32_t( i ) * xPrime ) ^ ( uint32_t( j ) * yPrime ) ) * hashMultiplier;
+  const int g = hash >> 29;
+  return falloff * ( gradientX[ g ] * x + gradientY[ g ] * y );
+}
+
+float simplexScalar( float x, float y, uint32_t seed ) {
+  const float t = ( x + y ) * skew;
+  const float fi = std::floor( x + t );
+  const float fj = std::floor( y + t );
+  const float u = ( fi + fj ) * unskew;
+  const float x0 = x - ( fi - u );
+  const float y0 = y - ( fj - u );
+
+  // the lower or upper triangle of the cell
+  const float i1 = x0 > y0 ? 1.0f : 0.0f;
+  const float j1 = 1.0f - i1;
+  const float x1 = x0 - i1 + unskew;
+  const float y1 = y0 - j1 + unskew;
+  const float x2 = x0 + ( 2.0f * unskew - 1.0f );
+  const float y2 = y0 + ( 2.0f * unskew - 1.0f );
+
+  const int32_t i = int32_t( fi );
+  const int32_t j = int32_t( fj );
+  const float sum = cornerScalar( seed, i, j, x0, y0 ) + cornerScalar( seed, i + int32_t( i1 ), j + int32_t( j1 ), x1, y1 )
+                  + cornerScalar( seed, i + 1, j + 1, x2, y2 );
+  return sum * simplexScale;
+}
+
+// cornerScalar's derivatives along x and y, added to dx and dy - the corner offsets are the point
+// less a constant, so these are the derivatives along the point's own axes
+inline void cornerGradientScalar( uint32_t seed, int32_t i, int32_t j, float x, float y, float& dx, float& dy ) {
+  const float falloff = 0.5f - x * x - y * y;
+  if ( falloff <= 0.0f ) return;
+  const float cube = falloff * falloff * falloff;
+  const uint32_t hash = ( seed ^ ( uint32_t( i ) * xPrime ) ^ ( uint32_t( j ) * yPrime ) ) * hashMultiplier;
+  const int g = hash >> 29;
+  const float dot = gradientX[ g ] * x + gradientY[ g ] * y;
+  dx += cube * ( falloff * gradientX[ g ] - 8.0f * x * dot );
+  dy += cube * ( falloff * gradientY[ g ] - 8.0f * y * dot );
+}
+
+// simplexScalar's derivatives, the same corners
+void simplexGradientScalar( float x, float y, uint32_t seed, float& dx, float& dy ) {
+  const float t = ( x + y ) * skew;
+  const float fi = std::floor( x + t );
+  const float fj = std::floor( y + t );
+  const float u = ( fi + fj ) * unskew;
+  const float x0 = x - ( fi - u );
+  const float y0 = y - ( fj - u );
+  const float i1 = x0 > y0 ? 1.0f : 0.0f;
+  const float j1 = 1.0f - i1;
+
+  const int32_t i = int32_t( fi );
+  const int32_t j = int32_t( fj );
+  dx = dy = 0.0f;
+  cornerGradientScalar( seed, i, j, x0, y0, dx, dy );
+  cornerGradientScalar( seed, i + int32_t( i1 ), j + int32_t( j1 ), x0 - i1 + unskew, y0 - j1 + unskew, dx, dy );
+  cornerGradientScalar( seed, i + 1, j + 1, x0 + ( 2.0f * unskew - 1.0f ), y0 + ( 2.0f * unskew - 1.0f ), dx, dy );
+  dx *= simplexScale;
+  dy *= simplexScale;
+}
+
+// the octaves each take the next seed, like FastNoise2's FractalFBm
+void fbmScalar( int count, const float* x, const float* y, uint32_t seed, int octaves, float bounding, float* out ) {
+  for ( int p = 0; p < count; p++ ) {
+    float sum = 0.0f, amplitude = 1.0f, frequency = 1.0f;
+    for ( int o = 0; o < octaves; o++ ) {
+      sum += simplexScalar( x[ p ] * frequency, y[ p ] * frequency, seed + o ) * amplitude;
+      amplitude *= 0.5f;
+      frequency *= 2.0f;
+    }
+    out[ p ] = sum * bounding;
+  }
+}
+
+// fbmScalar's derivatives - an octave at frequency f contributes f times its own
+void fbmGradientScalar( int count, const float* x, const float* y, uint32_t seed, int octaves, float bounding, float* dx, float* dy ) {
+  for ( int p = 0; p < count; p++ ) {
+    float sumX = 0.0f, sumY = 0.0f, amplitude = 1.0f, frequency = 1.0f;
+    for ( int o = 0; o < octaves; o++ ) {
+      float ox, oy;
+      simplexGradientScalar( x[ p ] * frequency, y[ p ] * frequency, seed + o, ox, oy );
+      sumX += ox * amplitude * frequency;
+      sumY += oy * amplitude * frequency;
+      amplitude *= 0.5f;
+      frequency *= 2.0f;
+    }
+    dx[ p ] = sumX * bounding;
+    dy[ p ] = sumY * bounding;
+  }
+}
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+// the same arithmetic as the scalar path, op for op, on 8 points
+
+__attribute__(( target( "avx2" ) ))
+inline __m256 cornerAVX2( __m256i seed, __m256i i, __m256i j, __m256 x, __m256 y ) {
+  __m256 falloff = _mm256_sub_ps( _mm256_sub_ps( _mm256_set1_ps( 0.5f ), _mm256_mul_ps( x, x ) ), _mm256_mul_ps( y, y ) );
+  falloff = _mm256_max_ps( falloff, _mm256_setzero_ps() );
+  falloff = _mm256_mul_ps( falloff, falloff );
+  falloff = _mm256_mul_ps( falloff, falloff );
+  const __m256i hash = _mm256_mullo_epi32( _mm256_xor_si256( _mm256_xor_si256( seed,
+    _mm256_mullo_epi32( i, _mm256_set1_epi32( int( xPrime ) ) ) ), _mm256_mullo_epi32( j, _mm256_set1_epi32( int( yPrime ) ) ) ),
+    _mm256_set1_epi32( int( hashMultiplier ) ) );
+  const __m256i g = _mm256_srli_epi32( hash, 29 );
+  const __m256 gx = _mm256_permutevar8x32_ps( _mm256_load_ps( gradientX ), g );
+  const __m256 gy = _mm256_permutevar8x32_ps( _mm256_load_ps( gradientY ), g );
+  return _mm256_mul_ps( falloff, _mm256_add_ps( _mm256_mul_ps( gx, x ), _mm256_mul_ps( gy, y ) ) );
+}
+
+__attribute__(( target( "avx2" ) ))
+inline __m256 simplexAVX2( __m256 x, __m256 y, __m256i seed ) {
+  const __m256 one = _mm256_set1_ps( 1.0f );
+  const __m256 t = _mm256_mul_ps( _mm256_add_ps( x, y ), _mm256_set1_ps( skew ) );
+  const __m256 fi = _mm256_floor_ps( _mm256_add_ps( x, t ) );
+  const __m256 fj = _mm256_floor_ps( _mm256_add_ps( y, t ) );
+  const __m256 u = _mm256_mul_ps( _mm256_add_ps( fi, fj ), _mm256_set1_ps( unskew ) );
+  const __m256 x0 = _mm256_sub_ps( x, _mm256_sub_ps( fi, u ) );
+  const __m256 y0 = _mm256_sub_ps( y, _mm256_sub_ps( fj, u ) );
+
+  const __m256 i1 = _mm256_and_ps( _mm256_cmp_ps( x0, y0, _CMP_GT_OQ ), one );
+  const __m256 j1 = _mm256_sub_ps( one, i1 );
+  const __m256 x1 = _mm256_add_ps( _mm256_sub_ps( x0, i1 ), _mm256_set1_ps( unskew ) );
+  const __m256 y1 = _mm256_add_ps( _mm256_sub_ps( y0, j1 ), _mm256_set1_ps( unskew ) );
+  const __m256 x2 = _mm256_add_ps( x0, _mm256_set1_ps( 2.0f * unskew - 1.0f ) );
+  const __m256 y2 = _mm256_add_ps( y0, _mm256_set1_ps( 2.0f * unskew - 1.0f ) );
+
+  const __m256i i = _mm256_cvttps_epi32( fi );
+  const __m256i j = _mm256_cvttps_epi32( fj );
+  const __m256i ones = _mm256_set1_epi32( 1 );
+  const __m256 sum = _mm256_add_ps( _mm256_add_ps( cornerAVX2( seed, i, j, x0, y0 ),
+    cornerAVX2( seed, _mm256_add_epi32( i, _mm256_cvttps_epi32( i1 ) ), _mm256_add_epi32( j, _mm256_cvttps_epi32( j1 ) ), x1, y1 ) ),
+    cornerAVX2( seed, _mm256_add_epi32( i, ones ), _mm256_add_epi32( j, ones ), x2, y2 ) );
+  return _mm256_mul_ps( sum, _mm256_set1_ps( simplexScale ) );
+}
+
+// count points, the last partial group of 8 through a padded copy
+__attribute__(( target( "avx2" ) ))
+void fbmAVX2( int count, const float* x, const float* y, uint32_t seed, int octaves, float bounding, float* out ) {
+  for ( int p = 0; p < count; p += lanes ) {
+    alignas( 32 ) float px[ lanes ] = {}, py[ lanes ] = {}, result[ lanes ];
+    const int n = std::min( lanes, count - p );
+    std::copy( x + p, x + p + n, px );
+    std::copy( y + p, y + p + n, py );
+    __m256 sum = _mm256_setzero_ps();
+    float amplitude = 1.0f, frequency = 1.0f;
+    for ( int o = 0; o < octaves; o++ ) {
+      const __m256 octave = simplexAVX2( _mm256_mul_ps( _mm256_load_ps( px ), _mm256_set1_ps( frequency ) ),
+        _mm256_mul_ps( _mm256_load_ps( py ), _mm256_set1_ps( frequency ) ), _mm256_set1_epi32( int( seed + o ) ) );
+      sum = _mm256_add_ps( sum, _mm256_mul_ps( octave, _mm256_set1_ps( amplitude ) ) );
+      amplitude *= 0.5f;
+      frequency *= 2.0f;
+    }
+    _mm256_store_ps( result, _mm256_mul_ps( sum, _mm256_set1_ps( bounding ) ) );
+    std::copy( result, result + n, out + p );
+  }
+}
+#endif
+
+class builtinNoise : public roadNoise {
+public:
+  explicit builtinNoise( int octaves ) : octaves( std::max( octaves, 1 ) ) {
+    // the octaves' amplitudes sum to this, scaled back to the range of one
+    float sum = 0.0f, amplitude = 1.0f;
+    for ( int o = 0; o < this->octaves; o++ ) {
+      sum += amplitude;
+      amplitude *= 0.5f;
+    }
+    bounding = 1.0f / sum;
+  }
+
+  // one point would fill one lane of eight, the scalar path gives the same value for less
+  float GenSingle2D( float x, float y, int seed ) const override {
+    float out;
+    fbmScalar( 1, &x, &y, uint32_t( seed ), octaves, bounding, &out );
+    return out;
+  }
+
+  void GenUniformGrid2D( float* out, int xStart, int yStart, int xSize, int ySize, float frequency, int seed ) const override {
+    std::vector< float > x( xSize ), y( xSize );
+    for ( int i = 0; i < xSize; i++ )
+      x[ i ] = ( xStart + i ) * frequency;
+    for ( int j = 0; j < ySize; j++ ) {
+      std::fill( y.begin(), y.end(), ( yStart + j ) * frequency );
+      evaluate( xSize, x.data(), y.data(), seed, out + size_t( j ) * xSize );
+    }
+  }
+
+  void GenPositionArray2D( float* out, int count, const float* x, const float* y, float xOffset, float yOffset, int seed ) const override {
+    if ( xOffset == 0.0f && yOffset == 0.0f ) {
+      evaluate( count, x, y, seed, out );
+      return;
+    }
+    std::vector< float > shiftedX( count ), shiftedY( count );
+    for ( int i = 0; i < count; i++ ) {
+      shiftedX[ i ] = x[ i ] + xOffset;
+      shiftedY[ i ] = y[ i ] + yOffset;
+    }
+    evaluate( count, shiftedX.data(), shiftedY.data(), seed, out );
+  }
+
+  // the values through the same lanes as every other call, the derivatives in closed form
+  void GenPositionGradient2D( float* out, float* dx, float* dy, int count, const float* x, const float* y, int seed ) const override {
+    evaluate( count, x, y, seed, out );
+    fbmGradientScalar( count, x, y, uint32_t( seed ), octaves, bounding, dx, dy );
+  }
+
+  const char* name() const override { return "built in simplex"; }
+
+private:
+  int octaves;
+  float bounding;
+
+  void evaluate( int count, const float* x, const float* y, int seed, float* out ) const {
+#if defined( __x86_64__ ) || defined( __i386__ )
+    if ( currentSpringKernel() >= AVX2 ) {
+      fbmAVX2( count, x, y, uint32_t( seed ), octaves, bounding, out );
+      return;
+    }
+#endif
+    fbmScalar( count, x, y, uint32_t( seed ), octaves, bounding, out );
+  }
+};
+
+#ifdef SOFTBODY_FASTNOISE2
+class fastNoise2 : public roadNoise {
+public:
+  explicit fastNoise2( int octaves ) {
+    auto fnSimplex = FastNoise::New< FastNoise::Simplex >();
+    auto fnFractal = FastNoise::New< FastNoise::FractalFBm >();
+    fnFractal->SetSource( fnSimplex );
+    fnFractal->SetOctaveCount( octaves );
+    generator = fnFractal;
+  }
+
+  float GenSingle2D( float x, float y, int seed ) const override {
+    return generator->GenSingle2D( x, y, seed );
+  }
+
+  void GenUniformGrid2D( float* out, int xStart, int yStart, int xSize, int ySize, float frequency, int seed ) const override {
+    generator->GenUniformGrid2D( out, xStart, yStart, xSize, ySize, frequency, seed );
+  }
+
+  void GenPositionArray2D( float* out, int count, const float* x, const float* y, float xOffset, float yOffset, int seed ) const override {
+    generator->GenPositionArray2D( out, count, x, y, xOffset, yOffset, seed );
+  }
+
+  const char* name() const override { return "FastNoise2"; }
+
+private:
+  FastNoise::SmartNode<> generator;
+};
+#endif
+
+}
+
+void roadNoise::GenPositionGradient2D( float* out, float* dx, float* dy, int count, const float* x, const float* y, int seed ) const {
+  // each point and a step either side of it along x and y, in one batch
+  constexpr float step = 1e-3f;
+  std::vector< float > u( size_t( count ) * 5 ), v( size_t( count ) * 5 ), noise( size_t( count ) * 5 );
+  for ( int i = 0; i < count; i++ ) {
+    float* pu = &u[ size_t( i ) * 5 ];
+    float* pv = &v[ size_t( i ) * 5 ];
+    pu[ 0 ] = x[ i ];        pv[ 0 ] = y[ i ];
+    pu[ 1 ] = x[ i ] - step; pv[ 1 ] = y[ i ];
+    pu[ 2 ] = x[ i ] + step; pv[ 2 ] = y[ i ];
+    pu[ 3 ] = x[ i ];        pv[ 3 ] = y[ i ] - step;
+    pu[ 4 ] = x[ i ];        pv[ 4 ] = y[ i ] + step;
+  }
+  GenPositionArray2D( noise.data(), count * 5, u.data(), v.data(), 0.0f, 0.0f, seed );
+  for ( int i = 0; i < count; i++ ) {
+    const float* n = &noise[ size_t( i ) * 5 ];
+    out[ i ] = n[ 0 ];
+    dx[ i ] = ( n[ 2 ] - n[ 1 ] ) / ( 2.0f * step );
+    dy[ i ] = ( n[ 4 ] - n[ 3 ] ) / ( 2.0f * step );
+  }
+}
+
+bool noiseBackendAvailable( noiseBackend backend ) {
+#ifdef SOFTBODY_FASTNOISE2
+  if ( backend == FASTNOISE2_NOISE ) return true;
+#endif
+  return backend == BUILTIN_NOISE;
+}
+
+std::shared_ptr< const roadNoise > makeRoadNoise( noiseBackend backend, int octaves ) {
+#ifdef SOFTBODY_FASTNOISE2
+  if ( backend == FASTNOISE2_NOISE )
+    return std::make_shared< fastNoise2 >( octaves );
+#endif
+  return std::make_shared< builtinNoise >( octaves );
+}
+
+// the road's octave count, at sizes like the road cache's work - a 200 wide grid of rows, and
+// positions scattered over it like wheel contacts
+void BenchmarkRoadNoise( int samples, float seconds ) {
+  const int columns = 200;
+  const int rows = std::max( samples / columns, 1 );
+  std::vector< float > out( size_t( columns ) * rows ), single( samples ), x( samples ), y( samples );
+  for ( int i = 0; i < samples; i++ ) {
+    x[ i ] = -1.0f + 2.0f * ( ( i * 7919 ) % samples ) / samples;
+    y[ i ] = -1.5f + 3.0f * ( ( i * 104729 ) % samples ) / samples;
+  }
+
+  cout << T_BLUE << "    Road noise benchmark" << RESET << " - 2 octaves, " << samples << " points per call, "
+       << kernelName( currentSpringKernel() ) << " kernel" << endl;
+  cout << "      backend               single ns   grid ns  array ns    checksum" << endl;
+
+  for ( noiseBackend backend : { BUILTIN_NOISE, FASTNOISE2_NOISE } ) {
+    if ( !noiseBackendAvailable( backend ) ) continue;
+    const std::shared_ptr< const roadNoise > noise = makeRoadNoise( backend, 2 );
+
+    // ns per point of f, which does count points per call, repeated for about seconds
+    auto time = [&]( int count, auto&& f ) {
+      int calls = 0;
+      const auto start = std::chrono::steady_clock::now();
+      double elapsed = 0.0;
+      do {
+        f();
+        calls++;
+        elapsed = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+      } while ( elapsed < seconds );
+      return elapsed * 1e9 / ( double( calls ) * count );
+    };
+    const double singleNs = time( samples, [&]() {
+      for ( int i = 0; i < samples; i++ ) single[ i ] = noise->GenSingle2D( x[ i ], y[ i ], 42069 );
+    } );
+    const double gridNs = time( columns * rows, [&]() { noise->GenUniformGrid2D( out.data(), -100, -150, columns, rows, 0.01f, 42069 ); } );
+    const double arrayNs = time( samples, [&]() { noise->GenPositionArray2D( out.data(), samples, x.data(), y.data(), 0.0f, 0.0f, 42069 ); } );
+
+    double checksum = 0.0;
+    for ( float v : out ) checksum += v;
+    for ( float v : single ) checksum += v;
+    cout << "      " << std::left << std::setw( 21 ) << noise->name() << std::right << std::fixed << std::setprecision( 1 )
+         << std::setw( 10 ) << singleNs << std::setw( 10 ) << gridNs << std::setw( 10 ) << arrayNs
+         << std::setprecision( 4 ) << std::setw( 12 ) << checksum << std::defaultfloat << std::setprecision( 6 ) << endl;
+  }
+}
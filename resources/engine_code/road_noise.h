@@ -0,0 +1,47 @@
+#ifndef ROAD_NOISE
+#define ROAD_NOISE
+
+#include <memory>
+
+// the noise the road is made of, behind the three calls the simulation makes of it - shaped like
+// FastNoise2's, so either backend fits. the built in one needs nothing outside the tree: 2D
+// simplex noise summed over fractal brownian motion octaves, evaluated 8 points at a time with
+// AVX2 when currentSpringKernel allows it and in plain C++ otherwise, so deterministic mode gets
+// the scalar noise with the scalar springs. every call goes through the same lanes, so a point
+// gets the same value whichever call asked for it. FastNoise2 is the other backend, when the build
+// has it ( SOFTBODY_FASTNOISE2, set by CMakeLists.txt when the submodule is checked out )
+class roadNoise {
+public:
+	virtual ~roadNoise() {}
+
+	virtual float GenSingle2D( float x, float y, int seed ) const = 0;
+
+	// out[ i + j xSize ] is the noise at ( ( xStart + i ) frequency, ( yStart + j ) frequency )
+	virtual void GenUniformGrid2D( float* out, int xStart, int yStart, int xSize, int ySize, float frequency, int seed ) const = 0;
+
+	// out[ i ] is the noise at ( x[ i ] + xOffset, y[ i ] + yOffset )
+	virtual void GenPositionArray2D( float* out, int count, const float* x, const float* y, float xOffset, float yOffset, int seed ) const = 0;
+
+	// GenPositionArray2D at offset zero, with the noise's derivatives along x and y in dx and dy -
+	// central differences here, a backend with them in closed form overrides it
+	virtual void GenPositionGradient2D( float* out, float* dx, float* dy, int count, const float* x, const float* y, int seed ) const;
+
+	virtual const char* name() const = 0;
+};
+
+enum noiseBackend {
+	BUILTIN_NOISE,                        // simplex fbm, in tree
+	FASTNOISE2_NOISE                      // FastNoise2's Simplex under FractalFBm
+};
+
+bool noiseBackendAvailable( noiseBackend backend );
+
+// fractal simplex noise, octaves of it each at twice the frequency and half the amplitude of the
+// last. a backend this build doesn't have falls back to the built in one
+std::shared_ptr< const roadNoise > makeRoadNoise( noiseBackend backend, int octaves );
+
+// time each backend this build has at single points, grids and position arrays, and print it to
+// the console - samples is the number of points per call
+void BenchmarkRoadNoise( int samples = 60000, float seconds = 0.5f );
+
+#endif
@@ -0,0 +1,11 @@
+#version 450
+
+in vec4 color;
+
+out vec4 fragColor;
+
+void main() {
+  // darkened with depth, like the rest of the geometry
+  fragColor = color;
+  fragColor.xyz *= 1.25 - gl_FragCoord.z / 3.;
+}
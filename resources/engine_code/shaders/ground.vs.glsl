@@ -0,0 +1,71 @@
+#version 450
+
+// a point of the fixed ground grid, display space x and z - the height is read here
+in vec2 vPosition;
+
+// the simulation's road cache mirrored - raw noise or the spectral road's meters, one texel per grid point, grid row j of
+// the road in texture row j mod ringRows. see heightfieldCache
+layout( binding = 1 ) uniform sampler2D heights;
+uniform float spacing;
+uniform int firstColumn;
+uniform int ringRows;
+
+uniform float offset;     // how far the road has scrolled
+uniform float amplitude;  // texel to height, softbodySimulation::RoadAmplitude
+
+uniform vec4 groundLow;
+uniform vec4 groundHigh;
+
+uniform float theta;
+uniform float phi;
+uniform float roll;
+
+uniform float aspect_ratio;
+
+
+out vec4 color;
+
+
+//thanks to Neil Mendoza via http://www.neilmendoza.com/glsl-rotation-about-an-arbitrary-axis/
+mat3 rotationMatrix(vec3 axis, float angle) {
+    axis = normalize(axis);
+    float s = sin(angle);
+    float c = cos(angle);
+    float oc = 1.0 - c;
+
+    return mat3(oc * axis.x * axis.x + c,           oc * axis.x * axis.y - axis.z * s,  oc * axis.z * axis.x + axis.y * s,
+                oc * axis.x * axis.y + axis.z * s,  oc * axis.y * axis.y + c,           oc * axis.y * axis.z - axis.x * s,
+                oc * axis.z * axis.x - axis.y * s,  oc * axis.y * axis.z + axis.x * s,  oc * axis.z * axis.z + c);
+}
+
+float noiseAt( int i, int j ) {
+    // mod, not %, which is undefined for the negative rows
+    return texelFetch( heights, ivec2( i, int( mod( float( j ), float( ringRows ) ) ) ), 0 ).r;
+}
+
+void main() {
+    // bilinear between the grid points, the same as heightfieldCache::sample
+    float x = vPosition.x / spacing - float( firstColumn );
+    float y = ( vPosition.y + offset ) / spacing;
+    int i = int( floor( x ) );
+    int j = int( floor( y ) );
+    float lower = mix( noiseAt( i, j ), noiseAt( i + 1, j ), x - float( i ) );
+    float upper = mix( noiseAt( i, j + 1 ), noiseAt( i + 1, j + 1 ), x - float( i ) );
+    float height = mix( lower, upper, y - float( j ) ) * amplitude - 0.4;
+
+    color = vec4( ( 4.0 * height * groundHigh + ( 1.0 - 4.0 * height ) * groundLow ).xyz, 1.0 );
+
+    // same view as main.vs.glsl
+    mat3 rotx = rotationMatrix(vec3(1,0,0), theta);
+    mat3 roty = rotationMatrix(vec3(0,1,0), phi);
+    vec3 position = roty*rotx*vec3( vPosition.x, height, vPosition.y );
+
+    vec3 roll_vec = roty*rotx*vec3(0,0,1);
+    mat3 roll_mat = rotationMatrix(roll_vec, roll);
+
+    position *= roll_mat;
+
+    gl_Position = vec4( position, 1.0 );
+    gl_Position.x /= aspect_ratio;
+    gl_Position.z *= 0.3;
+}
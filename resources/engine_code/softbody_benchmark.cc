@@ -0,0 +1,99 @@
+#include "softbody_simulation.h"
+#include "colors.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+using std::cout;
+using std::endl;
+
+// largest relative stretch or compression over all springs, or infinity once anything
+// has gone non finite
+float softbodySimulation::MaxStrain() const {
+  const springTopology& topology = sharedGraph->topology;
+  return WithActiveBuffers( [&]( const auto& b ) {
+    const auto& s = b.state.current();
+    float strain = 0.0f;
+    for ( int e = 0; e < topology.numEdges; e++ ) {
+      const int n1 = topology.node1[ e ];
+      const int n2 = topology.node2[ e ];
+      const float dx = s.px[ n1 ] - s.px[ n2 ];
+      const float dy = s.py[ n1 ] - s.py[ n2 ];
+      const float dz = s.pz[ n1 ] - s.pz[ n2 ];
+      const float stretch = std::abs( std::sqrt( dx * dx + dy * dy + dz * dz ) * topology.inverseBaseLength[ e ] - 1.0f );
+      if ( !std::isfinite( stretch ) ) return std::numeric_limits< float >::infinity();
+      strain = std::max( strain, stretch );
+    }
+    return strain;
+  } );
+}
+
+// stability at a fixed frame budget - every solver drives the same road from the rest pose at
+// a range of tick sizes. a run is stable if no spring ever strays more than half its rest
+// length. the tick cost gives how many ticks fit in frameBudget ms of a 60 Hz frame, and so
+// how many seconds of simulation that budget buys per second of wall clock
+void softbodySimulation::BenchmarkSolvers( threadPool& pool, float frameBudget, float simulatedSeconds ) {
+  const simParameterPack saved = simParameters;
+  const float savedNoiseOffset = noiseOffset;
+  const float tickSizes[] = { 0.0005f, 0.001f, 0.003f, 0.005f, 0.01f, 0.03f, 0.1f };
+  struct configuration { const char* name; int solver, integrator; };
+  const configuration configurations[] = {
+    { "semi-implicit euler", EXPLICIT_EULER, SEMI_IMPLICIT_EULER },
+    { "position verlet",     EXPLICIT_EULER, POSITION_VERLET },
+    { "velocity verlet",     EXPLICIT_EULER, VELOCITY_VERLET },
+    { "implicit euler",      IMPLICIT_EULER, SEMI_IMPLICIT_EULER },
+    { "XPBD",                XPBD,           SEMI_IMPLICIT_EULER },
+    { "multirate",           MULTIRATE,      SEMI_IMPLICIT_EULER } };
+
+  cout << T_BLUE << "    Solver benchmark" << RESET << " - " << frameBudget << "ms per 60Hz frame, "
+       << simulatedSeconds << "s drive, " << sharedGraph->nodes.size() << " nodes, " << sharedGraph->topology.numEdges << " springs, "
+       << precisionName( activePrecision ) << " precision" << endl;
+  cout << "      solver                tick      stable  max strain    us/tick  ticks/frame  sim speed" << endl;
+
+  for ( const configuration& c : configurations ) {
+    for ( float tick : tickSizes ) {
+      simParameters = saved;
+      simParameters.solver = c.solver;
+      simParameters.integrator = c.integrator;
+      simParameters.timeScale = tick;
+      simParameters.adaptiveTimeStep = false;
+      noiseOffset = savedNoiseOffset;
+      ResetSimulationState();
+
+      // same road speed as real time stepping
+      const float noiseStep = NoiseStep();
+      const int ticks = std::ceil( simulatedSeconds / tick );
+      float maxStrain = 0.0f;
+      double seconds = 0.0;
+      int ticksRun = 0;
+      while ( ticksRun < ticks && maxStrain < 0.5f ) {
+        // strain is checked between batches, so it stays out of the timing
+        const int batch = std::min( ticks - ticksRun, std::max( ticks / 20, 1 ) );
+        auto tstart = std::chrono::high_resolution_clock::now();
+        for ( int i = 0; i < batch; i++ )
+          Substep( pool, noiseStep );
+        seconds += std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - tstart ).count();
+        ticksRun += batch;
+        maxStrain = std::max( maxStrain, MaxStrain() );
+      }
+
+      const bool stable = maxStrain < 0.5f;
+      const double tickCost = seconds / ticksRun;
+      const double ticksPerFrame = frameBudget * 0.001 / tickCost;
+      cout << "      " << std::left << std::setw( 21 ) << c.name << std::right << std::setw( 7 ) << tick
+           << ( stable ? T_GREEN + "       yes" : T_RED + "        no" ) << RESET
+           << std::setw( 12 ) << std::setprecision( 3 ) << maxStrain
+           << std::setw( 11 ) << std::fixed << std::setprecision( 1 ) << tickCost * 1e6
+           << std::setw( 13 ) << std::setprecision( 0 ) << ticksPerFrame;
+      if ( stable )
+        cout << std::setw( 10 ) << std::setprecision( 2 ) << ticksPerFrame * tick * 60.0 << "x";
+      cout << std::defaultfloat << std::setprecision( 6 ) << endl;
+    }
+  }
+
+  simParameters = saved;
+  noiseOffset = savedNoiseOffset;
+  ResetSimulationState();
+}
@@ -0,0 +1,18 @@
+#ifndef SOFTBODY_CORE
+#define SOFTBODY_CORE
+
+// the simulation without the renderer - what the softbody_core library exports, with no windowing,
+// GL or UI anywhere in it. the GUI ( model.h ) and softbody_headless are both built on this and
+// nothing else. the pieces, in the order a program meets them:
+//
+//   vehicleGraph        nodes, springs and panels - loadFrame, or addNode / addEdge / addFace,
+//                       then finalize. read only after that, shared by any number of simulations
+//   loadVehicleGraph    the stock path from an obj file to a finalized graph
+//   simParameterPack    solver, integrator, precision, tick size, masses, materials and road
+//   softbodySimulation  one vehicle over a graph - Load it, then Substep once per tick on a
+//                       threadPool. State hands out the live SoA arrays without a copy
+//   ensemble            many vehicles over one graph, stepped across a pool
+#include "softbody_simulation.h"
+#include "ensemble.h"
+
+#endif
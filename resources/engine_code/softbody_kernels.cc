@@ -0,0 +1,414 @@
+#include "softbody_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#endif
+
+// everything one spring pass needs, unpacked to raw pointers, for one batch of edges
+template < typename storage, typename accumulator >
+struct springPassArgs {
+  const int* n1; const int* n2;
+  const float* baseLength; const float* inverseBaseLength;
+  lawParameters spring, shock;            // the batch's material
+  float d;
+  const storage* px; const storage* py; const storage* pz;
+  const storage* vx; const storage* vy; const storage* vz;
+  accumulator* fx; accumulator* fy; accumulator* fz;
+  accumulator* cfx; accumulator* cfy; accumulator* cfz;
+  int firstEdge, firstCross, lastEdge;
+  int firstMoving;                        // nodes before it are outside every part, the anchored ones
+};
+
+// add one spring's force to its endpoints - damping is on each endpoint's own velocity. an
+// anchored node2 is shared by the parts around it and never integrated, so it is skipped, which
+// keeps the parts from writing it at once
+template < typename storage, typename accumulator >
+static inline void scatterSpringForce( const springPassArgs< storage, accumulator >& a, int e,
+  accumulator sx, accumulator sy, accumulator sz ) {
+  const int n1 = a.n1[ e ];
+  const int n2 = a.n2[ e ];
+  const accumulator d = a.d;
+
+  a.fx[ n1 ] += sx - d * a.vx[ n1 ];
+  a.fy[ n1 ] += sy - d * a.vy[ n1 ];
+  a.fz[ n1 ] += sz - d * a.vz[ n1 ];
+
+  if ( e < a.firstCross ) {
+    // equal and opposite, node2 is ours too - or anchored
+    if ( n2 < a.firstMoving ) return;
+    a.fx[ n2 ] -= sx + d * a.vx[ n2 ];
+    a.fy[ n2 ] -= sy + d * a.vy[ n2 ];
+    a.fz[ n2 ] -= sz + d * a.vz[ n2 ];
+  } else {
+    // node2 belongs to another part, which picks this up in gatherHaloForces
+    a.cfx[ e ] = sx;
+    a.cfy[ e ] = sy;
+    a.cfz[ e ] = sz;
+  }
+}
+
+// reference kernel, one spring at a time, and the only one for double storage - the
+// difference is taken in the accumulator type, so it is exact in mixed precision
+template < typename law, typename damper, typename storage, typename accumulator >
+static void springPassScalar( const springPassArgs< storage, accumulator >& a, int first ) {
+  const lawParameters spring = a.spring, shock = a.shock;
+  for ( int e = first; e < a.lastEdge; e++ ) {
+    const int n1 = a.n1[ e ];
+    const int n2 = a.n2[ e ];
+
+    const accumulator dx = accumulator( a.px[ n1 ] ) - a.px[ n2 ];
+    const accumulator dy = accumulator( a.py[ n1 ] ) - a.py[ n2 ];
+    const accumulator dz = accumulator( a.pz[ n1 ] ) - a.pz[ n2 ];
+    const accumulator length = std::sqrt( dx * dx + dy * dy + dz * dz );
+
+    // tension from the length ratio, along the unit direction from node2 to node1 - one
+    // sqrt gives both the distance and the normalization the node centric loop did twice
+    accumulator tension = law::force( length / a.baseLength[ e ] - 1.0f, spring );
+    if constexpr ( damper::active ) {
+      // the shock works against the extension speed, the relative velocity along the spring
+      const accumulator rate = ( dx * ( accumulator( a.vx[ n1 ] ) - a.vx[ n2 ] ) + dy * ( accumulator( a.vy[ n1 ] ) - a.vy[ n2 ] )
+                               + dz * ( accumulator( a.vz[ n1 ] ) - a.vz[ n2 ] ) ) / length;
+      tension += damper::force( rate, shock );
+    }
+    const accumulator scale = -tension / length;
+    scatterSpringForce( a, e, scale * dx, scale * dy, scale * dz );
+  }
+}
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+// the vector kernels compute the spring force for a batch of springs in registers, then
+// scatter lane by lane - two lanes may share a node, so the adds stay scalar. the force is
+// always float here, in mixed precision only the sums it is scattered into are double
+
+template < typename law, typename damper, typename accumulator >
+__attribute__(( target( "sse4.2" ) ))
+static void springPassSSE42( const springPassArgs< float, accumulator >& a ) {
+  alignas( 16 ) float sx[ 4 ], sy[ 4 ], sz[ 4 ];
+  const __m128 half = _mm_set1_ps( 0.5f ), threeHalves = _mm_set1_ps( 1.5f ), one = _mm_set1_ps( 1.0f );
+  const lawParameters spring = a.spring, shock = a.shock;
+  int e = a.firstEdge;
+  for ( ; e + 4 <= a.lastEdge; e += 4 ) {
+    const int* i1 = a.n1 + e;
+    const int* i2 = a.n2 + e;
+    const __m128 dx = _mm_sub_ps( _mm_setr_ps( a.px[ i1[ 0 ] ], a.px[ i1[ 1 ] ], a.px[ i1[ 2 ] ], a.px[ i1[ 3 ] ] ),
+                                  _mm_setr_ps( a.px[ i2[ 0 ] ], a.px[ i2[ 1 ] ], a.px[ i2[ 2 ] ], a.px[ i2[ 3 ] ] ) );
+    const __m128 dy = _mm_sub_ps( _mm_setr_ps( a.py[ i1[ 0 ] ], a.py[ i1[ 1 ] ], a.py[ i1[ 2 ] ], a.py[ i1[ 3 ] ] ),
+                                  _mm_setr_ps( a.py[ i2[ 0 ] ], a.py[ i2[ 1 ] ], a.py[ i2[ 2 ] ], a.py[ i2[ 3 ] ] ) );
+    const __m128 dz = _mm_sub_ps( _mm_setr_ps( a.pz[ i1[ 0 ] ], a.pz[ i1[ 1 ] ], a.pz[ i1[ 2 ] ], a.pz[ i1[ 3 ] ] ),
+                                  _mm_setr_ps( a.pz[ i2[ 0 ] ], a.pz[ i2[ 1 ] ], a.pz[ i2[ 2 ] ], a.pz[ i2[ 3 ] ] ) );
+
+    // 1 / length from rsqrt plus one newton step, length as lengthSquared / length
+    const __m128 lengthSquared = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) );
+    __m128 inverseLength = _mm_rsqrt_ps( lengthSquared );
+    inverseLength = _mm_mul_ps( inverseLength, _mm_sub_ps( threeHalves,
+      _mm_mul_ps( _mm_mul_ps( half, lengthSquared ), _mm_mul_ps( inverseLength, inverseLength ) ) ) );
+    const __m128 length = _mm_mul_ps( lengthSquared, inverseLength );
+
+    const __m128 stretch = _mm_sub_ps( _mm_mul_ps( length, _mm_loadu_ps( a.inverseBaseLength + e ) ), one );
+    __m128 tension = law::force( stretch, spring );
+    if constexpr ( damper::active ) {
+      const __m128 wx = _mm_sub_ps( _mm_setr_ps( a.vx[ i1[ 0 ] ], a.vx[ i1[ 1 ] ], a.vx[ i1[ 2 ] ], a.vx[ i1[ 3 ] ] ),
+                                    _mm_setr_ps( a.vx[ i2[ 0 ] ], a.vx[ i2[ 1 ] ], a.vx[ i2[ 2 ] ], a.vx[ i2[ 3 ] ] ) );
+      const __m128 wy = _mm_sub_ps( _mm_setr_ps( a.vy[ i1[ 0 ] ], a.vy[ i1[ 1 ] ], a.vy[ i1[ 2 ] ], a.vy[ i1[ 3 ] ] ),
+                                    _mm_setr_ps( a.vy[ i2[ 0 ] ], a.vy[ i2[ 1 ] ], a.vy[ i2[ 2 ] ], a.vy[ i2[ 3 ] ] ) );
+      const __m128 wz = _mm_sub_ps( _mm_setr_ps( a.vz[ i1[ 0 ] ], a.vz[ i1[ 1 ] ], a.vz[ i1[ 2 ] ], a.vz[ i1[ 3 ] ] ),
+                                    _mm_setr_ps( a.vz[ i2[ 0 ] ], a.vz[ i2[ 1 ] ], a.vz[ i2[ 2 ] ], a.vz[ i2[ 3 ] ] ) );
+      const __m128 rate = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, wx ), _mm_mul_ps( dy, wy ) ), _mm_mul_ps( dz, wz ) ), inverseLength );
+      tension = _mm_add_ps( tension, damper::force( rate, shock ) );
+    }
+    const __m128 scale = _mm_mul_ps( _mm_sub_ps( _mm_setzero_ps(), tension ), inverseLength );
+    _mm_store_ps( sx, _mm_mul_ps( scale, dx ) );
+    _mm_store_ps( sy, _mm_mul_ps( scale, dy ) );
+    _mm_store_ps( sz, _mm_mul_ps( scale, dz ) );
+    for ( int l = 0; l < 4; l++ )
+      scatterSpringForce< float, accumulator >( a, e + l, sx[ l ], sy[ l ], sz[ l ] );
+  }
+  springPassScalar< law, damper >( a, e );
+}
+
+template < typename law, typename damper, typename accumulator >
+__attribute__(( target( "avx2,fma" ) ))
+static void springPassAVX2( const springPassArgs< float, accumulator >& a ) {
+  alignas( 32 ) float sx[ 8 ], sy[ 8 ], sz[ 8 ];
+  const __m256 half = _mm256_set1_ps( 0.5f ), threeHalves = _mm256_set1_ps( 1.5f ), one = _mm256_set1_ps( 1.0f );
+  const lawParameters spring = a.spring, shock = a.shock;
+  int e = a.firstEdge;
+  for ( ; e + 8 <= a.lastEdge; e += 8 ) {
+    const __m256i i1 = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( a.n1 + e ) );
+    const __m256i i2 = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( a.n2 + e ) );
+    const __m256 dx = _mm256_sub_ps( _mm256_i32gather_ps( a.px, i1, 4 ), _mm256_i32gather_ps( a.px, i2, 4 ) );
+    const __m256 dy = _mm256_sub_ps( _mm256_i32gather_ps( a.py, i1, 4 ), _mm256_i32gather_ps( a.py, i2, 4 ) );
+    const __m256 dz = _mm256_sub_ps( _mm256_i32gather_ps( a.pz, i1, 4 ), _mm256_i32gather_ps( a.pz, i2, 4 ) );
+
+    const __m256 lengthSquared = _mm256_fmadd_ps( dz, dz, _mm256_fmadd_ps( dy, dy, _mm256_mul_ps( dx, dx ) ) );
+    __m256 inverseLength = _mm256_rsqrt_ps( lengthSquared );
+    inverseLength = _mm256_mul_ps( inverseLength, _mm256_fnmadd_ps( _mm256_mul_ps( half, lengthSquared ),
+      _mm256_mul_ps( inverseLength, inverseLength ), threeHalves ) );
+    const __m256 length = _mm256_mul_ps( lengthSquared, inverseLength );
+
+    const __m256 stretch = _mm256_sub_ps( _mm256_mul_ps( length, _mm256_loadu_ps( a.inverseBaseLength + e ) ), one );
+    __m256 tension = law::force( stretch, spring );
+    if constexpr ( damper::active ) {
+      const __m256 wx = _mm256_sub_ps( _mm256_i32gather_ps( a.vx, i1, 4 ), _mm256_i32gather_ps( a.vx, i2, 4 ) );
+      const __m256 wy = _mm256_sub_ps( _mm256_i32gather_ps( a.vy, i1, 4 ), _mm256_i32gather_ps( a.vy, i2, 4 ) );
+      const __m256 wz = _mm256_sub_ps( _mm256_i32gather_ps( a.vz, i1, 4 ), _mm256_i32gather_ps( a.vz, i2, 4 ) );
+      const __m256 rate = _mm256_mul_ps( _mm256_fmadd_ps( dz, wz, _mm256_fmadd_ps( dy, wy, _mm256_mul_ps( dx, wx ) ) ), inverseLength );
+      tension = _mm256_add_ps( tension, damper::force( rate, shock ) );
+    }
+    const __m256 scale = _mm256_mul_ps( _mm256_sub_ps( _mm256_setzero_ps(), tension ), inverseLength );
+    _mm256_store_ps( sx, _mm256_mul_ps( scale, dx ) );
+    _mm256_store_ps( sy, _mm256_mul_ps( scale, dy ) );
+    _mm256_store_ps( sz, _mm256_mul_ps( scale, dz ) );
+    for ( int l = 0; l < 8; l++ )
+      scatterSpringForce< float, accumulator >( a, e + l, sx[ l ], sy[ l ], sz[ l ] );
+  }
+  springPassScalar< law, damper >( a, e );
+}
+
+// full mask forms with a zeroed source - the plain intrinsics trip -Wmaybe-uninitialized on gcc 12
+__attribute__(( target( "avx512f" ) ))
+static inline __m512 gather16( const float* base, __m512i index ) {
+  return _mm512_mask_i32gather_ps( _mm512_setzero_ps(), 0xFFFF, index, base, 4 );
+}
+
+__attribute__(( target( "avx512f" ) ))
+static inline __m512 rsqrt16( __m512 x ) {
+  return _mm512_mask_rsqrt14_ps( _mm512_setzero_ps(), 0xFFFF, x );
+}
+
+template < typename law, typename damper, typename accumulator >
+__attribute__(( target( "avx512f" ) ))
+static void springPassAVX512( const springPassArgs< float, accumulator >& a ) {
+  alignas( 64 ) float sx[ 16 ], sy[ 16 ], sz[ 16 ];
+  const __m512 half = _mm512_set1_ps( 0.5f ), threeHalves = _mm512_set1_ps( 1.5f ), one = _mm512_set1_ps( 1.0f );
+  const lawParameters spring = a.spring, shock = a.shock;
+  int e = a.firstEdge;
+  for ( ; e + 16 <= a.lastEdge; e += 16 ) {
+    const __m512i i1 = _mm512_loadu_si512( a.n1 + e );
+    const __m512i i2 = _mm512_loadu_si512( a.n2 + e );
+    const __m512 dx = _mm512_sub_ps( gather16( a.px, i1 ), gather16( a.px, i2 ) );
+    const __m512 dy = _mm512_sub_ps( gather16( a.py, i1 ), gather16( a.py, i2 ) );
+    const __m512 dz = _mm512_sub_ps( gather16( a.pz, i1 ), gather16( a.pz, i2 ) );
+
+    const __m512 lengthSquared = _mm512_fmadd_ps( dz, dz, _mm512_fmadd_ps( dy, dy, _mm512_mul_ps( dx, dx ) ) );
+    __m512 inverseLength = rsqrt16( lengthSquared );
+    inverseLength = _mm512_mul_ps( inverseLength, _mm512_fnmadd_ps( _mm512_mul_ps( half, lengthSquared ),
+      _mm512_mul_ps( inverseLength, inverseLength ), threeHalves ) );
+    const __m512 length = _mm512_mul_ps( lengthSquared, inverseLength );
+
+    const __m512 stretch = _mm512_sub_ps( _mm512_mul_ps( length, _mm512_loadu_ps( a.inverseBaseLength + e ) ), one );
+    __m512 tension = law::force( stretch, spring );
+    if constexpr ( damper::active ) {
+      const __m512 wx = _mm512_sub_ps( gather16( a.vx, i1 ), gather16( a.vx, i2 ) );
+      const __m512 wy = _mm512_sub_ps( gather16( a.vy, i1 ), gather16( a.vy, i2 ) );
+      const __m512 wz = _mm512_sub_ps( gather16( a.vz, i1 ), gather16( a.vz, i2 ) );
+      const __m512 rate = _mm512_mul_ps( _mm512_fmadd_ps( dz, wz, _mm512_fmadd_ps( dy, wy, _mm512_mul_ps( dx, wx ) ) ), inverseLength );
+      tension = _mm512_add_ps( tension, damper::force( rate, shock ) );
+    }
+    const __m512 scale = _mm512_mul_ps( _mm512_sub_ps( _mm512_setzero_ps(), tension ), inverseLength );
+    _mm512_store_ps( sx, _mm512_mul_ps( scale, dx ) );
+    _mm512_store_ps( sy, _mm512_mul_ps( scale, dy ) );
+    _mm512_store_ps( sz, _mm512_mul_ps( scale, dz ) );
+    for ( int l = 0; l < 16; l++ )
+      scatterSpringForce< float, accumulator >( a, e + l, sx[ l ], sy[ l ], sz[ l ] );
+  }
+  springPassScalar< law, damper >( a, e );
+}
+#endif
+
+kernelISA bestSpringKernel() {
+#if defined( __x86_64__ ) || defined( __i386__ )
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx512f" ) ) return AVX512;
+  if ( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) ) return AVX2;
+  if ( __builtin_cpu_supports( "sse4.2" ) ) return SSE42;
+#endif
+  return SCALAR;
+}
+
+static kernelISA activeKernel = bestSpringKernel();
+
+kernelISA currentSpringKernel() {
+  return activeKernel;
+}
+
+void setSpringKernel( kernelISA isa ) {
+  activeKernel = std::min( isa, bestSpringKernel() );
+}
+
+const char* kernelName( kernelISA isa ) {
+  switch ( isa ) {
+    case SCALAR: return "scalar";
+    case SSE42:  return "SSE4.2";
+    case AVX2:   return "AVX2";
+    case AVX512: return "AVX-512";
+  }
+  return "unknown";
+}
+
+const char* precisionName( precisionMode precision ) {
+  switch ( precision ) {
+    case SINGLE_PRECISION: return "float";
+    case MIXED_PRECISION:  return "mixed ( float state, double accumulation )";
+    case DOUBLE_PRECISION: return "double";
+  }
+  return "unknown";
+}
+
+// one batch through the active kernel, instantiated for the batch's laws
+template < typename law, typename damper, typename storage, typename accumulator >
+static void springPass( const springPassArgs< storage, accumulator >& a ) {
+#if defined( __x86_64__ ) || defined( __i386__ )
+  // the vector kernels are float only
+  if constexpr ( std::is_same< storage, float >::value ) {
+    switch ( activeKernel ) {
+      case AVX512: springPassAVX512< law, damper >( a ); return;
+      case AVX2:   springPassAVX2< law, damper >( a );   return;
+      case SSE42:  springPassSSE42< law, damper >( a );  return;
+      default: break;
+    }
+  }
+#endif
+  springPassScalar< law, damper >( a, a.firstEdge );
+}
+
+template < typename storage, typename accumulator >
+void accumulateSpringForces( const springTopology& topology, const springConstants& constants,
+  const nodeState< storage >& current, forceAccumulator< accumulator >& forces,
+  forceAccumulator< accumulator >& crossForces, int part ) {
+
+  springPassArgs< storage, accumulator > a;
+  a.n1 = topology.node1.data(); a.n2 = topology.node2.data();
+  a.baseLength = topology.baseLength.data(); a.inverseBaseLength = topology.inverseBaseLength.data();
+  a.px = current.px.data(); a.py = current.py.data(); a.pz = current.pz.data();
+  a.vx = current.vx.data(); a.vy = current.vy.data(); a.vz = current.vz.data();
+  a.fx = forces.fx.data(); a.fy = forces.fy.data(); a.fz = forces.fz.data();
+  a.cfx = crossForces.fx.data(); a.cfy = crossForces.fy.data(); a.cfz = crossForces.fz.data();
+  a.firstCross = topology.partCrossStart[ part ];
+  a.firstMoving = topology.partNodeStart[ 0 ];
+
+  for ( int b = topology.partBatchStart[ part ]; b < topology.partBatchStart[ part + 1 ]; b++ ) {
+    const int m = topology.batchMaterial[ b ];
+    a.firstEdge = topology.batchStart[ b ];
+    a.lastEdge = topology.batchStart[ b + 1 ];
+    a.spring = constants.springLaw( m );
+    a.shock = constants.shockLaw( m );
+    a.d = constants.d[ m ];
+    withForceLaw( constants.law[ m ], [&]( auto law ) {
+      withDamperLaw( constants.damper[ m ], [&]( auto damper ) {
+        springPass< decltype( law ), decltype( damper ) >( a );
+      } );
+    } );
+  }
+}
+
+template < typename storage, typename accumulator >
+void gatherHaloForces( const springTopology& topology, const springConstants& constants,
+  const nodeState< storage >& current, forceAccumulator< accumulator >& forces,
+  const forceAccumulator< accumulator >& crossForces, int part ) {
+
+  for ( int h = topology.haloStart[ part ]; h < topology.haloStart[ part + 1 ]; h++ ) {
+    const int e = topology.haloEdge[ h ];
+    const int b = topology.node2[ e ];
+    const accumulator d = constants.d[ topology.material[ e ] ];
+    forces.fx[ b ] -= crossForces.fx[ e ] + d * current.vx[ b ];
+    forces.fy[ b ] -= crossForces.fy[ e ] + d * current.vy[ b ];
+    forces.fz[ b ] -= crossForces.fz[ e ] + d * current.vz[ b ];
+  }
+}
+
+// one component of one node through the rule - next is passed in as well as out, since
+// position verlet finds the older position there
+template < typename rule, typename storage, typename accumulator >
+static inline void integrateAxis( const alignedArray< storage >& x, const alignedArray< storage >& v,
+  alignedArray< storage >& xNext, alignedArray< storage >& vNext, int n, accumulator a, accumulator gamma, accumulator h, accumulator hPrevious ) {
+  accumulator xOut = xNext[ n ], vOut = vNext[ n ];
+  rule::apply( accumulator( x[ n ] ), accumulator( v[ n ] ), a, gamma, xOut, vOut, h, hPrevious );
+  xNext[ n ] = xOut;
+  vNext[ n ] = vOut;
+}
+
+template < integratorType integrator, typename storage, typename accumulator >
+void integrateNodes( forceAccumulator< accumulator >& forces, const alignedArray< accumulator >& damping,
+  const alignedArray< accumulator >& inverseMass, const nodeState< storage >& current, nodeState< storage >& next,
+  float timeStep, float previousTimeStep, float gravity, int firstNode, int lastNode ) {
+
+  using rule = integrationRule< integrator >;
+  const accumulator h = timeStep, hPrevious = previousTimeStep;
+  for ( int n = firstNode; n < lastNode; n++ ) {
+    // gravity is applied as an acceleration, mass only enters through the inverse
+    const accumulator ax = forces.fx[ n ] * inverseMass[ n ];
+    const accumulator ay = forces.fy[ n ] * inverseMass[ n ] - gravity;
+    const accumulator az = forces.fz[ n ] * inverseMass[ n ];
+    const accumulator gamma = damping[ n ] * inverseMass[ n ];
+    forces.fx[ n ] = forces.fy[ n ] = forces.fz[ n ] = 0.0f;
+
+    integrateAxis< rule >( current.px, current.vx, next.px, next.vx, n, ax, gamma, h, hPrevious );
+    integrateAxis< rule >( current.py, current.vy, next.py, next.vy, n, ay, gamma, h, hPrevious );
+    integrateAxis< rule >( current.pz, current.vz, next.pz, next.vz, n, az, gamma, h, hPrevious );
+  }
+}
+
+template < typename storage, typename accumulator >
+void integrateNodes( integratorType integrator, forceAccumulator< accumulator >& forces,
+  const alignedArray< accumulator >& damping, const alignedArray< accumulator >& inverseMass,
+  const nodeState< storage >& current, nodeState< storage >& next,
+  float timeStep, float previousTimeStep, float gravity, int firstNode, int lastNode ) {
+
+  switch ( integrator ) {
+    case POSITION_VERLET:
+      integrateNodes< POSITION_VERLET >( forces, damping, inverseMass, current, next, timeStep, previousTimeStep, gravity, firstNode, lastNode );
+      break;
+    case VELOCITY_VERLET:
+      integrateNodes< VELOCITY_VERLET >( forces, damping, inverseMass, current, next, timeStep, previousTimeStep, gravity, firstNode, lastNode );
+      break;
+    default:
+      integrateNodes< SEMI_IMPLICIT_EULER >( forces, damping, inverseMass, current, next, timeStep, previousTimeStep, gravity, firstNode, lastNode );
+      break;
+  }
+}
+
+template < typename scalar >
+void sumNodeDamping( const springTopology& topology, const springConstants& constants, alignedArray< scalar >& damping ) {
+  for ( int n = 0; n < topology.numNodes; n++ ) {
+    scalar sum = 0.0f;
+    for ( int i = topology.rowStart[ n ]; i < topology.rowStart[ n + 1 ]; i++ )
+      sum += constants.d[ topology.material[ topology.incidentEdge[ i ] ] ];
+    damping[ n ] = sum;
+  }
+}
+
+template < typename scalar >
+void clearForces( forceAccumulator< scalar >& forces, int firstNode, int lastNode ) {
+  for ( int n = firstNode; n < lastNode; n++ )
+    forces.fx[ n ] = forces.fy[ n ] = forces.fz[ n ] = 0.0f;
+}
+
+// every kernel for every precisionPolicy - storage, accumulator
+#define INSTANTIATE_KERNELS( storage, accumulator ) \
+  template void accumulateSpringForces( const springTopology&, const springConstants&, const nodeState< storage >&, \
+    forceAccumulator< accumulator >&, forceAccumulator< accumulator >&, int ); \
+  template void gatherHaloForces( const springTopology&, const springConstants&, const nodeState< storage >&, \
+    forceAccumulator< accumulator >&, const forceAccumulator< accumulator >&, int ); \
+  template void integrateNodes< SEMI_IMPLICIT_EULER >( forceAccumulator< accumulator >&, const alignedArray< accumulator >&, \
+    const alignedArray< accumulator >&, const nodeState< storage >&, nodeState< storage >&, float, float, float, int, int ); \
+  template void integrateNodes< POSITION_VERLET >( forceAccumulator< accumulator >&, const alignedArray< accumulator >&, \
+    const alignedArray< accumulator >&, const nodeState< storage >&, nodeState< storage >&, float, float, float, int, int ); \
+  template void integrateNodes< VELOCITY_VERLET >( forceAccumulator< accumulator >&, const alignedArray< accumulator >&, \
+    const alignedArray< accumulator >&, const nodeState< storage >&, nodeState< storage >&, float, float, float, int, int ); \
+  template void integrateNodes( integratorType, forceAccumulator< accumulator >&, const alignedArray< accumulator >&, \
+    const alignedArray< accumulator >&, const nodeState< storage >&, nodeState< storage >&, float, float, float, int, int );
+
+INSTANTIATE_KERNELS( float, float )
+INSTANTIATE_KERNELS( float, double )
+INSTANTIATE_KERNELS( double, double )
+#undef INSTANTIATE_KERNELS
+
+template void sumNodeDamping( const springTopology&, const springConstants&, alignedArray< float >& );
+template void sumNodeDamping( const springTopology&, const springConstants&, alignedArray< double >& );
+template void clearForces( forceAccumulator< float >&, int, int );
+template void clearForces( forceAccumulator< double >&, int, int );
@@ -0,0 +1,154 @@
+#ifndef SOFTBODY_KERNELS
+#define SOFTBODY_KERNELS
+
+#include "force_laws.h"
+#include "softbody_state.h"
+#include "softbody_topology.h"
+
+#include <vector>
+
+// force scratch, one entry per node ( or per edge, for the parked cross edge forces ). parts
+// own contiguous node ranges, so each part writes its own slice and no two threads collide
+template < typename scalar >
+struct forceAccumulator {
+	alignedArray< scalar > fx, fy, fz;
+
+	void resize( size_t n ) { fx.resize( n ); fy.resize( n ); fz.resize( n ); }
+};
+
+// the material table as the kernels see it, indexed by material - kept in float like the rest
+// lengths, the kernels widen them to the accumulator type as they read them. rebuilt only when
+// the table is edited, not per tick
+struct springConstants {
+	std::vector< float > d;               // damping factor, drag on each endpoint's own velocity
+	std::vector< int > law;               // forceLaw of the spring
+	std::vector< int > damper;            // damperLaw of the shock along it
+	std::vector< lawParameters > spring;  // tension against stretch, spring[ m ].k is the slope at rest
+	std::vector< lawParameters > shock;   // force against extension speed
+	std::vector< float > table;           // the samples of every tabulated curve, end to end
+
+	void resize( size_t n ) { d.resize( n ); law.resize( n ); damper.resize( n ); spring.resize( n ); shock.resize( n ); }
+	size_t size() const { return d.size(); }
+
+	// the curves of material m, with their samples pointed into table
+	lawParameters springLaw( int m ) const { lawParameters p = spring[ m ]; p.samples = table.data() + p.tableStart; return p; }
+	lawParameters shockLaw( int m ) const { lawParameters p = shock[ m ]; p.samples = table.data() + p.tableStart; return p; }
+};
+
+// edge centric force pass over the edges of one part, a batch at a time - each spring is evaluated
+// once. interior edges add +F / -F to both endpoints, cross edges add +F to node1 and park F in
+// crossForces. runs the kernel picked by setSpringKernel, by default the widest the cpu supports,
+// with the batch's constants in registers and instantiated for its force and damper laws. the kernels
+// below, like this one, are instantiated for each precisionPolicy - storage is the state's
+// scalar, accumulator the forces'. only float storage has vector kernels, the rest run scalar
+template < typename storage, typename accumulator >
+void accumulateSpringForces( const springTopology& topology, const springConstants& constants,
+	const nodeState< storage >& current, forceAccumulator< accumulator >& forces,
+	forceAccumulator< accumulator >& crossForces, int part );
+
+// instruction set for the spring pass - the vector kernels gather positions for 4 / 8 / 16
+// springs at a time and use one rsqrt with a newton step in place of the sqrt and divide
+enum kernelISA {
+	SCALAR,                               // plain C++, the reference the others are checked against
+	SSE42,                                // 4 wide
+	AVX2,                                 // 8 wide, hardware gathers, FMA
+	AVX512                                // 16 wide
+};
+
+kernelISA bestSpringKernel();           // widest supported by this cpu, from cpuid
+kernelISA currentSpringKernel();
+void setSpringKernel( kernelISA isa );  // clamped to what the cpu supports
+const char* kernelName( kernelISA isa );
+const char* precisionName( precisionMode precision );
+
+// second pass for one part, after every part has finished the first - pick up the parked
+// forces of the cross edges landing on this part's nodes
+template < typename storage, typename accumulator >
+void gatherHaloForces( const springTopology& topology, const springConstants& constants,
+	const nodeState< storage >& current, forceAccumulator< accumulator >& forces,
+	const forceAccumulator< accumulator >& crossForces, int part );
+
+// how integrateNodes turns this tick's forces into the next state
+enum integratorType {
+	SEMI_IMPLICIT_EULER,                  // velocity from the acceleration, then position from the new velocity
+	POSITION_VERLET,                      // position from the last two positions, velocity by finite difference
+	VELOCITY_VERLET                       // kick - drift - kick, damping taken at the synchronized velocity
+};
+
+// the per axis update rule for each integrator - x, v are the current state, a this tick's
+// acceleration ( damping included ), gamma the node's damping over its mass, and xNext / vNext
+// the outputs in the next buffer, all for one component of one node, in the accumulator type.
+// h is this tick, hPrevious the one that led to x - only position verlet needs it.
+// scalar may also be a vector of lanes, which is how vehicle_pack.cc steps its vehicles - so
+// the inputs are taken by reference, a wide vector by value changes the calling convention
+template < integratorType > struct integrationRule;
+
+template <> struct integrationRule< SEMI_IMPLICIT_EULER > {
+	template < typename scalar >
+	static inline void apply( const scalar& x, const scalar& v, const scalar& a, const scalar&, scalar& xNext, scalar& vNext,
+		const scalar& h, const scalar& ) {
+		// new velocity from the old, then position from the new velocity
+		vNext = v + a * h;
+		xNext = x + vNext * h;
+	}
+};
+
+template <> struct integrationRule< POSITION_VERLET > {
+	template < typename scalar >
+	static inline void apply( const scalar& x, const scalar&, const scalar& a, const scalar&, scalar& xNext, scalar& vNext,
+		const scalar& h, const scalar& hPrevious ) {
+		// xNext still holds the position from the tick before this one, hPrevious back. the last
+		// displacement is scaled to this tick, x + ( x - previous ) h / hPrevious, and the
+		// acceleration taken over the mean of the two - written as the fixed tick's update plus a
+		// term that is zero when they are equal, so a fixed tick rounds exactly as before
+		const scalar previous = xNext;
+		xNext = 2.0f * x - previous + ( x - previous ) * ( h / hPrevious - 1.0f ) + a * h * ( 0.5f * ( hPrevious + h ) );
+		vNext = ( xNext - x ) / h;  // only feeds the damping, and the renderer's interpolation
+	}
+};
+
+template <> struct integrationRule< VELOCITY_VERLET > {
+	template < typename scalar >
+	static inline void apply( const scalar& x, const scalar& v, const scalar& a, const scalar& gamma, scalar& xNext, scalar& vNext,
+		const scalar& h, const scalar& ) {
+		// v is the half step velocity the last tick drifted with, which is what the spring pass
+		// damped. close that step with the damping at the synchronized velocity instead -
+		// trapezoidal, so the damping alone can't go unstable whatever the step
+		const scalar undamped = a + gamma * v;
+		const scalar synchronized = ( v + 0.5f * h * undamped ) / ( 1.0f + 0.5f * h * gamma );
+
+		// then open the next step from it, and drift
+		vNext = synchronized + 0.5f * h * ( undamped - gamma * synchronized );
+		xNext = x + vNext * h;
+	}
+};
+
+// integrate nodes [ firstNode, lastNode ) from current into next under the accumulated forces,
+// zeroing those accumulator entries for the next tick. each integrator is its own instantiation,
+// so the choice is made once per call and not per node. position verlet reads the position
+// before current from next, which is where the ping-pong buffers leave it, and previousTimeStep
+// the tick that led from it to current. damping is the per
+// node sum of the incident edges' damping factors, from sumNodeDamping. the update is done in
+// the accumulator type and rounded to storage once, when it is written to next
+template < integratorType integrator, typename storage, typename accumulator >
+void integrateNodes( forceAccumulator< accumulator >& forces, const alignedArray< accumulator >& damping,
+	const alignedArray< accumulator >& inverseMass, const nodeState< storage >& current, nodeState< storage >& next,
+	float timeStep, float previousTimeStep, float gravity, int firstNode, int lastNode );
+
+// picks the instantiation
+template < typename storage, typename accumulator >
+void integrateNodes( integratorType integrator, forceAccumulator< accumulator >& forces,
+	const alignedArray< accumulator >& damping, const alignedArray< accumulator >& inverseMass,
+	const nodeState< storage >& current, nodeState< storage >& next,
+	float timeStep, float previousTimeStep, float gravity, int firstNode, int lastNode );
+
+// the damping the spring pass applies to each node, - damping[ n ] * v[ n ] in total
+template < typename scalar >
+void sumNodeDamping( const springTopology& topology, const springConstants& constants, alignedArray< scalar >& damping );
+
+// zero accumulator entries that are never integrated ( anchored nodes ) - the spring pass leaves
+// them alone, this keeps them zero whatever else wrote them
+template < typename scalar >
+void clearForces( forceAccumulator< scalar >& forces, int firstNode, int lastNode );
+
+#endif
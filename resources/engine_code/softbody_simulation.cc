@@ -0,0 +1,578 @@
+#include "softbody_simulation.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <type_traits>
+
+void vehicleGraph::loadFrame( const std::string& path ) {
+  // clear out data, so this can also be used as a reset
+  nodes.clear();
+  edges.clear();
+  faces.clear();
+
+  // assumes obj file without the annotations -
+    // specifically carFrameWPanels.obj which has a few lines already removed
+
+  std::ifstream infile( path );
+  std::vector< glm::vec3 > normals;
+
+  // add the anchored points ( wheel control points )
+  int offset = 3; // for 4 anchored wheel points, this is 3 - to eat up the off-by-one from the one-indexed OBJ format
+
+  // add anchored wheel control points here
+  addNode( glm::vec3( -0.6125f, -0.38f,  1.95f ),  true ); // front left
+  addNode( glm::vec3(  0.6125f, -0.38f,  1.95f ),  true ); // front right
+  addNode( glm::vec3( -0.7f,    -0.38f, -0.86f ),  true ); // back left
+  addNode( glm::vec3(  0.7f,    -0.38f, -0.86f ),  true ); // back right
+
+  while ( infile.peek() != EOF ) {
+    std::string read;
+    infile >> read;
+
+    if ( read == "v" ) {
+      float x, y, z;
+      infile >> x >> y >> z;
+      // add an unanchored node, it takes the configured chassis node mass
+      addNode( glm::vec3( x, y, z ), false );
+    } else if ( read == "vn" ) {
+      float x, y, z;
+      infile >> x >> y >> z;
+      normals.push_back( glm::vec3( x, y, z ) );  // three floats determine the normal vector
+    } else if ( read == "f" ) {
+      char throwaway;
+      int xIndex, yIndex, zIndex, nIndex;
+      infile >> xIndex >> throwaway >> throwaway >> nIndex
+             >> yIndex >> throwaway >> throwaway >> nIndex
+             >> zIndex >> throwaway >> throwaway >> nIndex;
+      // this needs the three node indices, as well as the normal from the normals list
+      addFace( xIndex + offset, yIndex + offset, zIndex + offset, normals[ nIndex - 1 ] );
+      // add the three edges of the triangle, since the obj export skips edges which are included in a face
+      addEdge( xIndex + offset, yIndex + offset, chassisMaterial );
+      addEdge( zIndex + offset, yIndex + offset, chassisMaterial );
+      addEdge( zIndex + offset, xIndex + offset, chassisMaterial );
+    } else if ( read == "l" ) {
+      int index1, index2;
+      infile >> index1 >> index2;
+      addEdge( index1 + offset, index2 + offset, chassisMaterial ); // two node indices ( offset to match the list ), chassis material
+    }
+  }
+// suspension edge
+  // front left
+  addEdge( 0, 25, suspensionMaterial );
+  addEdge( 0, 35, suspensionMaterial );
+  addEdge( 0, 37, suspensionMaterial );
+  addEdge( 0, 39, suspensionMaterial );
+  addEdge( 0, 41, suspensionMaterial );
+  addEdge( 0, 42, suspensionMaterial );
+  addEdge( 0, 43, suspensionMaterial );
+  addEdge( 0, 44, suspensionMaterial );
+  addEdge( 0, 45, suspensionMaterial );
+  // mirrored inboard suspension edges
+  addEdge( 0, 13, inboardSuspensionMaterial );
+  addEdge( 0, 15, inboardSuspensionMaterial );
+  addEdge( 0, 17, inboardSuspensionMaterial );
+  addEdge( 0, 19, inboardSuspensionMaterial );
+  addEdge( 0, 20, inboardSuspensionMaterial );
+  addEdge( 0, 21, inboardSuspensionMaterial );
+  addEdge( 0, 22, inboardSuspensionMaterial );
+  addEdge( 0, 23, inboardSuspensionMaterial );
+  addEdge( 0, 24, inboardSuspensionMaterial );
+
+  // front right
+  addEdge( 1, 13, suspensionMaterial );
+  addEdge( 1, 15, suspensionMaterial );
+  addEdge( 1, 17, suspensionMaterial );
+  addEdge( 1, 19, suspensionMaterial );
+  addEdge( 1, 20, suspensionMaterial );
+  addEdge( 1, 21, suspensionMaterial );
+  addEdge( 1, 22, suspensionMaterial );
+  addEdge( 1, 23, suspensionMaterial );
+  addEdge( 1, 24, suspensionMaterial );
+  // mirrored inboard suspension edges
+  addEdge( 1, 35, inboardSuspensionMaterial );
+  addEdge( 1, 25, inboardSuspensionMaterial );
+  addEdge( 1, 37, inboardSuspensionMaterial );
+  addEdge( 1, 39, inboardSuspensionMaterial );
+  addEdge( 1, 41, inboardSuspensionMaterial );
+  addEdge( 1, 42, inboardSuspensionMaterial );
+  addEdge( 1, 43, inboardSuspensionMaterial );
+  addEdge( 1, 44, inboardSuspensionMaterial );
+  addEdge( 1, 45, inboardSuspensionMaterial );
+
+  // back left
+  addEdge( 2, 26, suspensionMaterial );
+  addEdge( 2, 28, suspensionMaterial );
+  addEdge( 2, 29, suspensionMaterial );
+  addEdge( 2, 30, suspensionMaterial );
+  addEdge( 2, 31, suspensionMaterial );
+  addEdge( 2, 32, suspensionMaterial );
+  addEdge( 2, 36, suspensionMaterial );
+  addEdge( 2, 38, suspensionMaterial );
+  // mirrored inboard suspension edges
+  addEdge( 2, 4, inboardSuspensionMaterial );
+  addEdge( 2, 6, inboardSuspensionMaterial );
+  addEdge( 2, 7, inboardSuspensionMaterial );
+  addEdge( 2, 8, inboardSuspensionMaterial );
+  addEdge( 2, 9, inboardSuspensionMaterial );
+  addEdge( 2, 10, inboardSuspensionMaterial );
+  addEdge( 2, 14, inboardSuspensionMaterial );
+  addEdge( 2, 16, inboardSuspensionMaterial );
+
+  // back right
+  addEdge( 3, 4, suspensionMaterial );
+  addEdge( 3, 6, suspensionMaterial );
+  addEdge( 3, 7, suspensionMaterial );
+  addEdge( 3, 8, suspensionMaterial );
+  addEdge( 3, 9, suspensionMaterial );
+  addEdge( 3, 10, suspensionMaterial );
+  addEdge( 3, 14, suspensionMaterial );
+  addEdge( 3, 16, suspensionMaterial );
+  // mirrored inboard suspension edges
+  addEdge( 3, 26, inboardSuspensionMaterial );
+  addEdge( 3, 28, inboardSuspensionMaterial );
+  addEdge( 3, 29, inboardSuspensionMaterial );
+  addEdge( 3, 30, inboardSuspensionMaterial );
+  addEdge( 3, 31, inboardSuspensionMaterial );
+  addEdge( 3, 32, inboardSuspensionMaterial );
+  addEdge( 3, 36, inboardSuspensionMaterial );
+  addEdge( 3, 38, inboardSuspensionMaterial );
+}
+
+void vehicleGraph::finalize( int numParts ) {
+  // anchored nodes go to the front ( stable, so the wheel points keep indices 0-3 ) - the
+  // solver then covers the free nodes as one contiguous range, with no per node branch
+  std::vector< int > order( nodes.size() );
+  std::iota( order.begin(), order.end(), 0 );
+  std::stable_partition( order.begin(), order.end(), [&]( int i ) { return nodes[ i ].anchored; } );
+  ApplyNodeOrder( order );
+  numAnchored = std::count_if( nodes.begin(), nodes.end(), []( const node& n ) { return n.anchored; } );
+
+  // split the free nodes into compact blocks, and renumber so each block is a contiguous index
+  // range - the solver and the renderer both see this order from here on
+  topology.build( nodes.size(), edges );
+  graphPartition partition = partitionGraph( topology, numAnchored, numParts );
+  ApplyNodeOrder( partition.order );
+
+  // each spring stored once, plus adjacency, grouped by the part that evaluates it
+  topology.build( nodes.size(), edges );
+  topology.assignParts( partition.partStart );
+}
+
+void vehicleGraph::ApplyNodeOrder( const std::vector< int >& order ) {
+  std::vector< int > remap( nodes.size() );
+  for ( size_t i = 0; i < order.size(); i++ )
+    remap[ order[ i ] ] = i;
+
+  std::vector< node > reordered;
+  reordered.reserve( nodes.size() );
+  for ( int i : order )
+    reordered.push_back( std::move( nodes[ i ] ) );
+  nodes = std::move( reordered );
+
+  for ( auto& e : edges )
+    e.node1 = remap[ e.node1 ], e.node2 = remap[ e.node2 ];
+  for ( auto& f : faces )
+    f.node1 = remap[ f.node1 ], f.node2 = remap[ f.node2 ], f.node3 = remap[ f.node3 ];
+}
+
+void vehicleGraph::addNode( glm::vec3 position, bool anchored ) {
+  node n;
+  n.anchored = anchored;
+  n.restPosition = position;
+  nodes.push_back( n );
+}
+
+void vehicleGraph::addEdge( int nodeIndex1, int nodeIndex2, int material ) {
+  edge e;
+  e.node1 = nodeIndex1;
+  e.node2 = nodeIndex2;
+  e.material = material;
+  e.baseLength = glm::distance( nodes[ e.node1 ].restPosition, nodes[ e.node2 ].restPosition );
+  edges.push_back( e ); // adjacency is built from this list once loading finishes
+}
+
+// parameters tbd - probably just the
+void vehicleGraph::addFace( int nodeIndex1, int nodeIndex2, int nodeIndex3, glm::vec3 normal ) {
+  face f;
+  f.node1 = nodeIndex1;
+  f.node2 = nodeIndex2;
+  f.node3 = nodeIndex3;
+
+  // TODO: add normals
+
+  faces.push_back( f );
+}
+
+std::shared_ptr< const vehicleGraph > loadVehicleGraph( const std::string& path, const simParameterPack& parameters, int numWorkers ) {
+  auto graph = std::make_shared< vehicleGraph >();
+  graph->loadFrame( path );
+
+  // split the free nodes into one compact block per worker. in deterministic mode the block
+  // count is fixed instead, see deterministicPartCount
+  const int numFree = graph->nodes.size() - std::count_if( graph->nodes.begin(), graph->nodes.end(), []( const node& n ) { return n.anchored; } );
+  const int numParts = parameters.deterministic ? std::max( std::min( deterministicPartCount, numFree ), 1 ) : std::max( numWorkers, 1 );
+  setSpringKernel( parameters.deterministic ? SCALAR : bestSpringKernel() );
+  graph->finalize( numParts );
+  return graph;
+}
+
+softbodySimulation::softbodySimulation() {
+  roadGenerator = makeRoadNoise( BUILTIN_NOISE, roadOctaves );
+  generatorBackend = BUILTIN_NOISE;
+}
+
+void softbodySimulation::Load( std::shared_ptr< const vehicleGraph > graph ) {
+  sharedGraph = std::move( graph );
+
+  // the precision is fixed from here to the next load, free whatever another one held
+  activePrecision = precisionMode( simParameters.precision );
+  if ( activePrecision != SINGLE_PRECISION ) singleBuffers = simulationBuffers< singlePrecision >();
+  if ( activePrecision != MIXED_PRECISION )  mixedBuffers  = simulationBuffers< mixedPrecision >();
+  if ( activePrecision != DOUBLE_PRECISION ) doubleBuffers = simulationBuffers< doublePrecision >();
+  ResetSimulationState();
+}
+
+void softbodySimulation::ResetSimulationState() {
+  const vehicleGraph& g = *sharedGraph;
+  WithActiveBuffers( [&]( auto& b ) {
+    // solver scratch, and the implicit solver's warm start ( resize zeroes the arrays )
+    b.forces.resize( g.nodes.size() );
+    b.crossForces.resize( g.topology.numEdges );
+    b.nodeDamping.resize( g.nodes.size() );
+    b.implicit.resize( g.topology );
+    b.xpbd.resize( g.topology );
+    b.multirate.resize( g.topology );
+    b.adaptive.resize( g.topology );
+
+    // initial positions, zero velocity
+    b.state.resize( g.nodes.size() );
+    auto& initial = b.state.current();
+    for ( size_t i = 0; i < g.nodes.size(); i++ ) {
+      initial.px[ i ] = g.nodes[ i ].restPosition.x;
+      initial.py[ i ] = g.nodes[ i ].restPosition.y;
+      initial.pz[ i ] = g.nodes[ i ].restPosition.z;
+    }
+    b.state.next().copyRange( initial, 0, g.nodes.size() );
+    b.inverseMass.resize( g.nodes.size() );
+  } );
+  tickCount = 0;
+  simulatedTime = 0.0;
+  lastTimeStep = 0.0f;
+  RefreshInverseMass();
+  RefreshMaterialConstants();
+}
+
+void softbodySimulation::RefreshMaterialConstants() {
+  const springTopology& topology = sharedGraph->topology;
+
+  // the topology sizes its tables by the highest material an edge uses
+  const size_t count = std::max( simParameters.materials.size(), size_t( topology.numMaterials ) );
+  frameConstants.resize( count );
+  frameConstants.table.clear();
+  auto tabulate = [&]( const std::vector< glm::vec2 >& curve ) {
+    std::vector< float > x, y;
+    for ( const glm::vec2& point : curve )
+      x.push_back( point.x ), y.push_back( point.y );
+    return tabulateCurve( x.data(), y.data(), curve.size(), frameConstants.table );
+  };
+
+  for ( size_t m = 0; m < count; m++ ) {
+    const material row = m < simParameters.materials.size() ? simParameters.materials[ m ] : material{};
+    frameConstants.d[ m ]      = row.damping;
+    frameConstants.law[ m ]    = row.law;
+    frameConstants.damper[ m ] = row.damper;
+
+    lawParameters spring;
+    if ( row.law == TABULATED_SPRING ) {
+      spring = tabulate( row.springCurve );
+    } else {
+      spring.k        = row.k;
+      spring.k2       = row.k2;
+      spring.lowKnee  = row.lowKnee;
+      spring.highKnee = row.highKnee;
+    }
+    frameConstants.spring[ m ] = spring;
+
+    lawParameters shock;
+    if ( row.damper == TABULATED_DAMPER )
+      shock = tabulate( row.shockCurve );
+    else
+      shock.k = row.shockDamping;
+    frameConstants.shock[ m ] = shock;
+  }
+  WithActiveBuffers( [&]( auto& b ) {
+    sumNodeDamping( topology, frameConstants, b.nodeDamping );
+    b.multirate.invalidate();
+  } );
+}
+
+void softbodySimulation::RefreshInverseMass() {
+  const vehicleGraph& g = *sharedGraph;
+  WithActiveBuffers( [&]( auto& b ) {
+    using accumulator = typename std::decay_t< decltype( b ) >::accumulator;
+    for ( size_t i = 0; i < g.nodes.size(); i++ ) {
+      const accumulator mass = g.nodes[ i ].anchored ? simParameters.anchoredNodeMass : simParameters.chassisNodeMass;
+      b.inverseMass[ i ] = ( g.nodes[ i ].anchored || mass == 0 ) ? 0 : 1 / mass;
+    }
+    b.multirate.invalidate();
+  } );
+  inverseMassSource = simParameters.chassisNodeMass;
+}
+
+uint64_t softbodySimulation::StateChecksum() const {
+  return WithActiveBuffers( [&]( const auto& b ) { return b.state.current().checksum( 0, sharedGraph->nodes.size() ); } );
+}
+
+glm::vec3 softbodySimulation::nodePosition( int index, float blend ) const {
+  // the renderer is float whatever the simulation runs in
+  return WithActiveBuffers( [&]( const auto& b ) {
+    const auto& previous = b.state.previous();
+    const auto& current = b.state.current();
+    return glm::mix( glm::vec3( previous.px[ index ], previous.py[ index ], previous.pz[ index ] ),
+                     glm::vec3( current.px[ index ], current.py[ index ], current.pz[ index ] ), blend );
+  } );
+}
+
+float softbodySimulation::getGroundPoint( float x, float y ) const {
+  const float u = x * simParameters.roadScale;
+  const float v = y * simParameters.roadScale + noiseOffset;
+  const bool streamed = simParameters.roadSource == PROFILE_ROAD;
+  float noise;
+  if ( !( simParameters.cacheRoad || streamed ) || !roadCache.sample( u, v, noise ) )
+    noise = streamed ? 0.0f : roadGenerator->GenSingle2D( u, v, simParameters.roadSeed );
+  return noise * RoadAmplitude() - 0.4;
+}
+
+float softbodySimulation::RoadAmplitude() const {
+  return simParameters.roadSource == PROFILE_ROAD ? simParameters.roadScale : simParameters.noiseAmplitudeScale;
+}
+
+void softbodySimulation::getGroundPoints( int count, const float* x, const float* y, float* height,
+  float* slopeX, float* slopeY ) {
+  const float scale = simParameters.roadScale;
+  const float amplitude = RoadAmplitude();
+  const bool slopes = slopeX && slopeY;
+  const bool streamed = simParameters.roadSource == PROFILE_ROAD;
+
+  // the cache first, noting the misses
+  groundMisses.clear();
+  for ( int i = 0; i < count; i++ ) {
+    const float u = x[ i ] * scale;
+    const float v = y[ i ] * scale + noiseOffset;
+    float noise, du, dv;
+    if ( ( simParameters.cacheRoad || streamed ) && roadCache.sample( u, v, noise, slopes ? &du : nullptr, slopes ? &dv : nullptr ) ) {
+      height[ i ] = noise * amplitude - 0.4;
+      if ( slopes ) {
+        slopeX[ i ] = du * scale * amplitude;
+        slopeY[ i ] = dv * scale * amplitude;
+      }
+    } else {
+      groundMisses.push_back( i );
+    }
+  }
+  if ( groundMisses.empty() ) return;
+
+  // the spectral road only exists where it has been streamed, it is flat past the cache
+  if ( streamed ) {
+    for ( int i : groundMisses ) {
+      height[ i ] = -0.4f;
+      if ( slopes ) slopeX[ i ] = slopeY[ i ] = 0.0f;
+    }
+    return;
+  }
+
+  // then the rest in one batch, with the noise's own gradient when the slopes are wanted
+  const size_t misses = groundMisses.size();
+  groundU.resize( misses ); groundV.resize( misses ); groundNoise.resize( misses );
+  for ( size_t m = 0; m < misses; m++ ) {
+    groundU[ m ] = x[ groundMisses[ m ] ] * scale;
+    groundV[ m ] = y[ groundMisses[ m ] ] * scale + noiseOffset;
+  }
+  if ( slopes ) {
+    groundDu.resize( misses ); groundDv.resize( misses );
+    roadGenerator->GenPositionGradient2D( groundNoise.data(), groundDu.data(), groundDv.data(), misses,
+      groundU.data(), groundV.data(), simParameters.roadSeed );
+  } else {
+    roadGenerator->GenPositionArray2D( groundNoise.data(), misses, groundU.data(), groundV.data(), 0.0f, 0.0f, simParameters.roadSeed );
+  }
+  for ( size_t m = 0; m < misses; m++ ) {
+    const int i = groundMisses[ m ];
+    height[ i ] = groundNoise[ m ] * amplitude - 0.4;
+    if ( slopes ) {
+      slopeX[ i ] = groundDu[ m ] * scale * amplitude;
+      slopeY[ i ] = groundDv[ m ] * scale * amplitude;
+    }
+  }
+}
+
+void softbodySimulation::FitRoadWindow() {
+  // in noise space - the model's ground patch is two by three around the origin and the grid
+  // matches its spacing, the wheels sit well inside it
+  float window[ 4 ] = { -1.0f, 1.0f, -1.5f, 1.5f };
+
+  // with nothing drawing it, the rectangle over the anchored nodes and a few grid rows - they
+  // only ever move in y, so their rest positions are where the road is read
+  const int numAnchored = sharedGraph ? sharedGraph->numAnchored : 0;
+  if ( !roadDrawn && numAnchored > 0 ) {
+    constexpr float margin = 0.05f;
+    window[ 0 ] = window[ 2 ] = std::numeric_limits< float >::max();
+    window[ 1 ] = window[ 3 ] = std::numeric_limits< float >::lowest();
+    for ( int i = 0; i < numAnchored; i++ ) {
+      const glm::vec3& p = sharedGraph->nodes[ i ].restPosition;
+      window[ 0 ] = std::min( window[ 0 ], p.x * simParameters.roadScale );
+      window[ 1 ] = std::max( window[ 1 ], p.x * simParameters.roadScale );
+      window[ 2 ] = std::min( window[ 2 ], p.z * simParameters.roadScale );
+      window[ 3 ] = std::max( window[ 3 ], p.z * simParameters.roadScale );
+    }
+    window[ 0 ] -= margin; window[ 2 ] -= margin;
+    window[ 1 ] += margin; window[ 3 ] += margin;
+  }
+
+  if ( std::equal( window, window + 4, roadWindow ) ) return;
+  std::copy( window, window + 4, roadWindow );
+  roadCache.configure( 0.01f, window[ 0 ], window[ 1 ], window[ 2 ], window[ 3 ] );
+}
+
+void softbodySimulation::ScrollRoad() {
+  if ( simParameters.roadNoiseBackend != generatorBackend ) {
+    roadGenerator = makeRoadNoise( noiseBackend( simParameters.roadNoiseBackend ), roadOctaves );
+    generatorBackend = simParameters.roadNoiseBackend;
+  }
+  FitRoadWindow();
+
+  // kept whether or not the wheels read it, the model draws the ground from it
+  if ( simParameters.roadSource == PROFILE_ROAD ) {
+    // on the cache's grid, which is in noise space - a unit of it is 1 / roadScale meters
+    if ( !spectral ) spectral = std::make_unique< spectralRoad >();
+    spectral->configure( simParameters.roadClass, simParameters.roadSeed,
+      double( roadCache.gridSpacing() ) / simParameters.roadScale, roadCache.numColumns() );
+    roadCache.scroll( *spectral, noiseOffset );
+  } else {
+    roadCache.scroll( *roadGenerator, simParameters.roadSeed, noiseOffset );
+  }
+}
+
+float softbodySimulation::StableTimeStep() const {
+  return WithActiveBuffers( [&]( const auto& b ) { return b.adaptive.lastLimit; } );
+}
+
+std::vector< int > softbodySimulation::multirateLevelNodes() const {
+  return WithActiveBuffers( [&]( const auto& b ) { return b.multirate.levelNodes; } );
+}
+
+int softbodySimulation::multirateSpringEvaluations() const {
+  return WithActiveBuffers( [&]( const auto& b ) { return b.multirate.springEvaluations; } );
+}
+
+int softbodySimulation::lastCGIterations() const {
+  return WithActiveBuffers( [&]( const auto& b ) { return b.implicit.lastIterations; } );
+}
+
+float softbodySimulation::lastCGResidual() const {
+  return WithActiveBuffers( [&]( const auto& b ) { return b.implicit.lastResidual; } );
+}
+
+template < typename precision >
+void softbodySimulation::SingleThreadSoftbodyUpdate( simulationBuffers< precision >& b ) {
+  const springTopology& topology = sharedGraph->topology;
+  for ( int p = 0; p < topology.numParts; p++ )
+    accumulateSpringForces( topology, frameConstants, b.state.current(), b.forces, b.crossForces, p );
+  for ( int p = 0; p < topology.numParts; p++ ) {
+    gatherHaloForces( topology, frameConstants, b.state.current(), b.forces, b.crossForces, p );
+    integrateNodes( integratorType( simParameters.integrator ), b.forces, b.nodeDamping, b.inverseMass,
+      b.state.current(), b.state.next(), simParameters.timeScale, PreviousTimeStep(), simParameters.gravity,
+      topology.partNodeStart[ p ], topology.partNodeStart[ p + 1 ] );
+  }
+  clearForces( b.forces, 0, sharedGraph->numAnchored );
+}
+
+template < typename precision >
+void softbodySimulation::MultiThreadSoftbodyUpdate( threadPool& pool, simulationBuffers< precision >& b ) {
+  const springTopology& topology = sharedGraph->topology;
+
+  // each worker evaluates the springs of its parts, writing only to its own nodes, and
+  // parking the forces for neighboring parts
+  pool.dispatch( [&]( int worker ) {
+    int first, last;
+    pool.blockRange( worker, 0, topology.numParts, first, last );
+    for ( int p = first; p < last; p++ )
+      accumulateSpringForces( topology, frameConstants, b.state.current(), b.forces, b.crossForces, p );
+  } );
+
+  // then collects the parked forces for its halo, and integrates its nodes
+  pool.dispatch( [&]( int worker ) {
+    int first, last;
+    pool.blockRange( worker, 0, topology.numParts, first, last );
+    for ( int p = first; p < last; p++ ) {
+      gatherHaloForces( topology, frameConstants, b.state.current(), b.forces, b.crossForces, p );
+      integrateNodes( integratorType( simParameters.integrator ), b.forces, b.nodeDamping, b.inverseMass,
+        b.state.current(), b.state.next(), simParameters.timeScale, PreviousTimeStep(), simParameters.gravity,
+        topology.partNodeStart[ p ], topology.partNodeStart[ p + 1 ] );
+    }
+  } );
+  clearForces( b.forces, 0, sharedGraph->numAnchored );
+}
+
+void softbodySimulation::Substep( threadPool& pool, float noiseStep ) {
+  const springTopology& topology = sharedGraph->topology;
+  const int numAnchored = sharedGraph->numAnchored;
+
+  // mass slider moved since the last tick - the material constants are refreshed by the
+  // material sliders themselves, see RefreshMaterialConstants
+  if ( simParameters.chassisNodeMass != inverseMassSource )
+    RefreshInverseMass();
+
+  // offset the noise over time
+  noiseOffset += noiseStep;
+  ScrollRoad();
+
+  WithActiveBuffers( [&]( auto& b ) {
+    // sample terrain surface height at the wheel points - written into the current state,
+    // which is the one the tick reads from, so the free nodes see this tick's wheel height
+    PlaceWheels( b.state.current() );
+
+    switch ( simParameters.solver ) {
+      case IMPLICIT_EULER:
+        b.implicit.step( pool, topology, frameConstants, b.inverseMass, b.state.current(), b.state.next(), b.forces, b.crossForces,
+          simParameters.timeScale, simParameters.gravity, numAnchored, simParameters.cgMaxIterations, simParameters.cgTolerance, simParameters.cgPreconditioner );
+        break;
+      case XPBD:
+        b.xpbd.step( pool, topology, frameConstants, b.inverseMass, b.state.current(), b.state.next(),
+          simParameters.timeScale, simParameters.gravity, numAnchored, simParameters.xpbdSubsteps, simParameters.xpbdIterations, simParameters.xpbdColoring );
+        break;
+      case MULTIRATE:
+        b.multirate.step( pool, topology, frameConstants, b.inverseMass, b.nodeDamping, b.state.current(), b.state.next(),
+          simParameters.timeScale, simParameters.gravity, numAnchored, simParameters.multirateLevels, simParameters.multirateSafety );
+        break;
+      default:
+        MultiThreadSoftbodyUpdate( pool, b );
+        break;
+    }
+    b.state.next().copyRange( b.state.current(), 0, numAnchored ); // anchored nodes carry over
+    b.state.swap();                                                // new values become current, no copy
+    simulatedTime += simParameters.timeScale;
+    lastTimeStep = simParameters.timeScale;
+
+    // pick the next tick from the state this one produced - the multirate solver's kicks take the
+    // damping explicitly, like semi implicit euler, and its top level fits 2^( levels - 1 ) of them
+    if ( simParameters.adaptiveTimeStep ) {
+      int integrator = simParameters.integrator, substeps = 0;
+      if ( simParameters.solver == EXPLICIT_EULER ) {
+        substeps = 1;
+      } else if ( simParameters.solver == MULTIRATE ) {
+        integrator = SEMI_IMPLICIT_EULER;
+        substeps = 1 << ( std::min( std::max( simParameters.multirateLevels, 1 ), b.multirate.maxLevels ) - 1 );
+      }
+      simParameters.timeScale = b.adaptive.next( topology, frameConstants, b.inverseMass, b.nodeDamping, b.state.current(), numAnchored,
+        integrator, substeps, simParameters.gravity, simParameters.timeScale,
+        simParameters.maxTimeScale, simParameters.stabilitySafety, simParameters.energyTolerance );
+    }
+  } );
+
+  tickCount++;
+  if ( simParameters.logChecksums )
+    std::cout << "tick " << tickCount << " checksum " << std::hex << StateChecksum() << std::dec << "\n";
+}
@@ -0,0 +1,395 @@
+#ifndef SOFTBODY_SIMULATION
+#define SOFTBODY_SIMULATION
+
+// no windowing or GL in here - the model draws one of these, the ensemble steps many. glm is
+// configured the same way as in includes.h, so both see the same vector types
+#define GLM_FORCE_SWIZZLE
+#define GLM_SWIZZLE_XYZW
+#include "../glm/glm.hpp"
+
+#include "palette.h"
+#include "softbody_state.h"
+#include "softbody_topology.h"
+#include "softbody_kernels.h"
+#include "thread_pool.h"
+#include "graph_partition.h"
+#include "implicit_solver.h"
+#include "xpbd_solver.h"
+#include "multirate_solver.h"
+#include "timestep_control.h"
+#include "road_noise.h"
+#include "spectral_road.h"
+#include "heightfield_cache.h"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+struct face {
+	int node1, node2, node3;              // the three points making up the triangle
+	glm::vec3 normal;                     // surface normal for the triangle
+};
+
+struct node {
+	bool anchored;                        // anchored nodes are control points, the rest take simParameterPack::chassisNodeMass
+	glm::vec3 restPosition;               // position at load time, dynamic values live in the state buffers
+};
+
+// one row of the material table - edges refer to rows by index, and the kernels read the
+// table as springConstants, rebuilt by RefreshMaterialConstants when it is edited
+struct material {
+	std::string name;                     // shown in the UI
+	float k;                              // hooke's law spring constant, the slope at rest of the other laws
+	float damping;                        // damping factor
+	glm::vec4 color;                      // edge color, outside of the tension color mode
+
+	int law = LINEAR_SPRING;              // forceLaw, tension against stretch L / L0 - 1
+	float k2 = 0.0f;                      // slope past the knees ( piecewise ), stretch^3 coefficient ( cubic )
+	float lowKnee = -0.1f;                // piecewise: stretch where the bump stop starts
+	float highKnee = 0.1f;                // piecewise: stretch where the rebound stop starts
+	std::vector< glm::vec2 > springCurve; // tabulated: ( stretch, tension ) points, stretch ascending
+
+	int damper = NO_DAMPER;               // damperLaw, a shock along the spring on top of the drag
+	float shockDamping = 0.0f;            // linear: force per unit of extension speed
+	std::vector< glm::vec2 > shockCurve;  // tabulated: ( extension speed, force ) points, speed ascending
+};
+
+// rows of the default material table that the stock chassis is built from
+constexpr int chassisMaterial           = 0;
+constexpr int suspensionMaterial        = 1;
+constexpr int inboardSuspensionMaterial = 2;
+
+// how a tick advances the state
+enum solverType {
+	EXPLICIT_EULER,                       // spring forces, then one step of the chosen integratorType
+	IMPLICIT_EULER,                       // backward euler, a CG solve per tick ( implicit_solver.h )
+	XPBD,                                 // compliant distance constraints ( xpbd_solver.h )
+	MULTIRATE                             // semi-implicit euler, stiff regions substepped ( multirate_solver.h )
+};
+
+// what the road is made of
+enum roadSourceType {
+	NOISE_ROAD,                           // fractal noise ( road_noise.h ), scaled by noiseAmplitudeScale
+	PROFILE_ROAD                          // an ISO 8608 class profile in meters, streamed in tiles ( spectral_road.h )
+};
+
+// everything a tick reads and writes, at one precision - a simulation keeps one of these per
+// precisionPolicy and only the one it was loaded with is sized, see simParameterPack::precision
+template < typename precision >
+struct simulationBuffers {
+	using storage = typename precision::storage;
+	using accumulator = typename precision::accumulator;
+
+	stateBuffers< storage > state;        // anchored nodes occupy [ 0, numAnchored ), free nodes the rest
+	alignedArray< accumulator > inverseMass; // zero for anchored nodes
+
+	// the per node force scratch, and per edge slots for the forces crossing between parts
+	forceAccumulator< accumulator > forces;
+	forceAccumulator< accumulator > crossForces;
+	alignedArray< accumulator > nodeDamping; // summed damping factor of each node's edges, per tick
+
+	// alternatives to the explicit update
+	implicitSolver< precision > implicit;
+	xpbdSolver< precision > xpbd;
+	multirateSolver< precision > multirate;
+
+	// tick size for adaptiveTimeStep
+	timeStepController< precision > adaptive;
+};
+
+// deterministic mode splits the free nodes into this many parts whatever the worker count ( or
+// one per node, if there are fewer ), and uses the scalar spring kernel - the order of every
+// floating point sum then depends on the model alone, and a run is bit identical on any number
+// of workers. it gives up the vector kernels and adds cross edges, about 1.7x the tick cost on one
+// worker with the stock chassis. the same binary is assumed, since contraction into FMA changes bits
+constexpr int deterministicPartCount = 64;
+
+constexpr int roadOctaves = 2;           // fractal octaves of the road noise
+
+// consolidate simulation parameters
+struct simParameterPack {
+	bool  runSimulation       = true;     // toggle per frame update
+	float timeScale           = 0.003;    // amount of time that passes per sim tick
+	bool  adaptiveTimeStep    = false;    // set timeScale from the stability limit and energy drift, see timeStepController
+	float maxTimeScale        = 0.01;     // adaptive: the largest tick it will take
+	float stabilitySafety     = 0.9;      // adaptive: fraction of the estimated stability limit used, which errs low
+	float energyTolerance     = 0.25;     // adaptive: energy gained over a window, relative to the energy in motion, that halves the tick
+	bool  realTimeStepping    = true;     // run as many ticks as fit in the wall clock time since the last frame
+	int   substepsPerFrame    = 1;        // ticks per rendered frame, when not stepping in real time
+	int   maxSubstepsPerFrame = 400;      // real time catch up limit, time beyond this is dropped
+	bool  interpolateRender   = true;     // draw between the last two ticks, by the leftover fraction of a tick
+	float gravity             = -8.0;     // scales the contribution of force of gravity
+
+	int   solver              = EXPLICIT_EULER; // solverType, can be switched between ticks
+	int   integrator          = SEMI_IMPLICIT_EULER; // integratorType, for the explicit solver
+	bool  deterministic       = false;    // fixed partition and kernel, see deterministicPartCount - applied on load
+	bool  logChecksums        = false;    // print a checksum of the state after every tick
+	int   precision           = SINGLE_PRECISION; // precisionMode of the state and solver math - applied on load
+	int   cgMaxIterations     = 40;       // CG iteration limit per implicit tick
+	float cgTolerance         = 1e-4;     // relative residual at which CG stops early
+	int   cgPreconditioner    = JACOBI_PRECONDITIONER; // preconditionerType of the implicit solver's CG
+	int   xpbdSubsteps        = 4;        // XPBD substeps per tick
+	int   xpbdIterations      = 2;        // constraint projection passes per XPBD substep
+	bool  xpbdColoring        = false;    // project edge colors across the whole graph, in place of per part sweeps
+	int   multirateLevels     = 4;        // multirate: the stiffest nodes take up to 2^( levels - 1 ) kicks per tick
+	float multirateSafety     = 0.9;      // multirate: fraction of each node's local stability limit a kick may take
+
+	int   roadSource          = NOISE_ROAD; // roadSourceType, can be switched between ticks
+	int   roadClass           = ROAD_CLASS_C; // spectral road: roadClass, A smoothest to H
+	float noiseAmplitudeScale = 0.065;    // scalar on the noise amplitude
+	float noiseSpeed          = 8.6;      // how quickly the noise offset increases
+	int   roadSeed            = 42069;    // seed of the road noise
+	float roadScale           = 0.4f;     // road noise frequency, the model keeps it at its display scale
+	int   roadNoiseBackend    = BUILTIN_NOISE; // noiseBackend, can be switched between ticks
+	bool  cacheRoad           = true;     // read the road from a scrolling heightfield, bilinear between samples - off, from the noise. the spectral road is always cached
+	float wheelDiameter       = 0.2f;     // offset from the noise read, per wheel
+
+	float chassisNodeMass     = 3.0;      // mass of a chassis node
+	float anchoredNodeMass    = 0.0;      // mass of an anchored node
+
+	// any number of rows, call RefreshMaterialConstants after editing. the suspension rows carry
+	// a progressive spring and a digressive shock, stiffer in rebound, ready to be switched on
+	std::vector< material > materials = {
+		{ "Chassis",            14000.0f, 51.5f, STEEL },
+		{ "Suspension",         9000.0f,  32.4f, YELLOW, LINEAR_SPRING, 27000.0f, -0.1f, 0.1f,
+			{ { -0.2f, -3600.0f }, { -0.1f, -900.0f }, { 0.0f, 0.0f }, { 0.1f, 900.0f }, { 0.2f, 3600.0f } },
+			NO_DAMPER, 100.0f, { { -2.0f, -150.0f }, { -0.5f, -60.0f }, { 0.0f, 0.0f }, { 0.5f, 90.0f }, { 2.0f, 240.0f } } },
+		{ "Inboard Suspension", 9000.0f,  32.4f, BROWN, LINEAR_SPRING, 27000.0f, -0.1f, 0.1f,
+			{ { -0.2f, -3600.0f }, { -0.1f, -900.0f }, { 0.0f, 0.0f }, { 0.1f, 900.0f }, { 0.2f, 3600.0f } },
+			NO_DAMPER, 100.0f, { { -2.0f, -150.0f }, { -0.5f, -60.0f }, { 0.0f, 0.0f }, { 0.5f, 90.0f }, { 2.0f, 240.0f } } } };
+};
+
+// the nodes, springs and panels of one vehicle, in solver order once finalized - after that it
+// is read only, and any number of simulations can share it
+class vehicleGraph {
+public:
+	// the stock chassis - carFrameWPanels.obj, the four wheel points and the suspension edges
+	void loadFrame( const std::string& path = "carFrameWPanels.obj" );
+
+	void addNode( glm::vec3 position, bool anchored );
+	void addEdge( int nodeIndex1, int nodeIndex2, int material );
+	void addFace( int nodeIndex1, int nodeIndex2, int nodeIndex3, glm::vec3 normal );
+
+	// move anchored nodes to the front, split the free nodes into numParts compact blocks and
+	// renumber so each is a contiguous range, then build the spring topology in that order
+	void finalize( int numParts );
+
+	std::vector< node > nodes;
+	std::vector< edge > edges;
+	std::vector< face > faces;
+	int numAnchored = 0;
+
+	// spring graph in CSR form, split into numParts parts
+	springTopology topology;
+
+private:
+	void ApplyNodeOrder( const std::vector< int >& order ); // order[ new ] = old, for nodes, edges, faces
+};
+
+// the frame at path, finalized into a part per worker ( deterministicPartCount of them, if
+// parameters.deterministic is set ) - and the spring kernel set to match, which is process wide
+std::shared_ptr< const vehicleGraph > loadVehicleGraph( const std::string& path, const simParameterPack& parameters, int numWorkers );
+
+// one vehicle driving its own road - the dynamic state, solver scratch and parameters over a
+// shared graph. a tick runs on whatever pool it is handed, so many of these can be stepped by
+// one scheduler, see ensemble.h
+class softbodySimulation {
+public:
+	softbodySimulation();
+
+	// take graph, size the state at simParameters.precision and put it at its rest pose - also
+	// how a change of precision is applied. the graph must be finalized, and stay unchanged
+	void Load( std::shared_ptr< const vehicleGraph > graph );
+
+	void ResetSimulationState();          // rest pose, zero velocity, cleared solver scratch
+
+	// rebuild the kernels' copy of simParameters.materials, and the per node damping sums
+	void RefreshMaterialConstants();
+
+	// one tick on pool - wheel heights from the road, the solver, swap. the road moves noiseStep
+	void Substep( threadPool& pool, float noiseStep );
+
+	// how far the road moves in a tick, at the speed it has when stepping in real time
+	float NoiseStep() const { return 0.001f * simParameters.noiseSpeed * simParameters.timeScale * 60.0f; }
+
+	// the tick position verlet steps back over - lastTimeStep, or this one's before the first, when
+	// the state behind current is the rest pose again. the adaptive tick and the UI change it between ticks
+	float PreviousTimeStep() const { return lastTimeStep > 0.0f ? lastTimeStep : simParameters.timeScale; }
+
+	// of the current state, comparable between runs when deterministic is set
+	uint64_t StateChecksum() const;
+	uint64_t tickCount = 0;               // ticks since the last reset
+	double simulatedTime = 0.0;           // seconds simulated since the last reset, the sum of the ticks taken
+	float lastTimeStep = 0.0f;            // the tick that led to the current state, zero until the first
+
+	glm::vec3 nodePosition( int index, float blend = 1.0f ) const; // between the last two ticks, by blend
+	float MaxStrain() const;              // largest | L / L0 - 1 | over the springs
+	float getGroundPoint( float x, float y ) const; // road height, in the model's display space
+
+	// display space height of a unit of the road cache's values - noiseAmplitudeScale for the
+	// noise, roadScale for the spectral road, whose values are meters
+	float RoadAmplitude() const;
+
+	// getGroundPoint at count points ( x[ i ], y[ i ] ) in one pass, with the height's slope along
+	// x and y when slopeX and slopeY aren't null - the cache's surface differentiated exactly,
+	// the points it doesn't hold sampled in one noise batch along with the noise's gradient
+	void getGroundPoints( int count, const float* x, const float* y, float* height,
+		float* slopeX = nullptr, float* slopeY = nullptr );
+
+	// road slope under each anchored node as of the last tick, rise over run along x and z in the
+	// simulation's space - PlaceWheels sets the wheel off the surface along its normal with it
+	std::vector< float > wheelSlopeX, wheelSlopeZ;
+
+	// bring the road cache up to noiseOffset - Substep does this every tick, call it after moving
+	// noiseOffset any other way. getGroundPoint falls back to the noise itself outside the cache,
+	// or a flat road for the spectral one. the spectral road's tiles are taken from its producer
+	// thread here, which is started on first use
+	void ScrollRoad();
+	const heightfieldCache& RoadCache() const { return roadCache; }
+
+	// whether something draws the ground from RoadCache - the cache then holds the model's ground
+	// patch, otherwise just the wheels' footprint and a margin, which is all the contact reads
+	bool roadDrawn = false;
+
+	// the adaptive tick size's stability limit as of its last estimate, infinite for the solvers
+	// without one, zero before the first
+	float StableTimeStep() const;
+
+	// the last implicit tick's CG solve
+	int lastCGIterations() const;
+	float lastCGResidual() const;
+
+	// the multirate solver's grouping as of its last tick - free nodes per level, slowest first,
+	// and springs evaluated per tick over all its substeps
+	std::vector< int > multirateLevelNodes() const;
+	int multirateSpringEvaluations() const;
+
+	// drive each solver at a range of tick sizes, print stability and cost to the console -
+	// leaves the simulation back at its rest pose
+	void BenchmarkSolvers( threadPool& pool, float frameBudget = 4.0f, float simulatedSeconds = 2.0f );
+
+	simParameterPack simParameters;
+	float noiseOffset = 0.0;              // how far the road has moved
+
+	const vehicleGraph& graph() const { return *sharedGraph; }
+
+	// zero copy access to the node state, SoA arrays in graph order - scalar is float when loaded
+	// at single or mixed precision, double at double, and any other gets nullptr. current is the
+	// state the last tick wrote, previous the one it started from. the arrays stay put until the
+	// next Load, but every tick swaps which of the two is which, so take them between ticks.
+	// writes to the current state are what the next tick starts from
+	precisionMode loadedPrecision() const { return activePrecision; }
+	template < typename scalar > nodeState< scalar >* State();
+	template < typename scalar > const nodeState< scalar >* State() const;
+	template < typename scalar > const nodeState< scalar >* PreviousState() const;
+
+private:
+	friend class vehiclePack;             // steps the single precision buffers in its lanes
+
+	std::shared_ptr< const vehicleGraph > sharedGraph;
+
+	// dynamic node state and solver scratch, at each precision - one is in use at a time
+	simulationBuffers< singlePrecision > singleBuffers;
+	simulationBuffers< mixedPrecision > mixedBuffers;
+	simulationBuffers< doublePrecision > doubleBuffers;
+	precisionMode activePrecision = SINGLE_PRECISION; // simParameters.precision as of the last load
+	float inverseMassSource = -1.0f;      // chassisNodeMass value inverseMass was computed from
+
+	// call f with the buffers in use - f takes them as auto&, so it is compiled once per precision
+	template < typename F > auto WithActiveBuffers( F&& f ) {
+		switch ( activePrecision ) {
+			case MIXED_PRECISION:  return f( mixedBuffers );
+			case DOUBLE_PRECISION: return f( doubleBuffers );
+			default:               return f( singleBuffers );
+		}
+	}
+	template < typename F > auto WithActiveBuffers( F&& f ) const {
+		switch ( activePrecision ) {
+			case MIXED_PRECISION:  return f( mixedBuffers );
+			case DOUBLE_PRECISION: return f( doubleBuffers );
+			default:               return f( singleBuffers );
+		}
+	}
+
+	// the state buffers in use, if their storage is scalar
+	template < typename scalar > const stateBuffers< scalar >* ActiveState() const;
+
+	springConstants frameConstants;       // the material table as the kernels read it
+	void RefreshInverseMass();
+
+	// update all nodes across the pool - edge pass, then halo gather and integration
+	template < typename precision > void MultiThreadSoftbodyUpdate( threadPool& pool, simulationBuffers< precision >& b );
+
+	// update all nodes with a single thread
+	template < typename precision > void SingleThreadSoftbodyUpdate( simulationBuffers< precision >& b );
+
+	// road surface
+	std::shared_ptr< const roadNoise > roadGenerator;
+	int generatorBackend = -1;            // roadNoiseBackend roadGenerator was made for
+	std::unique_ptr< spectralRoad > spectral; // PROFILE_ROAD, made on first use
+	heightfieldCache roadCache;
+	float roadWindow[ 4 ] = {};           // roadCache's extent as configured, noise space u and v min and max
+	void FitRoadWindow();                 // reconfigure roadCache when roadDrawn, the wheels or the road scale moved it
+	std::vector< float > wheelX, wheelZ, wheelHeight; // PlaceWheels scratch
+	std::vector< int > groundMisses;      // getGroundPoints scratch - the points the cache didn't hold, and their noise
+	std::vector< float > groundU, groundV, groundNoise, groundDu, groundDv;
+
+	// set the anchored nodes' py to the road under them, off it along its normal, and the wheel
+	// slopes - node i of the state at index i * stride + lane, as the pack interleaves its lanes
+	template < typename scalar > void PlaceWheels( nodeState< scalar >& state, int stride = 1, int lane = 0 );
+};
+
+template < typename scalar >
+const stateBuffers< scalar >* softbodySimulation::ActiveState() const {
+	if constexpr ( std::is_same< scalar, double >::value )
+		return activePrecision == DOUBLE_PRECISION ? &doubleBuffers.state : nullptr;
+	else if constexpr ( std::is_same< scalar, float >::value )
+		return activePrecision == MIXED_PRECISION ? &mixedBuffers.state : activePrecision == SINGLE_PRECISION ? &singleBuffers.state : nullptr;
+	else
+		return nullptr;
+}
+
+template < typename scalar >
+nodeState< scalar >* softbodySimulation::State() {
+	const stateBuffers< scalar >* s = ActiveState< scalar >();
+	return s ? &const_cast< stateBuffers< scalar >* >( s )->current() : nullptr;
+}
+
+template < typename scalar >
+const nodeState< scalar >* softbodySimulation::State() const {
+	const stateBuffers< scalar >* s = ActiveState< scalar >();
+	return s ? &s->current() : nullptr;
+}
+
+template < typename scalar >
+const nodeState< scalar >* softbodySimulation::PreviousState() const {
+	const stateBuffers< scalar >* s = ActiveState< scalar >();
+	return s ? &s->previous() : nullptr;
+}
+
+template < typename scalar >
+void softbodySimulation::PlaceWheels( nodeState< scalar >& state, int stride, int lane ) {
+	const int numAnchored = sharedGraph->numAnchored;
+	wheelX.resize( numAnchored ); wheelZ.resize( numAnchored ); wheelHeight.resize( numAnchored );
+	wheelSlopeX.resize( numAnchored ); wheelSlopeZ.resize( numAnchored );
+	for ( int i = 0; i < numAnchored; i++ ) {
+		wheelX[ i ] = state.px[ i * stride + lane ];
+		wheelZ[ i ] = state.pz[ i * stride + lane ];
+	}
+	getGroundPoints( numAnchored, wheelX.data(), wheelZ.data(), wheelHeight.data(), wheelSlopeX.data(), wheelSlopeZ.data() );
+
+	// the road is in display space, a unit of run in x is roadScale of it. the wheel stands off
+	// the surface along its normal, which on a slope is higher above the point under its center by
+	// the length of the normal ( -slopeX, 1, -slopeZ )
+	for ( int i = 0; i < numAnchored; i++ ) {
+		wheelSlopeX[ i ] /= simParameters.roadScale;
+		wheelSlopeZ[ i ] /= simParameters.roadScale;
+		const float normal = std::sqrt( 1.0f + wheelSlopeX[ i ] * wheelSlopeX[ i ] + wheelSlopeZ[ i ] * wheelSlopeZ[ i ] );
+		state.py[ i * stride + lane ] = wheelHeight[ i ] / simParameters.roadScale + simParameters.wheelDiameter * normal;
+	}
+}
+
+#endif
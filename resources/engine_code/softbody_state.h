@@ -0,0 +1,139 @@
+#ifndef SOFTBODY_STATE
+#define SOFTBODY_STATE
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <utility>
+
+constexpr size_t stateAlignment = 64;   // one cache line, also the width of an AVX-512 register
+constexpr size_t statePadding   = 16;   // arrays are padded out to a multiple of this many entries
+
+// the floating point types a simulation runs in - storage is what the node state is kept in,
+// accumulator what forces are summed and the integration is done in. picked when the model is built
+template < typename storageType, typename accumulatorType >
+struct precisionPolicy {
+	using storage = storageType;
+	using accumulator = accumulatorType;
+};
+
+using singlePrecision = precisionPolicy< float, float >;   // throughput, and the only one the vector kernels run
+using mixedPrecision  = precisionPolicy< float, double >;  // float state, double sums and integration
+using doublePrecision = precisionPolicy< double, double >; // validation runs
+
+enum precisionMode {
+	SINGLE_PRECISION,
+	MIXED_PRECISION,
+	DOUBLE_PRECISION
+};
+
+// owning scalar array with cache line alignment - the tail is padded and zeroed so
+// vector kernels can run over whole registers without a scalar remainder loop
+template < typename scalar >
+class alignedArray {
+public:
+	alignedArray() = default;
+	~alignedArray() { std::free( values ); }
+
+	alignedArray( const alignedArray& ) = delete;
+	alignedArray& operator=( const alignedArray& ) = delete;
+	alignedArray( alignedArray&& other ) noexcept { *this = std::move( other ); }
+	alignedArray& operator=( alignedArray&& other ) noexcept {
+		std::swap( values, other.values );
+		std::swap( count, other.count );
+		std::swap( capacity, other.capacity );
+		return *this;
+	}
+
+	void resize( size_t n ) {
+		std::free( values );
+		count = n;
+		capacity = ( ( n + statePadding - 1 ) / statePadding ) * statePadding;
+		if ( capacity == 0 ) capacity = statePadding;
+		values = static_cast< scalar* >( std::aligned_alloc( stateAlignment, capacity * sizeof( scalar ) ) );
+		if ( values == nullptr ) throw std::bad_alloc();
+		std::memset( values, 0, capacity * sizeof( scalar ) );
+	}
+
+	scalar& operator[]( size_t i )       { return values[ i ]; }
+	scalar  operator[]( size_t i ) const { return values[ i ]; }
+
+	scalar*       data()       { return values; }
+	const scalar* data() const { return values; }
+	size_t        size() const { return count; }
+	size_t        paddedSize() const { return capacity; }
+
+private:
+	scalar* values  = nullptr;
+	size_t count    = 0;                  // number of meaningful entries
+	size_t capacity = 0;                  // allocated entries, multiple of statePadding
+};
+
+// one copy of the dynamic node state, stored as a structure of arrays
+template < typename scalar >
+struct nodeState {
+	alignedArray< scalar > px, py, pz;    // position components
+	alignedArray< scalar > vx, vy, vz;    // velocity components
+
+	void resize( size_t n ) {
+		px.resize( n ); py.resize( n ); pz.resize( n );
+		vx.resize( n ); vy.resize( n ); vz.resize( n );
+	}
+
+	size_t size() const { return px.size(); }
+
+	// copy a contiguous range of nodes from another state, e.g. the anchored range
+	void copyRange( const nodeState& source, size_t first, size_t last ) {
+		const size_t bytes = ( last - first ) * sizeof( scalar );
+		std::memcpy( px.data() + first, source.px.data() + first, bytes );
+		std::memcpy( py.data() + first, source.py.data() + first, bytes );
+		std::memcpy( pz.data() + first, source.pz.data() + first, bytes );
+		std::memcpy( vx.data() + first, source.vx.data() + first, bytes );
+		std::memcpy( vy.data() + first, source.vy.data() + first, bytes );
+		std::memcpy( vz.data() + first, source.vz.data() + first, bytes );
+	}
+
+	// FNV-1a over the bit patterns of every component of nodes [ first, last ) - equal for two
+	// runs only if their states are bit identical, so it can be logged and diffed between machines
+	uint64_t checksum( size_t first, size_t last ) const {
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for ( const alignedArray< scalar >* a : { &px, &py, &pz, &vx, &vy, &vz } ) {
+			const unsigned char* bytes = reinterpret_cast< const unsigned char* >( a->data() + first );
+			for ( size_t i = 0; i < ( last - first ) * sizeof( scalar ); i++ )
+				hash = ( hash ^ bytes[ i ] ) * 0x100000001b3ull;
+		}
+		return hash;
+	}
+};
+
+// double buffered state - each tick reads current() and writes next(), then the two
+// swap roles, so there is no per tick copy of the previous values
+template < typename scalar >
+class stateBuffers {
+public:
+	void resize( size_t n ) {
+		buffers[ 0 ].resize( n );
+		buffers[ 1 ].resize( n );
+		currentIndex = 0;
+	}
+
+	nodeState< scalar >&       current()       { return buffers[ currentIndex ]; }
+	const nodeState< scalar >& current() const { return buffers[ currentIndex ]; }
+	nodeState< scalar >&       next()          { return buffers[ currentIndex ^ 1 ]; }
+	const nodeState< scalar >& next()    const { return buffers[ currentIndex ^ 1 ]; }
+
+	// between ticks, the next buffer still holds the state the last tick started from
+	const nodeState< scalar >& previous() const { return buffers[ currentIndex ^ 1 ]; }
+
+	void swap() { currentIndex ^= 1; }
+	size_t size() const { return buffers[ 0 ].size(); }
+
+private:
+	nodeState< scalar > buffers[ 2 ];
+	int currentIndex = 0;
+};
+
+#endif
@@ -0,0 +1,202 @@
+#include "softbody_topology.h"
+
+#include <algorithm>
+#include <numeric>
+
+void springTopology::build( int nodeCount, const std::vector< edge >& edges ) {
+  numNodes = nodeCount;
+  numEdges = edges.size();
+
+  node1.resize( numEdges );
+  node2.resize( numEdges );
+  baseLength.resize( numEdges );
+  material.resize( numEdges );
+  numMaterials = 0;
+  for ( int e = 0; e < numEdges; e++ ) {
+    node1[ e ]      = edges[ e ].node1;
+    node2[ e ]      = edges[ e ].node2;
+    baseLength[ e ] = edges[ e ].baseLength;
+    material[ e ]   = edges[ e ].material;
+    numMaterials    = std::max( numMaterials, material[ e ] + 1 );
+  }
+  buildAdjacency();
+
+  // until assignParts is called, everything is one part with no halo
+  assignParts( { 0, numNodes } );
+}
+
+void springTopology::buildAdjacency() {
+  // count the degree of each node, prefix sum gives the row offsets
+  rowStart.assign( numNodes + 1, 0 );
+  for ( int e = 0; e < numEdges; e++ ) {
+    rowStart[ node1[ e ] + 1 ]++;
+    rowStart[ node2[ e ] + 1 ]++;
+  }
+  for ( int n = 0; n < numNodes; n++ )
+    rowStart[ n + 1 ] += rowStart[ n ];
+
+  // fill the rows, each edge shows up once from either side
+  neighbor.resize( 2 * numEdges );
+  incidentEdge.resize( 2 * numEdges );
+  std::vector< int > fill( rowStart.begin(), rowStart.end() - 1 );
+  for ( int e = 0; e < numEdges; e++ ) {
+    int i = fill[ node1[ e ] ]++;
+    neighbor[ i ] = node2[ e ];
+    incidentEdge[ i ] = e;
+
+    i = fill[ node2[ e ] ]++;
+    neighbor[ i ] = node1[ e ];
+    incidentEdge[ i ] = e;
+  }
+}
+
+void springTopology::assignParts( const std::vector< int >& partStart ) {
+  numParts = partStart.size() - 1;
+  partNodeStart = partStart;
+
+  nodePart.assign( numNodes, -1 );
+  for ( int p = 0; p < numParts; p++ )
+    for ( int n = partStart[ p ]; n < partStart[ p + 1 ]; n++ )
+      nodePart[ n ] = p;
+
+  // orient each edge so node1 is on the owning side - the endpoint inside a part, and
+  // of two such endpoints the lower index
+  for ( int e = 0; e < numEdges; e++ ) {
+    const bool swap = ( nodePart[ node1[ e ] ] < 0 && nodePart[ node2[ e ] ] >= 0 ) ||
+      ( nodePart[ node1[ e ] ] >= 0 && nodePart[ node2[ e ] ] >= 0 && node2[ e ] < node1[ e ] );
+    if ( swap ) std::swap( node1[ e ], node2[ e ] );
+  }
+
+  auto owner = [&]( int e ) { return std::max( nodePart[ node1[ e ] ], 0 ); };
+  auto isCross = [&]( int e ) { return nodePart[ node2[ e ] ] >= 0 && nodePart[ node2[ e ] ] != owner( e ); };
+
+  // group by owning part, interior edges before cross edges, then by material so each batch
+  // runs with one set of constants, then by node for locality
+  std::vector< int > order( numEdges );
+  std::iota( order.begin(), order.end(), 0 );
+  std::stable_sort( order.begin(), order.end(), [&]( int a, int b ) {
+    if ( owner( a ) != owner( b ) ) return owner( a ) < owner( b );
+    if ( isCross( a ) != isCross( b ) ) return isCross( b );
+    if ( material[ a ] != material[ b ] ) return material[ a ] < material[ b ];
+    if ( node1[ a ] != node1[ b ] ) return node1[ a ] < node1[ b ];
+    return node2[ a ] < node2[ b ];
+  } );
+
+  auto permute = [&]( auto& values ) {
+    auto copy = values;
+    for ( int e = 0; e < numEdges; e++ )
+      values[ e ] = copy[ order[ e ] ];
+  };
+  permute( node1 );
+  permute( node2 );
+  permute( baseLength );
+  permute( material );
+  buildAdjacency();
+
+  inverseBaseLength.resize( numEdges );
+  for ( int e = 0; e < numEdges; e++ )
+    inverseBaseLength[ e ] = 1.0f / baseLength[ e ];
+
+  // part edge ranges
+  partEdgeStart.assign( numParts + 1, 0 );
+  partCrossStart.assign( numParts, 0 );
+  for ( int e = 0; e < numEdges; e++ )
+    partEdgeStart[ owner( e ) + 1 ]++;
+  for ( int p = 0; p < numParts; p++ )
+    partEdgeStart[ p + 1 ] += partEdgeStart[ p ];
+  for ( int p = 0; p < numParts; p++ ) {
+    int e = partEdgeStart[ p ];
+    while ( e < partEdgeStart[ p + 1 ] && !isCross( e ) ) e++;
+    partCrossStart[ p ] = e;
+  }
+
+  // batches - a new one wherever the material changes, or a part or its cross edges begin
+  partBatchStart.assign( numParts + 1, 0 );
+  batchStart.clear();
+  batchMaterial.clear();
+  for ( int p = 0; p < numParts; p++ ) {
+    partBatchStart[ p ] = batchStart.size();
+    for ( int e = partEdgeStart[ p ]; e < partEdgeStart[ p + 1 ]; e++ )
+      if ( e == partEdgeStart[ p ] || e == partCrossStart[ p ] || material[ e ] != material[ e - 1 ] ) {
+        batchStart.push_back( e );
+        batchMaterial.push_back( material[ e ] );
+      }
+  }
+  partBatchStart[ numParts ] = batchStart.size();
+  batchStart.push_back( numEdges );
+
+  // halo lists - the cross edges landing on each part, in node order
+  haloStart.assign( numParts + 1, 0 );
+  haloEdge.clear();
+  std::vector< std::vector< int > > incoming( numParts );
+  for ( int e = 0; e < numEdges; e++ )
+    if ( isCross( e ) )
+      incoming[ nodePart[ node2[ e ] ] ].push_back( e );
+  for ( int p = 0; p < numParts; p++ ) {
+    std::stable_sort( incoming[ p ].begin(), incoming[ p ].end(), [&]( int a, int b ) { return node2[ a ] < node2[ b ]; } );
+    haloEdge.insert( haloEdge.end(), incoming[ p ].begin(), incoming[ p ].end() );
+    haloStart[ p + 1 ] = haloEdge.size();
+  }
+
+  buildColorings();
+}
+
+// the lowest color not marked used, then clear the marks
+static int lowestFreeColor( std::vector< char >& used, const std::vector< int >& marked ) {
+  int color = 0;
+  while ( color < int( used.size() ) && used[ color ] ) color++;
+  for ( int c : marked ) used[ c ] = 0;
+  return color;
+}
+
+// bucket items by color, keeping index order within each
+static void groupByColor( const std::vector< int >& color, int numColors, std::vector< int >& colorStart, std::vector< int >& items ) {
+  colorStart.assign( numColors + 1, 0 );
+  for ( int c : color )
+    if ( c >= 0 ) colorStart[ c + 1 ]++;
+  for ( int c = 0; c < numColors; c++ )
+    colorStart[ c + 1 ] += colorStart[ c ];
+  items.resize( colorStart[ numColors ] );
+  std::vector< int > fill( colorStart.begin(), colorStart.end() - 1 );
+  for ( size_t i = 0; i < color.size(); i++ )
+    if ( color[ i ] >= 0 ) items[ fill[ color[ i ] ]++ ] = i;
+}
+
+void springTopology::buildColorings() {
+  // first fit in index order - the parts are grown breadth first, so this walks the graph
+  // front by front, and each color comes out spread evenly over it
+  std::vector< char > used;
+  std::vector< int > marked;
+  auto mark = [&]( int c ) {
+    if ( c < 0 ) return;
+    if ( c >= int( used.size() ) ) used.resize( c + 1, 0 );
+    if ( !used[ c ] ) used[ c ] = 1, marked.push_back( c );
+  };
+
+  int numColors = 0;
+  nodeColor.assign( numNodes, -1 );
+  for ( int n = 0; n < numNodes; n++ ) {
+    if ( nodePart[ n ] < 0 ) continue;
+    marked.clear();
+    for ( int i = rowStart[ n ]; i < rowStart[ n + 1 ]; i++ )
+      mark( nodeColor[ neighbor[ i ] ] );
+    nodeColor[ n ] = lowestFreeColor( used, marked );
+    numColors = std::max( numColors, nodeColor[ n ] + 1 );
+  }
+  groupByColor( nodeColor, numColors, nodeColorStart, colorNode );
+
+  // an edge conflicts with the edges at either end that moves
+  numColors = 0;
+  std::vector< int > edgeColor( numEdges, -1 );
+  for ( int e = 0; e < numEdges; e++ ) {
+    marked.clear();
+    for ( int n : { node1[ e ], node2[ e ] } ) {
+      if ( nodePart[ n ] < 0 ) continue;
+      for ( int i = rowStart[ n ]; i < rowStart[ n + 1 ]; i++ )
+        mark( edgeColor[ incidentEdge[ i ] ] );
+    }
+    edgeColor[ e ] = lowestFreeColor( used, marked );
+    numColors = std::max( numColors, edgeColor[ e ] + 1 );
+  }
+  groupByColor( edgeColor, numColors, edgeColorStart, colorEdge );
+}
@@ -0,0 +1,81 @@
+#ifndef SOFTBODY_TOPOLOGY
+#define SOFTBODY_TOPOLOGY
+
+#include <vector>
+
+struct edge {
+	int material;                         // row of the material table, which holds k and damping
+	float length, baseLength;             // current and initial edge length, used to determine compression / tension state
+	int node1, node2;                     // indices the nodes on either end of the edge
+};
+
+// the spring graph, built once after loading - edges are stored once, as a structure
+// of arrays, and node adjacency is in compressed sparse row form
+class springTopology {
+public:
+	void build( int nodeCount, const std::vector< edge >& edges );
+
+	// split the work into parts, given the node ranges from partitionGraph - reorders the
+	// edges so each part's edges are contiguous, and builds the halo lists
+	void assignParts( const std::vector< int >& partStart );
+
+	int numNodes = 0;
+	int numEdges = 0;
+
+	// per edge data
+	std::vector< int >   node1;           // first endpoint ( the owning side, once parts are assigned )
+	std::vector< int >   node2;           // second endpoint
+	std::vector< float > baseLength;      // rest length
+	std::vector< float > inverseBaseLength;
+	std::vector< int >   material;        // material table row
+
+	// adjacency - for node n, entries [ rowStart[ n ], rowStart[ n + 1 ] ) list the
+	// neighboring node and the index of the edge connecting them
+	std::vector< int > rowStart;
+	std::vector< int > neighbor;
+	std::vector< int > incidentEdge;
+
+	int degree( int n ) const { return rowStart[ n + 1 ] - rowStart[ n ]; }
+
+	// part p integrates nodes [ partNodeStart[ p ], partNodeStart[ p + 1 ] ) and evaluates edges
+	// [ partEdgeStart[ p ], partEdgeStart[ p + 1 ] ). edges from partCrossStart[ p ] on are cross
+	// edges, whose node2 belongs to another part q - their spring force is parked per edge, and
+	// q adds it to node2 while walking its halo, edges [ haloStart[ q ], haloStart[ q + 1 ] )
+	int numParts = 0;
+	std::vector< int > nodePart;          // owning part per node, -1 for nodes outside all parts
+	std::vector< int > partNodeStart;
+	std::vector< int > partEdgeStart;
+	std::vector< int > partCrossStart;
+	std::vector< int > haloStart;
+	std::vector< int > haloEdge;
+
+	// within a part, the interior and the cross edges are each sorted by material, so each part's
+	// edges are a run of batches [ partBatchStart[ p ], partBatchStart[ p + 1 ] ) - batch b covers
+	// edges [ batchStart[ b ], batchStart[ b + 1 ] ), all of material batchMaterial[ b ], and is
+	// either all interior or all cross edges
+	int numMaterials = 0;
+	std::vector< int > partBatchStart;
+	std::vector< int > batchStart;
+	std::vector< int > batchMaterial;
+
+	// greedy colorings for Gauss-Seidel sweeps, which take one color at a time and split it across
+	// the workers - no two nodes of a color share a spring, and no two edges of a color share a
+	// node that moves. only nodes in a part are colored, the anchored ones are never written, so
+	// springs may share those. color c is nodes colorNode[ nodeColorStart[ c ], nodeColorStart[ c + 1 ] ),
+	// edges colorEdge[ edgeColorStart[ c ], edgeColorStart[ c + 1 ] ), each in index order. built
+	// with the parts, so only when the topology changes
+	std::vector< int > nodeColor;         // -1 for nodes outside all parts
+	std::vector< int > nodeColorStart;
+	std::vector< int > colorNode;
+	std::vector< int > edgeColorStart;
+	std::vector< int > colorEdge;
+
+	int numNodeColors() const { return nodeColorStart.size() - 1; }
+	int numEdgeColors() const { return edgeColorStart.size() - 1; }
+
+private:
+	void buildAdjacency();
+	void buildColorings();
+};
+
+#endif
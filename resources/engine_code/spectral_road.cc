@@ -0,0 +1,374 @@
+#include "spectral_road.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+constexpr double pi = 3.14159265358979323846;
+constexpr double referenceFrequency = 0.1; // n0, cycles per meter
+constexpr int phaseBits = 12;              // the phases are multiples of 2 pi / 4096
+
+double roadClassRoughness( int roadClass ) {
+  return 16e-6 * std::pow( 4.0, std::min( std::max( roadClass, 0 ), int( ROAD_CLASS_H ) ) );
+}
+
+// rounds toward negative infinity, rows and tiles go negative behind the start of the road
+static int floorDiv( int a, int b ) {
+  return a / b - ( ( a % b ) != 0 && ( a < 0 ) != ( b < 0 ) );
+}
+
+// splitmix64's finalizer
+static uint64_t mix( uint64_t z ) {
+  z += 0x9e3779b97f4a7c15ull;
+  z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+  z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebull;
+  return z ^ ( z >> 31 );
+}
+
+namespace {
+// in place radix 2 transform of n points, with e^( +2 pi i j k / n ) - the inverse, unnormalized
+struct inverseFFT {
+  int n;
+  std::vector< std::complex< float > > twiddle; // e^( 2 pi i j / n ), j < n / 2
+  std::vector< int > reversal;
+
+  explicit inverseFFT( int n ) : n( n ), twiddle( n / 2 ), reversal( n ) {
+    for ( int j = 0; j < n / 2; j++ )
+      twiddle[ j ] = std::complex< float >( std::cos( 2.0 * pi * j / n ), std::sin( 2.0 * pi * j / n ) );
+    int bits = 0;
+    while ( ( 1 << bits ) < n ) bits++;
+    for ( int i = 0; i < n; i++ ) {
+      int r = 0;
+      for ( int b = 0; b < bits; b++ )
+        r |= ( ( i >> b ) & 1 ) << ( bits - 1 - b );
+      reversal[ i ] = r;
+    }
+  }
+
+  void operator()( std::complex< float >* data ) const {
+    for ( int i = 0; i < n; i++ )
+      if ( i < reversal[ i ] ) std::swap( data[ i ], data[ reversal[ i ] ] );
+    for ( int length = 2; length <= n; length *= 2 ) {
+      const int half = length / 2;
+      const int step = n / length;
+      for ( int start = 0; start < n; start += length )
+        for ( int j = 0; j < half; j++ ) {
+          const std::complex< float > odd = data[ start + j + half ] * twiddle[ j * step ];
+          data[ start + j + half ] = data[ start + j ] - odd;
+          data[ start + j ] += odd;
+        }
+    }
+  }
+};
+}
+
+static int powerOfTwo( int n ) {
+  int p = 1;
+  while ( p < n ) p *= 2;
+  return p;
+}
+
+struct spectralStream::spectrum {
+  const int classIndex;
+  const double spacing;
+  const int columns;
+  const int fieldColumns;               // the transform size, the columns rounded up to a power of two by two tiles of rows
+  const inverseFFT rowFFT, columnFFT;
+  std::vector< float > amplitudes;      // per bin, the square root of twice its share of the PSD
+
+  spectrum( int roadClass, double spacing, int columns );
+};
+
+struct spectralStream::scratch {
+  std::vector< float > fadeOut, fadeIn;  // the cross fade's weights down a tile
+  std::vector< std::complex< float > > phases; // the unit circle
+  std::vector< std::complex< float > > next, work, column;
+
+  scratch() : fadeOut( tileRows ), fadeIn( tileRows ), phases( 1 << phaseBits ) {
+    // field k over its second half and field k + 1 over its first - the squares of the weights
+    // sum to one, so the variance holds through the fade
+    for ( int t = 0; t < tileRows; t++ ) {
+      fadeOut[ t ] = float( std::cos( 0.5 * pi * t / tileRows ) );
+      fadeIn[ t ] = float( std::sin( 0.5 * pi * t / tileRows ) );
+    }
+    for ( size_t i = 0; i < phases.size(); i++ )
+      phases[ i ] = std::polar( 1.0f, float( 2.0 * pi * i / phases.size() ) );
+  }
+};
+
+// every stream alive, and the thread making their tiles - one lock over all of it, the streams'
+// rings included. a function static, so it outlives whatever reads the road
+namespace {
+struct streamRegistry {
+  std::mutex lock;
+  std::condition_variable produced;     // readers wait on a stream's made
+  std::condition_variable consumed;     // the producer waits on room in some ring
+  std::vector< std::weak_ptr< spectralStream > > streams;
+  std::vector< std::weak_ptr< const spectralStream::spectrum > > spectra;
+  std::thread producer;
+  bool quit = false;
+
+  ~streamRegistry() {
+    if ( !producer.joinable() ) return;
+    {
+      std::lock_guard< std::mutex > guard( lock );
+      quit = true;
+    }
+    consumed.notify_one();
+    producer.join();
+  }
+};
+}
+
+static streamRegistry& registry() {
+  static streamRegistry instance;
+  return instance;
+}
+
+std::shared_ptr< const spectralStream::spectrum > spectralStream::shapeFor( int roadClass, double spacing, int columns ) {
+  streamRegistry& r = registry();
+  std::lock_guard< std::mutex > guard( r.lock );
+  r.spectra.erase( std::remove_if( r.spectra.begin(), r.spectra.end(),
+    []( const std::weak_ptr< const spectrum >& entry ) { return entry.expired(); } ), r.spectra.end() );
+  for ( const std::weak_ptr< const spectrum >& entry : r.spectra ) {
+    std::shared_ptr< const spectrum > shape = entry.lock();
+    if ( shape && shape->classIndex == roadClass && shape->spacing == spacing && shape->columns == columns )
+      return shape;
+  }
+  const std::shared_ptr< const spectrum > shape = std::make_shared< spectrum >( roadClass, spacing, columns );
+  r.spectra.push_back( shape );
+  return shape;
+}
+
+std::shared_ptr< spectralStream > spectralStream::join( const std::shared_ptr< const spectrum >& shape, int seed, int tile ) {
+  streamRegistry& r = registry();
+  std::lock_guard< std::mutex > guard( r.lock );
+  r.streams.erase( std::remove_if( r.streams.begin(), r.streams.end(),
+    []( const std::weak_ptr< spectralStream >& entry ) { return entry.expired(); } ), r.streams.end() );
+  for ( const std::weak_ptr< spectralStream >& entry : r.streams ) {
+    const std::shared_ptr< spectralStream > stream = entry.lock();
+    if ( stream && stream->shape == shape && stream->seed == seed && stream->canHold( tile ) ) {
+      stream->readers.push_back( tile );
+      return stream;
+    }
+  }
+
+  const std::shared_ptr< spectralStream > stream = std::make_shared< spectralStream >( seed, tile, shape );
+  stream->readers.push_back( tile );
+  r.streams.push_back( stream );
+  if ( !r.producer.joinable() ) r.producer = std::thread( &spectralStream::produce );
+  r.consumed.notify_one();
+  return stream;
+}
+
+spectralStream::spectralStream( int seed, int firstTile, std::shared_ptr< const spectrum > shape )
+  : seed( seed ), shape( std::move( shape ) ), columns( this->shape->columns ),
+    tiles( size_t( queueTiles ) * tileRows * columns ), kept( firstTile ), made( firstTile ),
+    carriedIndex( INT_MIN ) {  // indices go negative with the tiles
+}
+
+bool spectralStream::move( int from, int to ) {
+  std::lock_guard< std::mutex > guard( registry().lock );
+  if ( !canHold( to ) ) return false;
+  *std::find( readers.begin(), readers.end(), from ) = to;
+  release();
+  return true;
+}
+
+void spectralStream::leave( int tile ) {
+  std::lock_guard< std::mutex > guard( registry().lock );
+  readers.erase( std::find( readers.begin(), readers.end(), tile ) );
+  if ( !readers.empty() ) release();
+}
+
+void spectralStream::release() {
+  const int earliest = *std::min_element( readers.begin(), readers.end() );
+  if ( earliest <= kept ) return;
+  kept = earliest;
+  registry().consumed.notify_one();
+}
+
+void spectralStream::prime() {
+  streamRegistry& r = registry();
+  std::unique_lock< std::mutex > guard( r.lock );
+  r.produced.wait( guard, [&]() { return made >= kept + queueTiles; } );
+}
+
+const float* spectralStream::rows( int tile, bool& waited ) {
+  streamRegistry& r = registry();
+  std::unique_lock< std::mutex > guard( r.lock );
+  if ( made <= tile ) {
+    waited = true;
+    r.produced.wait( guard, [&]() { return made > tile; } );
+  }
+  return &tiles[ size_t( tile - floorDiv( tile, queueTiles ) * queueTiles ) * tileRows * columns ];
+}
+
+void spectralStream::produce() {
+  streamRegistry& r = registry();
+  scratch s;
+  std::unique_lock< std::mutex > guard( r.lock );
+  for ( ;; ) {
+    // the stream with room in its ring and the least lead on its earliest reader - a reader
+    // waiting on its tile has none
+    std::shared_ptr< spectralStream > stream;
+    r.consumed.wait( guard, [&]() {
+      for ( const std::weak_ptr< spectralStream >& entry : r.streams ) {
+        std::shared_ptr< spectralStream > candidate = entry.lock();
+        if ( candidate && candidate->made < candidate->kept + queueTiles
+          && ( !stream || candidate->made - candidate->kept < stream->made - stream->kept ) )
+          stream = std::move( candidate );
+      }
+      return r.quit || stream;
+    } );
+    if ( r.quit ) return;
+
+    // its slot held tile made - queueTiles, which is behind every reader, so it is made unlocked
+    const int tile = stream->made;
+    guard.unlock();
+    stream->make( tile, s );
+    guard.lock();
+    stream->made = tile + 1;
+    r.produced.notify_all();
+  }
+}
+
+void spectralStream::make( int tile, scratch& s ) {
+  // fields k and k + 1, the real or imaginary part of their transform by parity. transform a is
+  // the one carried from the last tile, unless the stream just started, and b is a or the next
+  const int a = floorDiv( tile, 2 ), b = floorDiv( tile + 1, 2 );
+  const size_t size = size_t( 2 * tileRows ) * columns;
+  if ( carriedIndex != a ) {
+    carried.resize( size );
+    synthesize( a, carried.data(), s );
+    carriedIndex = a;
+  }
+  if ( b != a ) {
+    s.next.resize( size );
+    synthesize( b, s.next.data(), s );
+  }
+  const std::complex< float >* fieldA = carried.data();
+  const std::complex< float >* fieldB = b != a ? s.next.data() : fieldA;
+  const bool imaginaryA = tile & 1, imaginaryB = ( tile + 1 ) & 1;
+
+  float* out = &tiles[ size_t( tile - floorDiv( tile, queueTiles ) * queueTiles ) * tileRows * columns ];
+  for ( int r = 0; r < tileRows; r++ ) {
+    const std::complex< float >* rowA = fieldA + size_t( r + tileRows ) * columns;
+    const std::complex< float >* rowB = fieldB + size_t( r ) * columns;
+    for ( int c = 0; c < columns; c++ )
+      out[ size_t( r ) * columns + c ] = s.fadeOut[ r ] * ( imaginaryA ? rowA[ c ].imag() : rowA[ c ].real() )
+                                       + s.fadeIn[ r ] * ( imaginaryB ? rowB[ c ].imag() : rowB[ c ].real() );
+  }
+
+  // b goes on to the next tile
+  if ( b != a ) {
+    std::swap( carried, s.next );
+    carriedIndex = b;
+  }
+}
+
+void spectralStream::synthesize( int index, std::complex< float >* out, scratch& s ) const {
+  const int rows = 2 * tileRows;
+  const int fieldColumns = shape->fieldColumns;
+  const std::vector< float >& amplitudes = shape->amplitudes;
+  std::vector< std::complex< float > >& work = s.work;
+  std::vector< std::complex< float > >& column = s.column;
+
+  // each bin its amplitude at a random phase - E| z |^2 = 2 power and E[ z^2 ] = 0, so either part
+  // of the sum has variance power and the two parts are uncorrelated. the phases are a hash of
+  // the bin, so a field doesn't depend on the order it is filled in
+  const uint64_t key = mix( ( uint64_t( uint32_t( seed ) ) << 32 ) | uint32_t( index ) );
+  work.resize( amplitudes.size() );
+  for ( size_t bin = 0; bin < amplitudes.size(); bin++ )
+    work[ bin ] = amplitudes[ bin ] * s.phases[ mix( key ^ bin ) >> ( 64 - phaseBits ) ];
+
+  // rows in work, then the columns a tile keeps through a contiguous copy, into out at its width
+  for ( int p = 0; p < rows; p++ )
+    shape->rowFFT( &work[ size_t( p ) * fieldColumns ] );
+  column.resize( rows );
+  for ( int q = 0; q < columns; q++ ) {
+    for ( int p = 0; p < rows; p++ ) column[ p ] = work[ size_t( p ) * fieldColumns + q ];
+    shape->columnFFT( column.data() );
+    for ( int p = 0; p < rows; p++ ) out[ size_t( p ) * columns + q ] = column[ p ];
+  }
+}
+
+spectralStream::spectrum::spectrum( int roadClass, double spacing, int columns )
+  : classIndex( roadClass ), spacing( spacing ), columns( columns ), fieldColumns( powerOfTwo( columns ) ),
+    rowFFT( fieldColumns ), columnFFT( 2 * tileRows ) {
+  const int rows = 2 * spectralStream::tileRows;
+  const double dky = 1.0 / ( rows * spacing );         // cycles per meter between bins, along the road
+  const double dkx = 1.0 / ( fieldColumns * spacing ); // and across it
+
+  // the isotropic surface whose profiles have the class's PSD has the two sided 2D PSD
+  // C | k |^-3 with C = Gd( n0 ) n0^2 / 4. a bin gets that integrated across its width, in
+  // closed form, and times its height - even at the low frequencies where | k |^-3 changes a lot
+  // over a bin. the frequencies across the road stop at the grid's nyquist, so each row of bins
+  // is scaled up by what was cut off, and the bins along every profile sum to its PSD exactly
+  const double C = roadClassRoughness( roadClass ) * referenceFrequency * referenceFrequency / 4.0;
+  auto across = []( double t, double a ) { return t / ( a * a * std::sqrt( t * t + a * a ) ); }; // integral of ( t^2 + a^2 )^-3/2
+  const double lowest = -( fieldColumns / 2 + 0.5 ) * dkx, highest = ( fieldColumns / 2 - 0.5 ) * dkx;
+  amplitudes.resize( size_t( rows ) * fieldColumns );
+  for ( int p = 0; p < rows; p++ ) {
+    const double ky = ( p < rows / 2 ? p : p - rows ) * dky;
+    const double cutOff = ky != 0.0 ? 2.0 / ( ky * ky ) / ( across( highest, ky ) - across( lowest, ky ) ) : 1.0;
+    for ( int q = 0; q < fieldColumns; q++ ) {
+      const double kx = ( q < fieldColumns / 2 ? q : q - fieldColumns ) * dkx;
+      double power = 0.0;
+      if ( ky != 0.0 )
+        power = C * dky * cutOff * ( across( kx + 0.5 * dkx, ky ) - across( kx - 0.5 * dkx, ky ) );
+      else if ( kx != 0.0 )
+        power = C * dkx * 2.0 * across( 0.5 * dky, kx );
+      amplitudes[ size_t( p ) * fieldColumns + q ] = float( std::sqrt( 2.0 * power ) );
+    }
+  }
+}
+
+spectralRoad::~spectralRoad() {
+  leave();
+}
+
+void spectralRoad::configure( int roadClass, int seed, double spacing, int columns ) {
+  if ( roadClass == classIndex && seed == this->seed && spacing == this->spacing && columns == this->columns )
+    return;
+  leave();
+  classIndex = roadClass;
+  this->seed = seed;
+  this->spacing = spacing;
+  this->columns = columns;
+  settingsVersion++;
+  shape = columns > 0 ? spectralStream::shapeFor( roadClass, spacing, columns ) : nullptr;
+}
+
+void spectralRoad::leave() {
+  if ( !stream ) return;
+  stream->leave( tile );
+  stream.reset();
+}
+
+void spectralRoad::read( float* out, int first, int count ) {
+  if ( columns == 0 ) return;
+  bool waited = false;
+  for ( int row = first; row < first + count; ) {
+    // a tile's rows at a time - moving on to it lets the stream drop the ones before, and a tile
+    // the stream can't hold means another stream, joined where it is needed
+    const int rowTile = floorDiv( row, tileRows );
+    if ( stream && rowTile != tile && stream->move( tile, rowTile ) )
+      tile = rowTile;
+    if ( !stream || rowTile != tile ) {
+      leave();
+      stream = spectralStream::join( shape, seed, rowTile );
+      tile = rowTile;
+      stream->prime();
+    }
+
+    const int last = std::min( first + count, ( tile + 1 ) * tileRows );
+    const float* source = stream->rows( tile, waited ) + size_t( row - tile * tileRows ) * columns;
+    std::copy( source, source + size_t( last - row ) * columns, out + size_t( row - first ) * columns );
+    row = last;
+  }
+  stalls += waited;
+}
@@ -0,0 +1,138 @@
+#ifndef SPECTRAL_ROAD
+#define SPECTRAL_ROAD
+
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// ISO 8608 road roughness classes - the displacement PSD of a class is Gd( n0 ) ( n / n0 )^-2,
+// n the spatial frequency in cycles per meter and n0 = 0.1, with Gd( n0 ) four times the last
+// class's from 16e-6 m^3 for A
+enum roadClass {
+	ROAD_CLASS_A,                         // very good
+	ROAD_CLASS_B,                         // good
+	ROAD_CLASS_C,                         // average
+	ROAD_CLASS_D,                         // poor
+	ROAD_CLASS_E,                         // very poor
+	ROAD_CLASS_F,
+	ROAD_CLASS_G,
+	ROAD_CLASS_H
+};
+
+// Gd( n0 ) of a class, m^3 - the geometric mean of its band
+double roadClassRoughness( int roadClass );
+
+// one road's tiles and the ring they are handed over in - readers of the same road ( class, seed,
+// spacing and columns ) near the same place share one, through spectralRoad. each reader holds
+// the tile it is reading, the ring keeps every tile from the earliest one held, and is filled up
+// to queueTiles past it
+//
+// a single producer thread makes the tiles of every stream, the one with the least lead first.
+// it sleeps on a condition variable while every ring is full, and a reader moving off the
+// earliest tile of its stream wakes it - readers sleep on another while the tile they want isn't
+// made yet. the thread starts with the first stream and is joined at exit. a stream keeps one
+// transform between tiles, at the width of a tile, and the streams of a class on the same grid
+// share its spectrum and FFT plans, so another seed costs its ring and that one transform
+class spectralStream {
+public:
+	static constexpr int tileRows = 1024;   // rows per tile, the fields span two
+	static constexpr int queueTiles = 4;    // tiles the producer can be ahead of the earliest reader
+
+	// the class's spectrum on a grid of spacing meters and columns wide - the transform size, its
+	// FFT plans and the amplitude of each bin. made once and shared while anything holds it
+	struct spectrum;
+	static std::shared_ptr< const spectrum > shapeFor( int roadClass, double spacing, int columns );
+
+	// a stream of the road that a reader can join at tile - a live one that keeps it or is about
+	// to make it, or a new one starting there. the reader is joined on return
+	static std::shared_ptr< spectralStream > join( const std::shared_ptr< const spectrum >& shape, int seed, int tile );
+
+	// a reader moves from tile from to tile to, false if the ring can't hold to for it - behind
+	// the tiles kept, or queueTiles or more past them. leave drops the reader at tile
+	bool move( int from, int to );
+	void leave( int tile );
+
+	// wait until the ring is full, so the reader starts queueTiles ahead of the producer
+	void prime();
+
+	// the rows of a tile the reader holds, waiting for them to be made - waited set if it did
+	const float* rows( int tile, bool& waited );
+
+	spectralStream( int seed, int firstTile, std::shared_ptr< const spectrum > shape );
+
+private:
+	const int seed;
+	const std::shared_ptr< const spectrum > shape;
+	const int columns;
+
+	// the ring - tile k is in slot k mod queueTiles while it is in [ kept, made ). kept is the
+	// earliest tile a reader holds, readers has an entry per reader, each the tile it holds. all
+	// of it under the producer's lock
+	std::vector< float > tiles;           // queueTiles x tileRows x columns
+	std::vector< int > readers;
+	int kept;
+	int made;
+
+	bool canHold( int tile ) const { return tile >= kept && tile < kept + queueTiles; }
+	void release();                       // kept up to the earliest reader, waking the producer if it moved
+
+	// producer side - the transform carried from the last tile to the next, holding fields
+	// 2 carriedIndex and 2 carriedIndex + 1, columns wide
+	std::vector< std::complex< float > > carried;
+	int carriedIndex;
+	struct scratch;                       // the producer's, for every stream
+	static void produce();
+	void make( int tile, scratch& s );
+	void synthesize( int index, std::complex< float >* out, scratch& s ) const;
+};
+
+// an endless road surface with the PSD of an ISO 8608 class, in tiles of rows streamed from a
+// producer thread - the rows and columns of a heightfieldCache's grid, in meters. each tile is
+// synthesized by inverse FFT: the amplitudes of the isotropic 2D extension of the class's PSD at
+// random phases, whose sum's real and imaginary parts are two uncorrelated fields, each periodic
+// over two tiles. consecutive fields are cross faded over a tile with sine and cosine weights, which
+// keeps the variance, so the road has no seams and the profile along every column follows the
+// class's PSD from the frequency of two tiles up to the grid's nyquist
+//
+// this is one reader's view of it - its tiles come from a spectralStream, shared with any other
+// reader of the same road near the same place. a tile depends on the settings, the seed and its
+// index alone, so the same road comes out whatever the timing and whichever stream made it
+class spectralRoad {
+public:
+	static constexpr int tileRows = spectralStream::tileRows;
+
+	spectralRoad() = default;
+	~spectralRoad();                      // leaves its stream
+
+	spectralRoad( const spectralRoad& ) = delete;
+	spectralRoad& operator=( const spectralRoad& ) = delete;
+
+	// the road to read - class, seed, grid spacing in meters and columns per row. a change leaves
+	// the stream, takes the spectrum and bumps version, the next read joins a stream of the new road
+	void configure( int roadClass, int seed, double spacing, int columns );
+	uint32_t version() const { return settingsVersion; }
+
+	// rows [ first, first + count ) into out, columns floats each, waiting on the producer if it
+	// is behind - rows are meant to be read in increasing order. the first read, and one its
+	// stream can't hold, joins a stream at the row's tile and waits for its ring to fill
+	void read( float* out, int first, int count );
+
+	int stalls = 0;                       // reads that waited on the producer, past a fill
+
+private:
+	// settings
+	int classIndex = -1;
+	int seed = 0;
+	double spacing = 0.0;
+	int columns = 0;
+	uint32_t settingsVersion = 0;
+	std::shared_ptr< const spectralStream::spectrum > shape;
+
+	std::shared_ptr< spectralStream > stream; // null until the first read after configure
+	int tile = 0;                         // the tile it holds in stream
+
+	void leave();
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "thread_pool.h"
+
+#include <climits>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static_assert( sizeof( std::atomic< uint32_t > ) == sizeof( uint32_t ) && std::atomic< uint32_t >::is_always_lock_free,
+  "futex words need to be plain 32 bit integers" );
+
+// how long a waiter spins before going to sleep - on the order of tens of microseconds,
+// enough to cover the gap between two dispatches in the same frame
+constexpr int spinIterations = 1 << 14;
+
+// pause inside the spin, and every so often give up the core, in case the thread being
+// waited on is runnable but has no core of its own ( more workers than hardware threads )
+static inline void cpuRelax( int iteration ) {
+  if ( ( iteration & 63 ) == 63 ) {
+    std::this_thread::yield();
+    return;
+  }
+#if defined( __x86_64__ ) || defined( __i386__ )
+  __builtin_ia32_pause();
+#endif
+}
+
+// sleep while *word == expected
+static void futexWait( std::atomic< uint32_t >* word, uint32_t expected ) {
+#ifdef __linux__
+  syscall( SYS_futex, reinterpret_cast< uint32_t* >( word ), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0 );
+#else
+  ( void ) word; ( void ) expected;
+  std::this_thread::yield();
+#endif
+}
+
+static void futexWake( std::atomic< uint32_t >* word, int count ) {
+#ifdef __linux__
+  syscall( SYS_futex, reinterpret_cast< uint32_t* >( word ), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0 );
+#else
+  ( void ) word; ( void ) count;
+#endif
+}
+
+threadPool::threadPool( int numWorkers ) : numWorkers( numWorkers < 1 ? 1 : numWorkers ) {
+  workers.reset( new worker[ this->numWorkers ] );
+  for ( int i = 1; i < this->numWorkers; i++ )
+    workers[ i ].thread = std::thread( &threadPool::workerLoop, this, i );
+}
+
+threadPool::~threadPool() {
+  quit.store( true, std::memory_order_relaxed );
+  generation.fetch_add( 1, std::memory_order_seq_cst );
+  futexWake( &generation, INT_MAX );
+  for ( int i = 1; i < numWorkers; i++ )
+    workers[ i ].thread.join();
+}
+
+void threadPool::blockRange( int workerIndex, int first, int last, int& blockFirst, int& blockLast ) const {
+  const long count = last - first;
+  blockFirst = first + int( ( count * workerIndex ) / numWorkers );
+  blockLast  = first + int( ( count * ( workerIndex + 1 ) ) / numWorkers );
+}
+
+void threadPool::dispatch( const std::function< void( int ) >& work ) {
+  if ( numWorkers == 1 ) {
+    work( 0 );
+    return;
+  }
+
+  // publish the job, then release the workers - the seq_cst increment pairs with the
+  // sleeper count, so a worker is either seen as asleep here or sees the new generation
+  job = &work;
+  remaining.store( numWorkers - 1, std::memory_order_relaxed );
+  generation.fetch_add( 1, std::memory_order_seq_cst );
+  if ( sleepingWorkers.load( std::memory_order_seq_cst ) != 0 )
+    futexWake( &generation, INT_MAX );
+
+  // do our share
+  work( 0 );
+
+  // join - spin first, the other blocks are usually about done
+  for ( int i = 0; i < spinIterations; i++ ) {
+    if ( remaining.load( std::memory_order_acquire ) == 0 )
+      return;
+    cpuRelax( i );
+  }
+  uint32_t left;
+  while ( ( left = remaining.load( std::memory_order_acquire ) ) != 0 ) {
+    callerSleeping.store( 1, std::memory_order_seq_cst );
+    futexWait( &remaining, left );
+    callerSleeping.store( 0, std::memory_order_relaxed );
+  }
+}
+
+void threadPool::workerLoop( int workerIndex ) {
+  uint32_t seen = 0;
+  while ( true ) {
+    // wait for the next generation
+    uint32_t current = generation.load( std::memory_order_acquire );
+    for ( int i = 0; i < spinIterations && current == seen; i++ ) {
+      cpuRelax( i );
+      current = generation.load( std::memory_order_acquire );
+    }
+    if ( current == seen ) {
+      sleepingWorkers.fetch_add( 1, std::memory_order_seq_cst );
+      while ( ( current = generation.load( std::memory_order_seq_cst ) ) == seen )
+        futexWait( &generation, seen );
+      sleepingWorkers.fetch_sub( 1, std::memory_order_relaxed );
+    }
+    seen = current;
+
+    if ( quit.load( std::memory_order_relaxed ) )
+      return;
+
+    ( *job )( workerIndex );
+
+    // the last one out wakes the dispatcher, if it went to sleep
+    if ( remaining.fetch_sub( 1, std::memory_order_acq_rel ) == 1 && callerSleeping.load( std::memory_order_seq_cst ) )
+      futexWake( &remaining, 1 );
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+
+constexpr size_t cacheLineSize = 64;
+
+// persistent fork / join pool - threads are created once and parked between dispatches.
+// waiting spins briefly and then sleeps on a futex, so back to back dispatches ( substeps,
+// vertex build ) cost microseconds, while an idle pool does not burn cores
+class threadPool {
+public:
+	explicit threadPool( int numWorkers = std::thread::hardware_concurrency() );
+	~threadPool();
+
+	threadPool( const threadPool& ) = delete;
+	threadPool& operator=( const threadPool& ) = delete;
+
+	// run job( workerIndex ) once for every index in [ 0, size() ), and return once all have
+	// finished - the calling thread does index 0 itself
+	void dispatch( const std::function< void( int ) >& job );
+
+	// split [ first, last ) into size() contiguous blocks, return the block for workerIndex
+	void blockRange( int workerIndex, int first, int last, int& blockFirst, int& blockLast ) const;
+
+	// run fn( item, workerIndex ) for every item in [ 0, count ), each worker taking one block
+	template < typename F >
+	void forEach( int count, F fn ) {
+		dispatch( [&]( int worker ) {
+			int first, last;
+			blockRange( worker, 0, count, first, last );
+			for ( int i = first; i < last; i++ )
+				fn( i, worker );
+		} );
+	}
+
+	int size() const { return numWorkers; }
+
+private:
+	void workerLoop( int workerIndex );
+
+	// per helper thread state, padded so neighboring workers do not share a line
+	struct alignas( cacheLineSize ) worker {
+		std::thread thread;
+	};
+
+	int numWorkers;
+	std::unique_ptr< worker[] > workers;  // index 0 unused, the dispatching thread is worker 0
+
+	// each shared word sits on its own cache line
+	alignas( cacheLineSize ) std::atomic< uint32_t > generation{ 0 };      // bumped once per dispatch
+	alignas( cacheLineSize ) std::atomic< uint32_t > sleepingWorkers{ 0 }; // workers parked on the futex
+	alignas( cacheLineSize ) std::atomic< uint32_t > remaining{ 0 };       // helpers still running the job
+	alignas( cacheLineSize ) std::atomic< uint32_t > callerSleeping{ 0 };  // dispatcher parked on the futex
+	alignas( cacheLineSize ) const std::function< void( int ) >* job = nullptr;
+	std::atomic< bool > quit{ false };
+};
+
+#endif
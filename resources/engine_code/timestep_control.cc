@@ -0,0 +1,256 @@
+#include "timestep_control.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+template < typename precision >
+void timeStepController< precision >::resize( const springTopology& topology ) {
+  along.resize( topology.numEdges );
+  across.resize( topology.numEdges );
+  ux.resize( topology.numEdges );
+  uy.resize( topology.numEdges );
+  uz.resize( topology.numEdges );
+  shockSlope.resize( topology.numEdges );
+  rootInverseMass.resize( topology.numNodes );
+  vx.resize( topology.numNodes ); vy.resize( topology.numNodes ); vz.resize( topology.numNodes );
+  kx.resize( topology.numNodes ); ky.resize( topology.numNodes ); kz.resize( topology.numNodes );
+  warm = false;
+
+  tick = 0;
+  windowEnergy = windowMotion = 0.0;
+  haveWindow = hold = false;
+  trust = 1.0f;
+  lastLimit = 0.0f;
+  lastSpectralRadius = 0;
+  shrinks = 0;
+}
+
+template < typename precision >
+template < typename law, typename damper >
+void timeStepController< precision >::edgeStiffness( const springTopology& topology, const lawParameters& spring,
+  const lawParameters& shock, const nodeState< storage >& current, int first, int last ) {
+
+  for ( int e = first; e < last; e++ ) {
+    const int n1 = topology.node1[ e ];
+    const int n2 = topology.node2[ e ];
+    const scalar dx = scalar( current.px[ n1 ] ) - current.px[ n2 ];
+    const scalar dy = scalar( current.py[ n1 ] ) - current.py[ n2 ];
+    const scalar dz = scalar( current.pz[ n1 ] ) - current.pz[ n2 ];
+    const scalar length = std::sqrt( dx * dx + dy * dy + dz * dz );
+    const scalar inverseLength = length > 0 ? 1 / length : 0;
+    ux[ e ] = dx * inverseLength; uy[ e ] = dy * inverseLength; uz[ e ] = dz * inverseLength;
+
+    // the implicit solver's H_e without the h^2 - the law's slope over L0 along the spring, the
+    // tension over L across it, neither below zero
+    const scalar stretch = length / topology.baseLength[ e ] - 1;
+    along[ e ] = std::max( scalar( 0 ), scalar( law::slope( stretch, spring ) ) ) / topology.baseLength[ e ];
+    across[ e ] = std::max( scalar( 0 ), scalar( law::force( stretch, spring ) ) ) * inverseLength;
+
+    // the shock's force per unit of extension speed, by its secant at the current speed
+    shockSlope[ e ] = 0;
+    if constexpr ( damper::active ) {
+      const scalar rate = ux[ e ] * ( scalar( current.vx[ n1 ] ) - current.vx[ n2 ] ) + uy[ e ] * ( scalar( current.vy[ n1 ] ) - current.vy[ n2 ] )
+                        + uz[ e ] * ( scalar( current.vz[ n1 ] ) - current.vz[ n2 ] );
+      shockSlope[ e ] = std::max( scalar( 0 ), rate != 0 ? scalar( damper::force( rate, shock ) ) / rate : scalar( shock.k ) );
+    }
+  }
+}
+
+template < typename precision >
+float timeStepController< precision >::stableTimeStep( const springTopology& topology, const springConstants& constants,
+  const alignedArray< scalar >& inverseMass, const alignedArray< scalar >& nodeDamping,
+  const nodeState< storage >& current, int firstNode, int integrator, int iterations ) {
+
+  for ( int b = 0; b < topology.partBatchStart[ topology.numParts ]; b++ ) {
+    const int m = topology.batchMaterial[ b ];
+    withForceLaw( constants.law[ m ], [&]( auto law ) {
+      withDamperLaw( constants.damper[ m ], [&]( auto damper ) {
+        edgeStiffness< decltype( law ), decltype( damper ) >( topology, constants.springLaw( m ), constants.shockLaw( m ),
+          current, topology.batchStart[ b ], topology.batchStart[ b + 1 ] );
+      } );
+    } );
+  }
+
+  // anchored nodes are fixed, with zero inverse mass they drop out of everything below
+  for ( int n = 0; n < topology.numNodes; n++ )
+    rootInverseMass[ n ] = std::sqrt( inverseMass[ n ] );
+
+  // gershgorin on M^-1/2 K M^-1/2 - each spring's block has norm max( along, across ), and shows
+  // up on the diagonal and, scaled by both masses, off it. the damping rate is bounded the same
+  // way, the drag on the node and both ends of each shock
+  scalar bound = 0, damping = 0;
+  for ( int n = firstNode; n < topology.numNodes; n++ ) {
+    if ( inverseMass[ n ] == 0 ) continue;
+    scalar row = 0, shocks = 0;
+    for ( int i = topology.rowStart[ n ]; i < topology.rowStart[ n + 1 ]; i++ ) {
+      const int e = topology.incidentEdge[ i ];
+      const int m = topology.neighbor[ i ];
+      row += std::max( along[ e ], across[ e ] ) * rootInverseMass[ n ] * ( rootInverseMass[ n ] + rootInverseMass[ m ] );
+      shocks += shockSlope[ e ];
+    }
+    bound = std::max( bound, row );
+    damping = std::max( damping, inverseMass[ n ] * ( nodeDamping[ n ] + 2 * shocks ) );
+  }
+
+  // a fixed spread of directions to start from, the same every run
+  if ( !warm ) {
+    for ( int n = 0; n < topology.numNodes; n++ ) {
+      const uint32_t hash = uint32_t( n + 1 ) * 2654435761u;
+      vx[ n ] = scalar( int( hash & 1023 ) - 511 );
+      vy[ n ] = scalar( int( ( hash >> 10 ) & 1023 ) - 511 );
+      vz[ n ] = scalar( int( ( hash >> 20 ) & 1023 ) - 511 );
+    }
+    iterations = std::max( iterations, initialIterations );
+    warm = true;
+  }
+
+  // power iteration on S = M^-1/2 K M^-1/2, v kept at unit length - the rayleigh quotient v.Sv
+  // closes in on the largest eigenvalue from below
+  scalar rayleigh = 0;
+  for ( int iteration = 0; iteration < iterations; iteration++ ) {
+    double norm = 0.0;
+    for ( int n = firstNode; n < topology.numNodes; n++ )
+      norm += double( vx[ n ] ) * vx[ n ] + double( vy[ n ] ) * vy[ n ] + double( vz[ n ] ) * vz[ n ];
+    if ( norm == 0.0 ) break;
+    const scalar scale = scalar( 1 / std::sqrt( norm ) );
+    for ( int n = 0; n < topology.numNodes; n++ ) {
+      vx[ n ] *= scale; vy[ n ] *= scale; vz[ n ] *= scale;
+      kx[ n ] = ky[ n ] = kz[ n ] = 0;
+    }
+
+    // K M^-1/2 v, spring by spring
+    for ( int e = 0; e < topology.numEdges; e++ ) {
+      const int n1 = topology.node1[ e ];
+      const int n2 = topology.node2[ e ];
+      const scalar s1 = rootInverseMass[ n1 ], s2 = rootInverseMass[ n2 ];
+      const scalar rx = s1 * vx[ n1 ] - s2 * vx[ n2 ];
+      const scalar ry = s1 * vy[ n1 ] - s2 * vy[ n2 ];
+      const scalar rz = s1 * vz[ n1 ] - s2 * vz[ n2 ];
+      const scalar d = ( along[ e ] - across[ e ] ) * ( ux[ e ] * rx + uy[ e ] * ry + uz[ e ] * rz );
+      const scalar fx = across[ e ] * rx + d * ux[ e ];
+      const scalar fy = across[ e ] * ry + d * uy[ e ];
+      const scalar fz = across[ e ] * rz + d * uz[ e ];
+      kx[ n1 ] += fx; ky[ n1 ] += fy; kz[ n1 ] += fz;
+      kx[ n2 ] -= fx; ky[ n2 ] -= fy; kz[ n2 ] -= fz;
+    }
+
+    // then M^-1/2 again, and the quotient against the unit v
+    double dot = 0.0;
+    for ( int n = firstNode; n < topology.numNodes; n++ ) {
+      const scalar s = rootInverseMass[ n ];
+      const scalar sx = s * kx[ n ], sy = s * ky[ n ], sz = s * kz[ n ];
+      dot += double( vx[ n ] ) * sx + double( vy[ n ] ) * sy + double( vz[ n ] ) * sz;
+      vx[ n ] = sx; vy[ n ] = sy; vz[ n ] = sz;
+    }
+    rayleigh = scalar( dot );
+  }
+  for ( int n = 0; n < firstNode; n++ )
+    vx[ n ] = vy[ n ] = vz[ n ] = 0;
+
+  // the quotient is short of the eigenvalue until the iteration converges, so it gets a margin,
+  // and the bound caps it
+  const scalar lambda = std::min( bound, scalar( 1.05 ) * std::max( rayleigh, scalar( 0 ) ) );
+  lastSpectralRadius = lambda;
+  if ( lambda <= 0 )
+    return std::numeric_limits< float >::infinity();
+
+  // velocity verlet takes the damping trapezoidally, it doesn't narrow the limit. the others
+  // take it explicitly - for x'' = -lambda x - gamma x', stable while h^2 lambda + 2 h gamma < 4
+  if ( integrator == VELOCITY_VERLET )
+    return float( 2 / std::sqrt( lambda ) );
+  return float( ( std::sqrt( damping * damping + 4 * lambda ) - damping ) / lambda );
+}
+
+template < typename precision >
+void timeStepController< precision >::energy( const springTopology& topology, const springConstants& constants,
+  const alignedArray< scalar >& inverseMass, const nodeState< storage >& current, int firstNode, float gravity,
+  double& total, double& motion ) const {
+
+  double kinetic = 0.0, potential = 0.0, springs = 0.0, weight = 0.0;
+  for ( int n = firstNode; n < topology.numNodes; n++ ) {
+    if ( inverseMass[ n ] == 0 ) continue;
+    const double mass = 1.0 / inverseMass[ n ];
+    kinetic += 0.5 * mass * ( double( current.vx[ n ] ) * current.vx[ n ] + double( current.vy[ n ] ) * current.vy[ n ]
+                            + double( current.vz[ n ] ) * current.vz[ n ] );
+    potential += mass * gravity * current.py[ n ]; // the integrators accelerate by - gravity in y
+    weight += mass * std::abs( gravity );
+  }
+
+  // the work to stretch each spring to its length, F x L0 / 2 - exact for hooke's law, close
+  // enough for the others to track a trend
+  for ( int b = 0; b < topology.partBatchStart[ topology.numParts ]; b++ ) {
+    const int m = topology.batchMaterial[ b ];
+    const lawParameters spring = constants.springLaw( m );
+    withForceLaw( constants.law[ m ], [&]( auto law ) {
+      using policy = decltype( law );
+      for ( int e = topology.batchStart[ b ]; e < topology.batchStart[ b + 1 ]; e++ ) {
+        const int n1 = topology.node1[ e ];
+        const int n2 = topology.node2[ e ];
+        const scalar dx = scalar( current.px[ n1 ] ) - current.px[ n2 ];
+        const scalar dy = scalar( current.py[ n1 ] ) - current.py[ n2 ];
+        const scalar dz = scalar( current.pz[ n1 ] ) - current.pz[ n2 ];
+        const scalar stretch = std::sqrt( dx * dx + dy * dy + dz * dz ) / topology.baseLength[ e ] - 1;
+        springs += 0.5 * double( policy::force( stretch, spring ) ) * stretch * topology.baseLength[ e ];
+      }
+    } );
+  }
+
+  total = kinetic + springs + potential;
+  motion = kinetic + springs + 1e-4 * weight;
+}
+
+template < typename precision >
+float timeStepController< precision >::next( const springTopology& topology, const springConstants& constants,
+  const alignedArray< scalar >& inverseMass, const alignedArray< scalar >& nodeDamping,
+  const nodeState< storage >& current, int firstNode, int integrator, int substeps, float gravity,
+  float timeStep, float maxTimeStep, float safety, float energyTolerance ) {
+
+  // the first window is a single tick, so the tick size is settled straight away
+  tick++;
+  if ( tick <= windowTicks - energyTicks && haveWindow )
+    return timeStep;
+  double total, motion;
+  energy( topology, constants, inverseMass, current, firstNode, gravity, total, motion );
+  windowEnergy += total;
+  windowMotion += motion;
+  if ( tick < windowTicks && haveWindow )
+    return timeStep;
+
+  // end of the window - compare its energy to the last one's
+  const int samples = haveWindow ? energyTicks : 1;
+  const double meanEnergy = windowEnergy / samples;
+  const double meanMotion = windowMotion / samples;
+  const bool blowup = haveWindow && meanEnergy - lastWindowEnergy > energyTolerance * std::max( meanMotion, lastWindowMotion );
+  const bool first = !haveWindow;
+  lastWindowEnergy = meanEnergy;
+  lastWindowMotion = meanMotion;
+  haveWindow = true;
+  windowEnergy = windowMotion = 0.0;
+  tick = 0;
+
+  lastLimit = substeps > 0
+    ? substeps * stableTimeStep( topology, constants, inverseMass, nodeDamping, current, firstNode, integrator, refreshIterations )
+    : std::numeric_limits< float >::infinity();
+  trust = blowup ? 0.7f * trust : std::min( 1.0f, 1.02f * trust );
+  const float cap = std::min( maxTimeStep, trust * safety * lastLimit );
+
+  float h;
+  if ( blowup ) {
+    h = 0.5f * timeStep;
+    hold = true;
+    shrinks++;
+  } else if ( hold ) {
+    h = timeStep;
+    hold = false;
+  } else {
+    h = first ? cap : 1.25f * timeStep;
+  }
+
+  // the limit wins over the floor
+  return std::min( std::max( h, 1e-3f * maxTimeStep ), cap );
+}
+
+template class timeStepController< singlePrecision >;
+template class timeStepController< mixedPrecision >;
+template class timeStepController< doublePrecision >;
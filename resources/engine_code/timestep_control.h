@@ -0,0 +1,88 @@
+#ifndef TIMESTEP_CONTROL
+#define TIMESTEP_CONTROL
+
+#include "softbody_kernels.h"
+
+// adaptive tick size - the explicit integrators are stable while h omega stays under about 2,
+// omega^2 the largest eigenvalue of M^-1 K, the springs' stiffness over the node masses. that
+// is bounded from above per node ( gershgorin, over each incident spring's k / L0 and the masses
+// at both ends ) and from below by power iteration on M^-1/2 K M^-1/2, warm started from the
+// last estimate so a few iterations per window keep up. K is the springs' tangent stiffness at
+// the current state, as the implicit solver assembles it, so stiffening laws lower the limit
+// as they load up, and the drag and shocks shave a little off it
+//
+// the tick is held for a window of ticks, then set from the limit and an energy indicator - the
+// mechanical energy ( kinetic, springs, gravity ) averaged over the last few ticks of the window,
+// enough to smooth the tick to tick swing the explicit integrators have near the limit. damping only takes
+// energy out and the road puts it in slowly, so a window that gains more than energyTolerance
+// of the energy in motion is taken as the start of a blowup, and the tick is halved. otherwise
+// it grows toward safety times the limit, capped at maxTimeStep. a blowup under the cap means the
+// estimate was optimistic, so the cap is scaled back by a trust factor, which recovers slowly
+// over calm windows. the multirate solver kicks its stiffest nodes up to 2^( levels - 1 ) times a
+// tick, so its limit is that many explicit ones - past it even the top level is unstable. the
+// implicit solver and XPBD have no limit, for those the maxTimeStep cap and the indicator alone
+// steer it
+//
+// the tick changes only between windows, and by a factor of 2 or 1.25 at most - position verlet,
+// whose update reaches back over the last tick, is handed both and scales its difference to fit
+template < typename precision >
+class timeStepController {
+public:
+	using storage = typename precision::storage;
+	using scalar  = typename precision::accumulator;
+
+	static constexpr int windowTicks = 16;       // ticks between changes of the tick size
+	static constexpr int energyTicks = 2;        // ticks at the end of each window the energy is averaged over
+	static constexpr int refreshIterations = 2;  // power iterations per window, after the first estimate
+	static constexpr int initialIterations = 40; // from a cold start
+
+	// size the per node and per edge storage, and drop the estimate and energy history
+	void resize( const springTopology& topology );
+
+	// called after each tick, with the state it produced and the tick it took - returns the tick
+	// to take next. integrator is the integratorType the limit is for, substeps the kicks a tick
+	// can be split into for the stiffest nodes - 1 for the explicit solver, 0 for no limit
+	float next( const springTopology& topology, const springConstants& constants,
+		const alignedArray< scalar >& inverseMass, const alignedArray< scalar >& nodeDamping,
+		const nodeState< storage >& current, int firstNode, int integrator, int substeps, float gravity,
+		float timeStep, float maxTimeStep, float safety, float energyTolerance );
+
+	// the largest stable tick for the explicit integrators, as of the last estimate
+	float stableTimeStep( const springTopology& topology, const springConstants& constants,
+		const alignedArray< scalar >& inverseMass, const alignedArray< scalar >& nodeDamping,
+		const nodeState< storage >& current, int firstNode, int integrator, int iterations );
+
+	float lastLimit = 0.0f;               // stableTimeStep times the substeps at the last window, zero before the first
+	scalar lastSpectralRadius = 0;        // omega^2, the power iteration's and gershgorin's smaller
+	int shrinks = 0;                      // windows the energy indicator halved the tick in
+
+private:
+	// per edge tangent stiffness along and across the spring, its direction, and the shock's slope
+	alignedArray< scalar > along, across, ux, uy, uz, shockSlope;
+
+	// power iteration vector, kept as the next estimate's warm start, and its product with K
+	alignedArray< scalar > rootInverseMass; // M^-1/2
+	alignedArray< scalar > vx, vy, vz;
+	alignedArray< scalar > kx, ky, kz;
+	bool warm = false;
+
+	int tick = 0;                         // ticks into the current window
+	double windowEnergy = 0.0;            // sums over the window's last energyTicks, of the mechanical energy
+	double windowMotion = 0.0;            // and of the kinetic and spring energy alone, plus a floor
+	double lastWindowEnergy = 0.0;        // averages of the last window
+	double lastWindowMotion = 0.0;
+	bool haveWindow = false;
+	bool hold = false;                    // don't grow at the end of the window after a shrink
+	float trust = 1.0f;                   // scales the cap, lowered by each blowup
+
+	template < typename law, typename damper >
+	void edgeStiffness( const springTopology& topology, const lawParameters& spring, const lawParameters& shock,
+		const nodeState< storage >& current, int first, int last );
+
+	// kinetic + spring + gravity, and kinetic + spring plus the energy of lifting every free node
+	// a tenth of a millimeter against gravity, so a chassis at rest has a scale to compare to
+	void energy( const springTopology& topology, const springConstants& constants, const alignedArray< scalar >& inverseMass,
+		const nodeState< storage >& current, int firstNode, float gravity, double& total, double& motion ) const;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "vehicle_pack.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#endif
+
+// one component of one node across the lanes - gcc vector arithmetic, so the same kernel source
+// compiles to whole AVX registers, SSE pairs, or the baseline, by the target it is inlined into
+typedef float laneRow __attribute__(( vector_size( packLanes * sizeof( float ) ), may_alias ));
+
+static inline laneRow& row( float* base, int index ) { return *reinterpret_cast< laneRow* >( base + index * packLanes ); }
+static inline const laneRow& row( const float* base, int index ) { return *reinterpret_cast< const laneRow* >( base + index * packLanes ); }
+
+// the one operation without a vector operator, per instruction set - in place, since a 32 byte
+// vector passed by value changes the calling convention between targets
+struct baselineRows {
+  static inline void sqrt( laneRow& x ) {
+    for ( int l = 0; l < packLanes; l++ )
+      x[ l ] = std::sqrt( x[ l ] );
+  }
+};
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+struct sse42Rows {
+  __attribute__(( target( "sse4.2" ) ))
+  static inline void sqrt( laneRow& x ) {
+    __m128* half = reinterpret_cast< __m128* >( &x );
+    half[ 0 ] = _mm_sqrt_ps( half[ 0 ] );
+    half[ 1 ] = _mm_sqrt_ps( half[ 1 ] );
+  }
+};
+
+struct avx2Rows {
+  __attribute__(( target( "avx2" ) ))
+  static inline void sqrt( laneRow& x ) {
+    __m256* whole = reinterpret_cast< __m256* >( &x );
+    whole[ 0 ] = _mm256_sqrt_ps( whole[ 0 ] );
+  }
+};
+#endif
+
+// everything a pack tick needs, unpacked to raw pointers
+struct packTickArgs {
+  const int* n1; const int* n2;
+  const float* baseLength;
+  const int* batchStart; const int* batchMaterial;
+  int numBatches, numAnchored, numNodes;
+  const float* springK; const float* shockK; const float* drag;
+  const std::vector< bool >* shocked;
+  const float* inverseMass; const float* damping;
+  const float* timeStep; const float* previousTimeStep; const float* gravity;
+  const float* px; const float* py; const float* pz;
+  const float* vx; const float* vy; const float* vz;
+  float* nextPx; float* nextPy; float* nextPz;
+  float* nextVx; float* nextVy; float* nextVz;
+  float* fx; float* fy; float* fz;
+};
+
+// springPassScalar on rows, for the linear law - the force of every spring is scattered to both
+// endpoints, a pack runs the parts of the graph one after the other
+template < typename rows, bool shock >
+__attribute__(( always_inline ))
+static inline void springRows( const packTickArgs& a, int first, int last, int m ) {
+  const laneRow k = row( a.springK, m ), c = row( a.shockK, m ), d = row( a.drag, m );
+  for ( int e = first; e < last; e++ ) {
+    const int n1 = a.n1[ e ];
+    const int n2 = a.n2[ e ];
+
+    const laneRow dx = row( a.px, n1 ) - row( a.px, n2 );
+    const laneRow dy = row( a.py, n1 ) - row( a.py, n2 );
+    const laneRow dz = row( a.pz, n1 ) - row( a.pz, n2 );
+    laneRow length = dx * dx + dy * dy + dz * dz;
+    rows::sqrt( length );
+
+    laneRow tension = k * ( length / a.baseLength[ e ] - 1.0f );
+    if constexpr ( shock ) {
+      const laneRow rate = ( dx * ( row( a.vx, n1 ) - row( a.vx, n2 ) ) + dy * ( row( a.vy, n1 ) - row( a.vy, n2 ) )
+                           + dz * ( row( a.vz, n1 ) - row( a.vz, n2 ) ) ) / length;
+      tension += c * rate;
+    }
+    const laneRow scale = -tension / length;
+    const laneRow sx = scale * dx, sy = scale * dy, sz = scale * dz;
+
+    row( a.fx, n1 ) += sx - d * row( a.vx, n1 );
+    row( a.fy, n1 ) += sy - d * row( a.vy, n1 );
+    row( a.fz, n1 ) += sz - d * row( a.vz, n1 );
+    row( a.fx, n2 ) -= sx + d * row( a.vx, n2 );
+    row( a.fy, n2 ) -= sy + d * row( a.vy, n2 );
+    row( a.fz, n2 ) -= sz + d * row( a.vz, n2 );
+  }
+}
+
+// one tick - the spring pass a batch at a time, then integrateNodes on rows
+template < typename rows, integratorType integrator >
+__attribute__(( always_inline ))
+static inline void packTick( const packTickArgs& a ) {
+  for ( int b = 0; b < a.numBatches; b++ ) {
+    const int m = a.batchMaterial[ b ];
+    if ( ( *a.shocked )[ m ] )
+      springRows< rows, true >( a, a.batchStart[ b ], a.batchStart[ b + 1 ], m );
+    else
+      springRows< rows, false >( a, a.batchStart[ b ], a.batchStart[ b + 1 ], m );
+  }
+
+  using rule = integrationRule< integrator >;
+  const laneRow h = row( a.timeStep, 0 ), hPrevious = row( a.previousTimeStep, 0 ), gravity = row( a.gravity, 0 ), zero = {};
+  for ( int n = a.numAnchored; n < a.numNodes; n++ ) {
+    const laneRow inverseMass = row( a.inverseMass, n );
+    const laneRow ax = row( a.fx, n ) * inverseMass;
+    const laneRow ay = row( a.fy, n ) * inverseMass - gravity;
+    const laneRow az = row( a.fz, n ) * inverseMass;
+    const laneRow gamma = row( a.damping, n ) * inverseMass;
+    row( a.fx, n ) = row( a.fy, n ) = row( a.fz, n ) = zero;
+
+    rule::apply( row( a.px, n ), row( a.vx, n ), ax, gamma, row( a.nextPx, n ), row( a.nextVx, n ), h, hPrevious );
+    rule::apply( row( a.py, n ), row( a.vy, n ), ay, gamma, row( a.nextPy, n ), row( a.nextVy, n ), h, hPrevious );
+    rule::apply( row( a.pz, n ), row( a.vz, n ), az, gamma, row( a.nextPz, n ), row( a.nextVz, n ), h, hPrevious );
+  }
+  for ( int n = 0; n < a.numAnchored; n++ )
+    row( a.fx, n ) = row( a.fy, n ) = row( a.fz, n ) = zero;
+}
+
+// the tick compiled for each instruction set - fma is left off, so no target contracts the
+// multiply adds that the scalar kernel rounds separately
+template < integratorType integrator >
+static void packTickBaseline( const packTickArgs& a ) { packTick< baselineRows, integrator >( a ); }
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+template < integratorType integrator >
+__attribute__(( target( "sse4.2" ) ))
+static void packTickSSE42( const packTickArgs& a ) { packTick< sse42Rows, integrator >( a ); }
+
+template < integratorType integrator >
+__attribute__(( target( "avx2" ) ))
+static void packTickAVX2( const packTickArgs& a ) { packTick< avx2Rows, integrator >( a ); }
+#endif
+
+// picks the instruction set by setSpringKernel, like the spring pass - every lane result is
+// the same on each, they differ only in speed
+template < integratorType integrator >
+static void packTickActive( const packTickArgs& a ) {
+#if defined( __x86_64__ ) || defined( __i386__ )
+  switch ( currentSpringKernel() ) {
+    case AVX512:
+    case AVX2:  packTickAVX2< integrator >( a );  return;
+    case SSE42: packTickSSE42< integrator >( a ); return;
+    default: break;
+  }
+#endif
+  packTickBaseline< integrator >( a );
+}
+
+vehiclePack::vehiclePack( std::shared_ptr< const vehicleGraph > graph ) : sharedGraph( std::move( graph ) ) {
+  const size_t nodeRows = sharedGraph->nodes.size() * packLanes;
+  state.resize( nodeRows );
+  forces.resize( nodeRows );
+  inverseMass.resize( nodeRows );
+  nodeDamping.resize( nodeRows );
+
+  const int numMaterials = std::max( sharedGraph->topology.numMaterials, 1 );
+  springK.resize( numMaterials * packLanes );
+  shockK.resize( numMaterials * packLanes );
+  drag.resize( numMaterials * packLanes );
+  shocked.resize( numMaterials );
+
+  timeStep.resize( packLanes );
+  previousTimeStep.resize( packLanes );
+  gravity.resize( packLanes );
+}
+
+bool vehiclePack::Packable( const softbodySimulation& s ) const {
+  if ( s.sharedGraph != sharedGraph || s.activePrecision != SINGLE_PRECISION ||
+       s.simParameters.solver != EXPLICIT_EULER || s.simParameters.logChecksums || s.simParameters.adaptiveTimeStep )
+    return false;
+  for ( int m = 0; m < sharedGraph->topology.numMaterials; m++ )
+    if ( s.frameConstants.law[ m ] != LINEAR_SPRING || s.frameConstants.damper[ m ] == TABULATED_DAMPER )
+      return false;
+  return true;
+}
+
+void vehiclePack::Load( softbodySimulation* const* lanes, int count ) {
+  const int numNodes = sharedGraph->nodes.size();
+  const int numMaterials = sharedGraph->topology.numMaterials;
+  std::fill( shocked.begin(), shocked.end(), false );
+
+  // lanes past count repeat the last vehicle, and are never copied back
+  for ( int l = 0; l < packLanes; l++ ) {
+    softbodySimulation& s = *lanes[ std::min( l, count - 1 ) ];
+    if ( s.simParameters.chassisNodeMass != s.inverseMassSource )
+      s.RefreshInverseMass();
+    const simulationBuffers< singlePrecision >& b = s.singleBuffers;
+
+    auto in = [&]( nodeState< float >& to, const nodeState< float >& from ) {
+      for ( int n = 0; n < numNodes; n++ ) {
+        const int i = n * packLanes + l;
+        to.px[ i ] = from.px[ n ]; to.py[ i ] = from.py[ n ]; to.pz[ i ] = from.pz[ n ];
+        to.vx[ i ] = from.vx[ n ]; to.vy[ i ] = from.vy[ n ]; to.vz[ i ] = from.vz[ n ];
+      }
+    };
+    in( state.current(), b.state.current() );
+    in( state.next(), b.state.next() );
+    for ( int n = 0; n < numNodes; n++ ) {
+      inverseMass[ n * packLanes + l ] = b.inverseMass[ n ];
+      nodeDamping[ n * packLanes + l ] = b.nodeDamping[ n ];
+    }
+
+    const springConstants& constants = s.frameConstants;
+    for ( int m = 0; m < numMaterials; m++ ) {
+      const bool shock = constants.damper[ m ] == LINEAR_DAMPER;
+      springK[ m * packLanes + l ] = constants.spring[ m ].k;
+      shockK[ m * packLanes + l ]  = shock ? constants.shock[ m ].k : 0.0f;
+      drag[ m * packLanes + l ]    = constants.d[ m ];
+      shocked[ m ] = shocked[ m ] || shock;
+    }
+    timeStep[ l ] = s.simParameters.timeScale;
+    previousTimeStep[ l ] = s.PreviousTimeStep();
+    gravity[ l ]  = s.simParameters.gravity;
+  }
+}
+
+void vehiclePack::Store( softbodySimulation* const* lanes, int count ) {
+  const int numNodes = sharedGraph->nodes.size();
+  for ( int l = 0; l < count; l++ ) {
+    simulationBuffers< singlePrecision >& b = lanes[ l ]->singleBuffers;
+    auto out = [&]( nodeState< float >& to, const nodeState< float >& from ) {
+      for ( int n = 0; n < numNodes; n++ ) {
+        const int i = n * packLanes + l;
+        to.px[ n ] = from.px[ i ]; to.py[ n ] = from.py[ i ]; to.pz[ n ] = from.pz[ i ];
+        to.vx[ n ] = from.vx[ i ]; to.vy[ n ] = from.vy[ i ]; to.vz[ n ] = from.vz[ i ];
+      }
+    };
+    out( b.state.current(), state.current() );
+    out( b.state.next(), state.next() );
+  }
+}
+
+void vehiclePack::Step( softbodySimulation* const* lanes, int count, int ticks ) {
+  if ( count <= 0 ) return;
+  count = std::min( count, packLanes );
+  Load( lanes, count );
+
+  const springTopology& topology = sharedGraph->topology;
+  const int numAnchored = sharedGraph->numAnchored;
+  const int integrator = lanes[ 0 ]->simParameters.integrator;
+
+  packTickArgs a;
+  a.n1 = topology.node1.data(); a.n2 = topology.node2.data();
+  a.baseLength = topology.baseLength.data();
+  a.batchStart = topology.batchStart.data(); a.batchMaterial = topology.batchMaterial.data();
+  a.numBatches = topology.partBatchStart[ topology.numParts ];
+  a.numAnchored = numAnchored;
+  a.numNodes = sharedGraph->nodes.size();
+  a.springK = springK.data(); a.shockK = shockK.data(); a.drag = drag.data();
+  a.shocked = &shocked;
+  a.inverseMass = inverseMass.data(); a.damping = nodeDamping.data();
+  a.timeStep = timeStep.data(); a.previousTimeStep = previousTimeStep.data(); a.gravity = gravity.data();
+  a.fx = forces.fx.data(); a.fy = forces.fy.data(); a.fz = forces.fz.data();
+
+  for ( int t = 0; t < ticks; t++ ) {
+    nodeState< float >& current = state.current();
+    nodeState< float >& next = state.next();
+
+    // wheel heights, each lane from its own road, as in softbodySimulation::Substep
+    for ( int l = 0; l < count; l++ ) {
+      softbodySimulation& s = *lanes[ l ];
+      s.noiseOffset += s.NoiseStep();
+      s.ScrollRoad();
+      s.PlaceWheels( current, packLanes, l );
+    }
+    for ( int l = count; l < packLanes; l++ )
+      for ( int i = 0; i < numAnchored; i++ )
+        current.py[ i * packLanes + l ] = current.py[ i * packLanes + count - 1 ];
+
+    a.px = current.px.data(); a.py = current.py.data(); a.pz = current.pz.data();
+    a.vx = current.vx.data(); a.vy = current.vy.data(); a.vz = current.vz.data();
+    a.nextPx = next.px.data(); a.nextPy = next.py.data(); a.nextPz = next.pz.data();
+    a.nextVx = next.vx.data(); a.nextVy = next.vy.data(); a.nextVz = next.vz.data();
+    switch ( integrator ) {
+      case POSITION_VERLET: packTickActive< POSITION_VERLET >( a ); break;
+      case VELOCITY_VERLET: packTickActive< VELOCITY_VERLET >( a ); break;
+      default:              packTickActive< SEMI_IMPLICIT_EULER >( a ); break;
+    }
+
+    next.copyRange( current, 0, numAnchored * packLanes ); // anchored nodes carry over
+    state.swap();
+    a.previousTimeStep = a.timeStep;
+  }
+
+  Store( lanes, count );
+  for ( int l = 0; l < count; l++ ) {
+    lanes[ l ]->tickCount += ticks;
+    lanes[ l ]->simulatedTime += double( ticks ) * lanes[ l ]->simParameters.timeScale;
+    if ( ticks > 0 ) lanes[ l ]->lastTimeStep = lanes[ l ]->simParameters.timeScale;
+  }
+}
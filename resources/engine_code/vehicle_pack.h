@@ -0,0 +1,58 @@
+#ifndef VEHICLE_PACK
+#define VEHICLE_PACK
+
+#include "softbody_simulation.h"
+
+#include <memory>
+
+// vehicles per pack - a node's row of one component is 8 floats, one AVX register
+constexpr int packLanes = 8;
+
+// a small chassis vectorizes poorly one vehicle at a time, every spring gathers its endpoints
+// from scattered nodes. across vehicles it doesn't - packLanes simulations of one graph are
+// interleaved node by node ( AoSoA: component c of node n in lane l at n * packLanes + l ), so
+// a spring reads whole rows at the shared indices, one lane per vehicle, with no gathers and
+// no lanes wasted on the remainder of a batch. the lane kernel is the scalar spring pass and
+// integrateNodes done on rows, operation for operation, so with a one part graph each lane
+// matches the vehicle stepped alone on the scalar kernel bit for bit
+//
+// the per lane parameters are the explicit solver's - spring and shock rates, drag, masses,
+// tick size, gravity and the road. the laws are instantiated per pack, so the lanes need to
+// share them, see Packable
+class vehiclePack {
+public:
+	explicit vehiclePack( std::shared_ptr< const vehicleGraph > graph );
+
+	// whether s can run in a lane of a pack of this graph - single precision, explicit solver at a
+	// fixed tick, linear springs with no or linear shocks, no per tick logging
+	bool Packable( const softbodySimulation& s ) const;
+
+	// ticks on count <= packLanes packable simulations sharing an integrator, through one pack -
+	// their state is copied in, stepped together, and copied back, along with their road and
+	// tick count. a parameter edited between calls applies from the next
+	void Step( softbodySimulation* const* lanes, int count, int ticks );
+
+private:
+	std::shared_ptr< const vehicleGraph > sharedGraph;
+
+	stateBuffers< float > state;          // every lane's nodes, rows of packLanes
+	forceAccumulator< float > forces;
+	alignedArray< float > inverseMass;    // per node row, zero for anchored nodes
+	alignedArray< float > nodeDamping;    // per node row, summed drag of the incident edges
+
+	// per material row
+	alignedArray< float > springK;        // linear spring rate
+	alignedArray< float > shockK;         // linear shock rate, zero in lanes without one
+	alignedArray< float > drag;           // damping factor
+	std::vector< bool > shocked;          // any lane has a shock on the material
+
+	// one row each
+	alignedArray< float > timeStep;
+	alignedArray< float > previousTimeStep; // each lane's lastTimeStep, for the first tick of a Step
+	alignedArray< float > gravity;
+
+	void Load( softbodySimulation* const* lanes, int count );
+	void Store( softbodySimulation* const* lanes, int count );
+};
+
+#endif
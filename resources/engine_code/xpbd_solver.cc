@@ -0,0 +1,202 @@
+#include "xpbd_solver.h"
+
+#include <algorithm>
+#include <cmath>
+
+template < typename precision >
+void xpbdSolver< precision >::resize( const springTopology& topology ) {
+  lambda.resize( topology.numEdges );
+  for ( int i = 0; i < 3; i++ ) {
+    crossCorrection[ i ].resize( topology.numEdges );
+    previous[ i ].resize( topology.numNodes );
+  }
+  drag.resize( topology.numNodes );
+
+  crossDegree.resize( topology.numNodes );
+  for ( int n = 0; n < topology.numNodes; n++ )
+    crossDegree[ n ] = 0;
+  for ( int p = 0; p < topology.numParts; p++ )
+    for ( int e = topology.partCrossStart[ p ]; e < topology.partEdgeStart[ p + 1 ]; e++ )
+      crossDegree[ topology.node1[ e ] ] += 1, crossDegree[ topology.node2[ e ] ] += 1;
+  for ( int n = 0; n < topology.numNodes; n++ )
+    crossDegree[ n ] = std::max( crossDegree[ n ], scalar( 1 ) );
+}
+
+// delta lambda for one constraint, and the unit gradient, from the current positions - the
+// endpoints' inverse masses are scaled by split1, split2 in the denominator
+template < typename storage, typename scalar >
+static inline scalar constraintStep( const springTopology& topology, const scalar* complianceScale,
+  const alignedArray< scalar >& inverseMass, const nodeState< storage >& s, scalar lambda, int e, scalar split1, scalar split2,
+  scalar& nx, scalar& ny, scalar& nz ) {
+
+  const int n1 = topology.node1[ e ];
+  const int n2 = topology.node2[ e ];
+  const scalar dx = scalar( s.px[ n1 ] ) - s.px[ n2 ];
+  const scalar dy = scalar( s.py[ n1 ] ) - s.py[ n2 ];
+  const scalar dz = scalar( s.pz[ n1 ] ) - s.pz[ n2 ];
+  const scalar length = std::sqrt( dx * dx + dy * dy + dz * dz );
+  const scalar inverseLength = length > 0 ? 1 / length : 0;
+  nx = dx * inverseLength; ny = dy * inverseLength; nz = dz * inverseLength;
+
+  // alpha tilde = compliance / h^2, compliance = L0 / k
+  const scalar alpha = topology.baseLength[ e ] * complianceScale[ topology.material[ e ] ];
+  const scalar weight = inverseMass[ n1 ] * split1 + inverseMass[ n2 ] * split2 + alpha;
+  if ( weight == 0 ) return 0;
+  return ( topology.baseLength[ e ] - length - alpha * lambda ) / weight;
+}
+
+template < typename precision >
+inline void xpbdSolver< precision >::projectEdge( const springTopology& topology, const alignedArray< scalar >& inverseMass,
+  nodeState< storage >& next, int e ) {
+
+  scalar nx, ny, nz;
+  const scalar dLambda = constraintStep( topology, complianceScale.data(), inverseMass, next, lambda[ e ], e, scalar( 1 ), scalar( 1 ), nx, ny, nz );
+  lambda[ e ] += dLambda;
+
+  // either end may be anchored, shared between parts - it has zero inverse mass, leave it alone
+  const int n1 = topology.node1[ e ];
+  const int n2 = topology.node2[ e ];
+  if ( inverseMass[ n1 ] != 0 ) {
+    const scalar w1 = inverseMass[ n1 ] * dLambda;
+    next.px[ n1 ] += w1 * nx; next.py[ n1 ] += w1 * ny; next.pz[ n1 ] += w1 * nz;
+  }
+  if ( inverseMass[ n2 ] != 0 ) {
+    const scalar w2 = inverseMass[ n2 ] * dLambda;
+    next.px[ n2 ] -= w2 * nx; next.py[ n2 ] -= w2 * ny; next.pz[ n2 ] -= w2 * nz;
+  }
+}
+
+template < typename precision >
+void xpbdSolver< precision >::projectInterior( const springTopology& topology, const alignedArray< scalar >& inverseMass,
+  nodeState< storage >& next, int first, int last ) {
+  for ( int e = first; e < last; e++ )
+    projectEdge( topology, inverseMass, next, e );
+}
+
+template < typename precision >
+void xpbdSolver< precision >::projectCross( const springTopology& topology, const alignedArray< scalar >& inverseMass,
+  const nodeState< storage >& next, int first, int last ) {
+
+  for ( int e = first; e < last; e++ ) {
+    scalar nx, ny, nz;
+    const scalar dLambda = constraintStep( topology, complianceScale.data(), inverseMass, next, lambda[ e ], e,
+      crossDegree[ topology.node1[ e ] ], crossDegree[ topology.node2[ e ] ], nx, ny, nz );
+    lambda[ e ] += dLambda;
+    crossCorrection[ 0 ][ e ] = dLambda * nx;
+    crossCorrection[ 1 ][ e ] = dLambda * ny;
+    crossCorrection[ 2 ][ e ] = dLambda * nz;
+  }
+}
+
+template < typename precision >
+void xpbdSolver< precision >::applyCross( const springTopology& topology, const alignedArray< scalar >& inverseMass,
+  nodeState< storage >& next, int part ) {
+  for ( int e = topology.partCrossStart[ part ]; e < topology.partEdgeStart[ part + 1 ]; e++ ) {
+    const int n1 = topology.node1[ e ];
+    next.px[ n1 ] += inverseMass[ n1 ] * crossCorrection[ 0 ][ e ];
+    next.py[ n1 ] += inverseMass[ n1 ] * crossCorrection[ 1 ][ e ];
+    next.pz[ n1 ] += inverseMass[ n1 ] * crossCorrection[ 2 ][ e ];
+  }
+  for ( int h = topology.haloStart[ part ]; h < topology.haloStart[ part + 1 ]; h++ ) {
+    const int e = topology.haloEdge[ h ];
+    const int n2 = topology.node2[ e ];
+    next.px[ n2 ] -= inverseMass[ n2 ] * crossCorrection[ 0 ][ e ];
+    next.py[ n2 ] -= inverseMass[ n2 ] * crossCorrection[ 1 ][ e ];
+    next.pz[ n2 ] -= inverseMass[ n2 ] * crossCorrection[ 2 ][ e ];
+  }
+}
+
+template < typename precision >
+void xpbdSolver< precision >::step( threadPool& pool, const springTopology& topology, const springConstants& constants,
+  const alignedArray< scalar >& inverseMass, const nodeState< storage >& current, nodeState< storage >& next,
+  float timeStep, float gravity, int firstNode, int substeps, int iterations, bool colored ) {
+
+  substeps = std::max( substeps, 1 );
+  iterations = std::max( iterations, 1 );
+  const scalar h = scalar( timeStep ) / substeps;
+
+  // 1 / ( k h^2 ), per material - a zero k is an infinitely soft constraint
+  complianceScale.resize( constants.size() );
+  for ( size_t m = 0; m < constants.size(); m++ ) {
+    const float k = constants.spring[ m ].k;
+    complianceScale[ m ] = k > 0.0f ? 1 / ( k * h * h ) : scalar( 1e30f );
+  }
+
+  // the constraints see this tick's wheel heights from the start
+  next.copyRange( current, 0, firstNode );
+
+  for ( int s = 0; s < substeps; s++ ) {
+    const nodeState< storage >& source = s == 0 ? current : next;
+
+    // a part's own nodes from their velocities, and fresh multipliers for its edges
+    auto predict = [&]( int p ) {
+      for ( int n = topology.partNodeStart[ p ]; n < topology.partNodeStart[ p + 1 ]; n++ ) {
+        if ( s == 0 ) {
+          scalar d = 0;
+          for ( int j = topology.rowStart[ n ]; j < topology.rowStart[ n + 1 ]; j++ )
+            d += constants.d[ topology.material[ topology.incidentEdge[ j ] ] ];
+          drag[ n ] = d;
+        }
+        // drag taken implicitly, v / ( 1 + h d / m ), so it can't overshoot at large h
+        const scalar slow = 1 / ( 1 + h * drag[ n ] * inverseMass[ n ] );
+        const scalar vx = source.vx[ n ] * slow;
+        const scalar vy = ( source.vy[ n ] - gravity * h ) * slow;
+        const scalar vz = source.vz[ n ] * slow;
+        next.vx[ n ] = vx; next.vy[ n ] = vy; next.vz[ n ] = vz;
+        previous[ 0 ][ n ] = source.px[ n ];
+        previous[ 1 ][ n ] = source.py[ n ];
+        previous[ 2 ][ n ] = source.pz[ n ];
+        next.px[ n ] = source.px[ n ] + h * vx;
+        next.py[ n ] = source.py[ n ] + h * vy;
+        next.pz[ n ] = source.pz[ n ] + h * vz;
+      }
+      for ( int e = topology.partEdgeStart[ p ]; e < topology.partEdgeStart[ p + 1 ]; e++ )
+        lambda[ e ] = 0;
+    };
+
+    if ( colored ) {
+      // the edges of a color share no moving node, so any worker can take any of them
+      pool.forEach( topology.numParts, [&]( int p, int ) { predict( p ); } );
+      for ( int i = 0; i < iterations; i++ )
+        for ( int c = 0; c < topology.numEdgeColors(); c++ ) {
+          const int first = topology.edgeColorStart[ c ];
+          pool.forEach( topology.edgeColorStart[ c + 1 ] - first, [&]( int j, int ) {
+            projectEdge( topology, inverseMass, next, topology.colorEdge[ first + j ] );
+          } );
+        }
+    } else {
+      for ( int i = 0; i < iterations; i++ ) {
+        // own nodes only - predict on the first pass, otherwise take the cross edge corrections
+        // from the last pass, then sweep the interior edges
+        pool.forEach( topology.numParts, [&]( int p, int ) {
+          if ( i == 0 )
+            predict( p );
+          else
+            applyCross( topology, inverseMass, next, p );
+          projectInterior( topology, inverseMass, next, topology.partEdgeStart[ p ], topology.partCrossStart[ p ] );
+        } );
+
+        // cross edges read both sides, so nothing may move while they are evaluated
+        if ( topology.numParts > 1 )
+          pool.forEach( topology.numParts, [&]( int p, int ) {
+            projectCross( topology, inverseMass, next, topology.partCrossStart[ p ], topology.partEdgeStart[ p + 1 ] );
+          } );
+      }
+    }
+
+    // last corrections, then the velocity that carried the nodes here
+    pool.forEach( topology.numParts, [&]( int p, int ) {
+      if ( !colored )
+        applyCross( topology, inverseMass, next, p );
+      for ( int n = topology.partNodeStart[ p ]; n < topology.partNodeStart[ p + 1 ]; n++ ) {
+        next.vx[ n ] = ( scalar( next.px[ n ] ) - previous[ 0 ][ n ] ) / h;
+        next.vy[ n ] = ( scalar( next.py[ n ] ) - previous[ 1 ][ n ] ) / h;
+        next.vz[ n ] = ( scalar( next.pz[ n ] ) - previous[ 2 ][ n ] ) / h;
+      }
+    } );
+  }
+}
+
+template class xpbdSolver< singlePrecision >;
+template class xpbdSolver< mixedPrecision >;
+template class xpbdSolver< doublePrecision >;
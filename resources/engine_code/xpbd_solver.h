@@ -0,0 +1,63 @@
+#ifndef XPBD_SOLVER
+#define XPBD_SOLVER
+
+#include "softbody_kernels.h"
+#include "thread_pool.h"
+
+#include <vector>
+
+// extended position based dynamics - every edge is a distance constraint C = L - L0 with
+// compliance L0 / k, so at convergence it matches the spring force k ( L / L0 - 1 ). a tick
+// is split into substeps, each predicting positions from the velocities and then running a
+// number of constraint projection iterations, after which velocities are ( x - x_prev ) / h.
+// damping stays the per node drag of the force model, applied implicitly in the prediction.
+// the constraints are linear, so a nonlinear force law is projected with its slope at rest,
+// and the shocks along the springs aren't modelled - use the force based solvers for those
+//
+// the parts' interior edges are projected Gauss-Seidel, each part in parallel since they only
+// move their own nodes. cross edges are projected Jacobi style - their corrections are parked
+// per edge and applied by both sides at the start of the next pass, the same way the force
+// path parks cross edge forces for gatherHaloForces. a node's mass is split across its cross
+// edges when computing their step, so their corrections, summed, can't overshoot. or, colored,
+// every edge is projected Gauss-Seidel a color at a time ( springTopology::colorEdge ), each
+// color split across the workers - no Jacobi edges, so it converges like a single part does
+// on any number of workers, at the cost of a dispatch per color. positions are moved in the
+// storage type, multipliers and corrections kept in the accumulator type
+template < typename precision >
+class xpbdSolver {
+public:
+	using storage = typename precision::storage;
+	using scalar  = typename precision::accumulator;
+
+	void resize( const springTopology& topology );
+
+	// one tick for the free nodes [ firstNode, numNodes ) from current into next - the anchored
+	// nodes are read from current. colored sweeps the edge colors in place of the parts
+	void step( threadPool& pool, const springTopology& topology, const springConstants& constants,
+		const alignedArray< scalar >& inverseMass, const nodeState< storage >& current, nodeState< storage >& next,
+		float timeStep, float gravity, int firstNode, int substeps, int iterations, bool colored = false );
+
+private:
+	alignedArray< scalar > lambda;        // accumulated multiplier per edge, reset every substep
+	alignedArray< scalar > crossCorrection[ 3 ]; // parked lambda * gradient per cross edge
+	alignedArray< storage > previous[ 3 ]; // positions at the start of the substep
+	alignedArray< scalar > drag;          // summed damping of the incident edges, per node
+	alignedArray< scalar > crossDegree;   // cross edges at each node, at least 1
+	std::vector< scalar > complianceScale; // 1 / ( k h^2 ) per material, for the current substep size
+
+	// project one edge, moving both endpoints
+	void projectEdge( const springTopology& topology, const alignedArray< scalar >& inverseMass, nodeState< storage >& next, int e );
+
+	// project edges [ first, last ) of a part Gauss-Seidel
+	void projectInterior( const springTopology& topology, const alignedArray< scalar >& inverseMass,
+		nodeState< storage >& next, int first, int last );
+
+	// compute corrections for the cross edges [ first, last ) without moving anything
+	void projectCross( const springTopology& topology, const alignedArray< scalar >& inverseMass,
+		const nodeState< storage >& next, int first, int last );
+
+	// apply the parked corrections of one part - its own cross edges, then its halo
+	void applyCross( const springTopology& topology, const alignedArray< scalar >& inverseMass, nodeState< storage >& next, int part );
+};
+
+#endif